@@ -1,15 +1,80 @@
 #include "BattleManager.h"
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
 #include "pokemon_data.h"
-static bool pokemon_data_is_loaded = false;
+#include "battle_rng.h"
+#include "damage_batch.h"
+#include "battle_ai.h"
 
 
 // --- Utility functions ---
 
+static bool console_output = true;
+
+void BattleManager_SetConsoleOutput(bool enabled) {
+    console_output = enabled;
+}
+
+// printf for the battle log lines, silenced by BattleManager_SetConsoleOutput
+static void game_print(const char *fmt, ...) {
+    if (!console_output) return;
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+/* ------------------------------------------
+    Outbox
+------------------------------------------- */
+static int outbox_vsend(BattleOutbox *out, int audience, const char *fmt, va_list args) {
+    size_t room = sizeof(out->data) - out->used;
+    int len = out->count < BM_OUTBOX_MAX && room > 1 ? vsnprintf(out->data + out->used, room, fmt, args) : -1;
+    if (len < 0 || (size_t)len >= room) {
+        game_print("[WARNING] Outgoing queue full; message dropped.\n");
+        return 0;
+    }
+    BattleOutMsg *m = &out->msgs[out->count++];
+    m->offset = out->used;
+    m->length = (uint16_t)len;
+    m->audience = (uint8_t)audience;
+    out->used = (uint16_t)(out->used + len + 1);
+    return 1;
+}
+
+int BattleManager_Send(BattleManager *bm, int audience, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int ok = outbox_vsend(&bm->outbox, audience, fmt, args);
+    va_end(args);
+    return ok;
+}
+
+int BattleManager_OutgoingCount(const BattleManager *bm) {
+    return bm->outbox.count;
+}
+
+const char* BattleManager_OutgoingAt(const BattleManager *bm, int i, size_t *len, int *audience) {
+    if (i < 0 || i >= bm->outbox.count) return NULL;
+    const BattleOutMsg *m = &bm->outbox.msgs[i];
+    if (len) *len = m->length;
+    if (audience) *audience = m->audience;
+    return bm->outbox.data + m->offset;
+}
+
+const char* BattleManager_GetOutgoingMessage(BattleManager *bm) {
+    return bm->outbox.count ? bm->outbox.data + bm->outbox.msgs[0].offset : "";
+}
+
+void BattleManager_ClearOutgoingMessage(BattleManager *bm) {
+    bm->outbox.count = 0;
+    bm->outbox.used = 0;
+}
+
 // Remove newline from a string
 void clean_newline(char *str) {
     size_t len = strlen(str);
@@ -18,17 +83,6 @@ void clean_newline(char *str) {
     }
 }
 
-// Extract value from a key in a message
-static void extract_value(char *msg, const char *key, char *output) {
-    char *start = strstr(msg, key);
-    if (start) {
-        start += strlen(key);
-        sscanf(start, "%s", output);
-    } else {
-        output[0] = '\0';
-    }
-}
-
 // Extract value from a key in a message
 static void extract(const char *msg, const char *key, char *output, size_t output_size) {
     char *start = strstr(msg, key);
@@ -62,363 +116,975 @@ static void extract(const char *msg, const char *key, char *output, size_t outpu
         output[0] = '\0';
     }
 }
+// Extract an integer value (0 if the key is missing)
+static int extract_int(const char *msg, const char *key) {
+    char buf[16];
+    extract(msg, key, buf, sizeof(buf));
+    return atoi(buf);
+}
+
+// "state_hash: <16 hex digits>"; false if the message has none
+static bool extract_hash(const char *msg, uint64_t *out) {
+    char buf[24];
+    extract(msg, "state_hash: ", buf, sizeof(buf));
+    if (!buf[0]) return false;
+    *out = strtoull(buf, NULL, 16);
+    return true;
+}
 
+static int roll_damage(BattleContext *ctx, int byMe, uint16_t move);
+
+// --- Name hints ---
+#define NAME_HINT_MAX 5
+
+// Up to `max` names close to `name`: prefix completions first, otherwise
+// the nearest spellings. Returns how many were stored.
+static int name_hints(const Pokedex *dex, DexNameKind kind, const char *name,
+                      const Pokemon *learner, const char **out, int max) {
+    int n = pokedex_complete(dex, kind, name, learner, out, max);
+    if (n > max) n = max;
+    if (n == 0) n = pokedex_suggest(dex, kind, name, learner, out, max);
+    return n;
+}
+
+static void print_name_hints(const Pokedex *dex, DexNameKind kind, const char *name, const Pokemon *learner) {
+    const char *hints[NAME_HINT_MAX];
+    int n = name_hints(dex, kind, name, learner, hints, NAME_HINT_MAX);
+    if (n == 0) return;
+    game_print("[GAME] Did you mean:");
+    for (int i = 0; i < n; i++) game_print("%s %s", i ? "," : "", hints[i]);
+    game_print("?\n");
+}
+
+// Message handlers are called only through the transition table (see
+// BattleManager_HandleMessage), which then moves to the entry's next state
+// (OUTCOME_NEXT) or its alternative (OUTCOME_ALT: mismatch, faint, failed
+// resolution).
+enum {
+    OUTCOME_STAY = -1, // could not act; state unchanged
+    OUTCOME_ALT = 0,
+    OUTCOME_NEXT = 1,
+    OUTCOME_OVER = 2   // a Pokemon fainted in a turn both sides have settled
+};
+
+// --- Event log (see battle_log.h) ---
+static uint16_t pokemon_index(const BattleContext *ctx, const Pokemon *p) {
+    return (uint16_t)(p - ctx->dex->pokemon);
+}
+
+// The SETUP record goes out with the first attack, once both Pokemon are known
+static void log_attack(BattleContext *ctx, int byMe, uint16_t move, int dmg) {
+    if (!ctx->log || !ctx->myPokemon || !ctx->oppPokemon) return;
+    if (!ctx->log->inBattle) {
+        const Pokemon *host = ctx->isHost ? ctx->myPokemon : ctx->oppPokemon;
+        const Pokemon *joiner = ctx->isHost ? ctx->oppPokemon : ctx->myPokemon;
+        battle_log_setup(ctx->log, ctx->dex, ctx->seed, pokemon_index(ctx, host),
+                         pokemon_index(ctx, joiner), ctx->turnMode);
+    }
+    battle_log_attack(ctx->log, byMe == ctx->isHost, move, (uint32_t)ctx->attackSeq, dmg);
+}
+
+static void log_end(BattleContext *ctx) {
+    if (!ctx->log || !ctx->log->inBattle) return;
+    battle_log_end(ctx->log, ctx->isHost ? ctx->myHP : ctx->oppHP,
+                   ctx->isHost ? ctx->oppHP : ctx->myHP, ctx->stateHash);
+}
+
+// battle_apply_attack plus the log; every attack this peer resolves goes through here
+static int settle_attack(BattleContext *ctx, int byMe, uint16_t move) {
+    int dmg = battle_apply_attack(ctx, byMe, move);
+    log_attack(ctx, byMe, move, dmg);
+    return dmg;
+}
 
 static void display_game_over(const char *winner, const char *loser, int seq) {
-    printf("\n===============================\n");
-    printf("          GAME OVER           \n");
-    printf("===============================\n");
-    printf("Winner: %s\n", winner);
-    printf("Loser : %s\n", loser);
-    printf("Sequence Number: %d\n", seq);
-    printf("===============================\n\n");
-}
-void handle_game_over(BattleManager *bm, const char *msg) {
-    char winner[64], loser[64], seq_buf[16];
-    extract_value((char *)msg, "winner", winner);
-    extract_value((char *)msg, "loser", loser);
-    extract_value((char *)msg, "sequence_number", seq_buf);
-
-    int seq = atoi(seq_buf);
-    display_game_over(winner, loser, seq);
+    game_print("\n===============================\n");
+    game_print("          GAME OVER           \n");
+    game_print("===============================\n");
+    game_print("Winner: %s\n", winner);
+    game_print("Loser : %s\n", loser);
+    game_print("Sequence Number: %d\n", seq);
+    game_print("===============================\n\n");
+}
 
-    bm->ctx.currentState = STATE_GAME_OVER;
+// Both sides already know a Pokemon fainted, so the result is shown locally
+static void end_battle(BattleContext *ctx, int seq) {
+    int won = ctx->oppHP <= 0;
+    display_game_over(pokemon_name(ctx->dex, won ? ctx->myPokemon : ctx->oppPokemon),
+                      pokemon_name(ctx->dex, won ? ctx->oppPokemon : ctx->myPokemon), seq);
+    ctx->currentState = STATE_GAME_OVER;
+    ctx->isMyTurn = 0;
+    log_end(ctx);
+}
+
+static int handle_game_over(BattleManager *bm, const char *msg) {
+    (void)bm;
+    char winner[64], loser[64];
+    extract(msg, "winner: ", winner, sizeof(winner));
+    extract(msg, "loser: ", loser, sizeof(loser));
+    display_game_over(winner, loser, extract_int(msg, "sequence_number: "));
+    if (strstr(msg, "reason: ")) {
+        char reason[64];
+        extract(msg, "reason: ", reason, sizeof(reason));
+        game_print("[GAME] Battle ended by the opponent: %s\n", reason);
+    }
+    return OUTCOME_NEXT;
 }
 
 // Sending a GAME_OVER message
 void BattleManager_TriggerGameOver(BattleManager *bm, const char *winner, const char *loser) {
-    char msg[BM_MAX_MSG_SIZE];
-
-    snprintf(msg, BM_MAX_MSG_SIZE,
-        "message_type: \"GAME_OVER\"\n"
+    int seq = ++bm->ctx.currentSequenceNum;
+    BattleManager_Send(bm, BM_TO_ALL,
+        "message_type: GAME_OVER\n"
         "winner: %s\n"
         "loser: %s\n"
-        "sequence_number: %d",
+        "sequence_number: %d\n",
         winner,
         loser,
-        ++bm->ctx.currentSequenceNum
+        seq
     );
 
-    handle_game_over(bm, msg);
+    display_game_over(winner, loser, seq);
+    bm->ctx.currentState = STATE_GAME_OVER;
+    log_end(&bm->ctx);
 }
 
 // --- Handlers ---
-void handle_attack_announce(BattleManager *bm, const char *msg) {
+// GAME_OVER for the side that just fainted
+static void send_game_over(BattleManager *bm, int audience) {
+    BattleContext *ctx = &bm->ctx;
+    int won = ctx->oppHP <= 0;
+    BattleManager_Send(bm, audience,
+        "message_type: GAME_OVER\n"
+        "winner: %s\n"
+        "loser: %s\n"
+        "sequence_number: %d\n",
+        pokemon_name(ctx->dex, won ? ctx->myPokemon : ctx->oppPokemon),
+        pokemon_name(ctx->dex, won ? ctx->oppPokemon : ctx->myPokemon),
+        ++ctx->currentSequenceNum);
+}
+
+// The defender's full view of the attack it just took, sent only when the
+// state hashes disagree
+static void build_resolution_request(BattleManager *bm) {
     BattleContext *ctx = &bm->ctx;
+    BattleManager_Send(bm, BM_TO_PEER,
+        "message_type: RESOLUTION_REQUEST\n"
+        "attacker: %s\n"
+        "move_used: %s\n"
+        "damage_dealt: %d\n"
+        "defender_hp_remaining: %d\n"
+        "attacker_hp_remaining: %d\n"
+        "turn: %u\n"
+        "state_hash: %016llx\n"
+        "sequence_number: %d\n",
+        pokemon_name(ctx->dex, ctx->oppPokemon),
+        move_name(ctx->dex, ctx->lastMoveUsed),
+        ctx->lastDamage,
+        ctx->lastRemainingHP,
+        ctx->oppHP,
+        (unsigned)ctx->turn,
+        (unsigned long long)ctx->stateHash,
+        ++ctx->currentSequenceNum);
+}
+
+// Read the opponent's ATTACK_ANNOUNCE and apply it to our side
+static void take_attack(BattleContext *ctx, const char *msg) {
     // Extract opponent's move
-    extract(msg, "move_name: ", ctx->lastMoveUsed, sizeof(ctx->lastMoveUsed));
-    Pokemon p;
-    if(ctx->isMyTurn == 1){
-        p = ctx->myPokemon;
-    }
+    char moveName[64];
+    extract(msg, "move_name: ", moveName, sizeof(moveName));
+    ctx->lastMoveUsed = getMoveByName(ctx->dex, moveName, ctx->oppPokemon);
+    ctx->attackSeq = extract_int(msg, "sequence_number: ");
+    ctx->turn++;
+    if (ctx->lastMoveUsed != MOVE_NONE)
+        game_print("[GAME] Opponent used %s! Prepare your move...\n", move_name(ctx->dex, ctx->lastMoveUsed));
     else{
-        p = ctx->oppPokemon;
-    }
-    if(getMoveByName(ctx->lastMoveUsed,p.name))
-        printf("[GAME] Opponent used %s! Prepare your move...\n", ctx->lastMoveUsed);
-    else{
-        printf("Invalid move");
+        game_print("Invalid move");
+        print_name_hints(ctx->dex, DEX_MOVE_NAMES, moveName, ctx->oppPokemon);
     }
 
+    // Work out the damage we take with the same roll the attacker uses, so
+    // its CALCULATION_REPORT can be confirmed without another round trip
+    if (ctx->myPokemon && ctx->oppPokemon)
+        settle_attack(ctx, 0, ctx->lastMoveUsed);
+}
+
+static int handle_attack_announce(BattleManager *bm, const char *msg) {
+    BattleContext *ctx = &bm->ctx;
+    take_attack(ctx, msg);
+
     // Prepare DEFENSE_ANNOUNCE
-    snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
+    BattleManager_Send(bm, BM_TO_PEER,
         "message_type: DEFENSE_ANNOUNCE\n"
         "sequence_number: %d\n",
         ++ctx->currentSequenceNum);
-
-    // Set turn to you
-    ctx->isMyTurn = 1;
-    ctx->currentState = STATE_WAITING_FOR_MOVE;
+    return OUTCOME_NEXT;
 }
 
-void handle_calculation_report(BattleManager *bm, const char *msg) {
+// Fast turns: the announce already carries the attacker's result and its
+// commitment, so one CALCULATION_CONFIRM (or RESOLUTION_REQUEST) settles it
+static int handle_attack_commit(BattleManager *bm, const char *msg) {
     BattleContext *ctx = &bm->ctx;
+    uint64_t peer;
+    take_attack(ctx, msg);
 
-    printf("[GAME] Received damage report. Verifying...\n");
+    if (!extract_hash(msg, &peer) || peer != ctx->stateHash) {
+        game_print("[GAME] State commitment mismatch! Sending RESOLUTION_REQUEST...\n");
+        build_resolution_request(bm);
+        return OUTCOME_ALT;
+    }
 
-    // Extract values from peer's report 
-    char peerMove[64];
-    int peerDamage, peerRemainingHP;
-    char buffer[16];
-    char attacker[64];
+    BattleManager_Send(bm, BM_TO_PEER,
+        "message_type: CALCULATION_CONFIRM\n"
+        "state_hash: %016llx\n"
+        "sequence_number: %d\n",
+        (unsigned long long)ctx->stateHash,
+        ++ctx->currentSequenceNum);
+    if (ctx->myHP <= 0)
+        return OUTCOME_OVER;
+    game_print("[GAME] Took %d damage (HP %d). [YOUR TURN]\n", ctx->lastDamage, ctx->myHP);
+    return OUTCOME_NEXT;
+}
+
+static int handle_calculation_report(BattleManager *bm, const char *msg) {
+    BattleContext *ctx = &bm->ctx;
 
-    extract_value((char *)msg, "move_used", peerMove);
-    extract_value((char *)msg, "damage_dealt", buffer); peerDamage = atoi(buffer);
-    extract_value((char *)msg, "defender_hp_remaining", buffer); peerRemainingHP = atoi(buffer);
-    extract_value((char *)msg, "attacker", attacker);
+    game_print("[GAME] Received damage report. Verifying...\n");
 
-    // Check for discrepancy
-    bool match = (strcmp(peerMove, ctx->lastMoveUsed) == 0) &&
-                (peerDamage == ctx->lastDamage) &&
-                (peerRemainingHP == ctx->lastRemainingHP);
+    // The report is just the attacker's state hash; the hash covers both HPs
+    // and the whole history, so equal hashes mean equal battles
+    uint64_t peerHash;
+    bool match;
+    if (extract_hash(msg, &peerHash)) {
+        match = peerHash == ctx->stateHash;
+    } else {
+        // Field-by-field report (typed by hand or from an older peer)
+        char peerMove[64];
+        extract(msg, "move_used: ", peerMove, sizeof(peerMove));
+        match = (findMoveId(ctx->dex, peerMove) == ctx->lastMoveUsed) &&
+                (extract_int(msg, "damage_dealt: ") == ctx->lastDamage) &&
+                (extract_int(msg, "defender_hp_remaining: ") == ctx->lastRemainingHP);
+    }
 
     if (match) {
-        snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
+        BattleManager_Send(bm, BM_TO_PEER,
             "message_type: CALCULATION_CONFIRM\n"
+            "state_hash: %016llx\n"
             "sequence_number: %d\n",
+            (unsigned long long)ctx->stateHash,
             ++ctx->currentSequenceNum);
 
-        // Flip turn
-        ctx->isMyTurn = 1;
-        ctx->currentState = STATE_WAITING_FOR_MOVE;
-        printf("[GAME] Turn done. %s\n", ctx->isMyTurn ? "[YOUR TURN]" : "Waiting for opponent...");
-
+        // Our turn to attack next
+        game_print("[GAME] Turn done. [YOUR TURN]\n");
+        return OUTCOME_NEXT;
     } else {
         //  send RESOLUTION_REQUEST on mismatch
-        printf("[GAME] Discrepancy detected! Sending RESOLUTION_REQUEST...\n");
-
-        snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
-            "message_type: RESOLUTION_REQUEST\n"
-            "attacker: %s\n"
-            "move_used: %s\n"
-            "damage_dealt: %d\n"
-            "defender_hp_remaining: %d\n"
-            "sequence_number: %d\n",
-            ctx->myPokemon.name,
-            ctx->lastMoveUsed,
-            ctx->lastDamage,
-            ctx->lastRemainingHP,
-            ++ctx->currentSequenceNum);
-
-        ctx->currentState = STATE_WAITING_FOR_RESOLUTION;
+        game_print("[GAME] Discrepancy detected! Sending RESOLUTION_REQUEST...\n");
+        build_resolution_request(bm);
+        return OUTCOME_ALT;
     }
 }
 
-void handle_resolution_request(BattleManager *bm, const char *msg) {
+static int handle_resolution_request(BattleManager *bm, const char *msg) {
     BattleContext *ctx = &bm->ctx;
 
     char reqMove[64];
     int reqDamage, reqRemainingHP;
-    char attacker[64];
-    char buffer[16]; // temp buffer for numeric parsing
 
-    extract_value((char*)msg, "move_used", reqMove);
-    extract_value((char*)msg, "damage_dealt", buffer); reqDamage = atoi(buffer);
-    extract_value((char*)msg, "defender_hp_remaining", buffer); reqRemainingHP = atoi(buffer);
-    extract_value((char*)msg, "attacker", attacker);
+    extract(msg, "move_used: ", reqMove, sizeof(reqMove));
+    reqDamage = extract_int(msg, "damage_dealt: ");
+    reqRemainingHP = extract_int(msg, "defender_hp_remaining: ");
 
-    printf("[GAME] RESOLUTION_REQUEST received from opponent.\n");
+    game_print("[GAME] RESOLUTION_REQUEST received from opponent.\n");
 
-    bool agree = (strcmp(reqMove, ctx->lastMoveUsed) == 0) &&
+    bool agree = (findMoveId(ctx->dex, reqMove) == ctx->lastMoveUsed) &&
                 (reqDamage == ctx->lastDamage) &&
                 (reqRemainingHP == ctx->lastRemainingHP);
+    if (strstr(msg, "attacker_hp_remaining: "))
+        agree = agree && extract_int(msg, "attacker_hp_remaining: ") == ctx->myHP;
+
+    uint64_t peerHash;
+    if (agree && extract_hash(msg, &peerHash) && peerHash != ctx->stateHash) {
+        // Same numbers this turn but a different history: the battles
+        // diverged earlier, which is what the hash is there to catch
+        game_print("[GAME] State hashes differ (ours %016llx, opponent's %016llx): the battles diverged.\n",
+                   (unsigned long long)ctx->stateHash, (unsigned long long)peerHash);
+        agree = false;
+    }
 
     if (agree) {
         // Send ACK
-        snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
+        BattleManager_Send(bm, BM_TO_PEER,
             "message_type: ACK\n"
             "sequence_number: %d\n",
             ++ctx->currentSequenceNum);
 
-        ctx->currentState = STATE_WAITING_FOR_MOVE;
-        ctx->isMyTurn = !ctx->isMyTurn;
-        printf("[GAME] RESOLUTION_REQUEST matched. State updated.\n");
+        game_print("[GAME] RESOLUTION_REQUEST matched. State updated.\n");
+        return ctx->oppHP <= 0 ? OUTCOME_OVER : OUTCOME_NEXT;
     } else {
-        printf("[ERROR] Discrepancy could not be resolved. Terminating battle.\n");
-        ctx->currentState = STATE_GAME_OVER;
+        // The defender waits for an ACK; end the battle on its side too
+        game_print("[ERROR] Discrepancy could not be resolved. Terminating battle.\n");
+        int seq = ++ctx->currentSequenceNum;
+        BattleManager_Send(bm, BM_TO_PEER,
+            "message_type: GAME_OVER\n"
+            "winner: none\n"
+            "loser: none\n"
+            "reason: unresolved discrepancy\n"
+            "sequence_number: %d\n",
+            seq);
+        display_game_over("none", "none", seq);
+        return OUTCOME_ALT;
     }
 }
 
-void handle_calculation_confirm(BattleManager *bm, const char *msg) {
+static int handle_calculation_confirm(BattleManager *bm, const char *msg) {
     BattleContext *ctx = &bm->ctx;
-    printf("[GAME] CALCULATION_CONFIRM received.\n");
+    uint64_t peerHash;
+    // A confirm echoes the state hash; the defender only confirms on a
+    // match, so a different echo means a broken peer, not a dispute
+    if (extract_hash(msg, &peerHash) && peerHash != ctx->stateHash)
+        game_print("[WARNING] CALCULATION_CONFIRM echoes a different state hash.\n");
+
+    // Our attack is settled; the opponent attacks next
+    if (ctx->oppHP <= 0)
+        return OUTCOME_OVER;
+    game_print("[GAME] CALCULATION_CONFIRM received. Waiting for opponent...\n");
+    return OUTCOME_NEXT;
+}
 
-    // Flip turn
-    ctx->isMyTurn = 1;
-    ctx->currentState = STATE_WAITING_FOR_MOVE;
+static int handle_ack(BattleManager *bm, const char *msg) {
+    (void)msg;
+    if (bm->ctx.myHP <= 0)
+        return OUTCOME_OVER;
+    game_print("[GAME] Opponent accepted the resolution. [YOUR TURN]\n");
+    return OUTCOME_NEXT;
+}
+
+// Hosted turns: the host's result of the attack just resolved, for the
+// joiner and any spectators. HP is given per role so it reads the same
+// from either side.
+static void build_turn_result(BattleManager *bm, int byMe) {
+    BattleContext *ctx = &bm->ctx;
+    BattleManager_Send(bm, BM_TO_ALL,
+        "message_type: TURN_RESULT\n"
+        "attacker: %s\n"
+        "move_used: %s\n"
+        "damage_dealt: %d\n"
+        "host_hp: %d\n"
+        "joiner_hp: %d\n"
+        "turn: %u\n"
+        "attack_sequence: %d\n"
+        "state_hash: %016llx\n"
+        "sequence_number: %d\n",
+        pokemon_name(ctx->dex, byMe ? ctx->myPokemon : ctx->oppPokemon),
+        move_name(ctx->dex, ctx->lastMoveUsed),
+        ctx->lastDamage,
+        ctx->myHP,
+        ctx->oppHP,
+        (unsigned)ctx->turn,
+        ctx->attackSeq,
+        (unsigned long long)ctx->stateHash,
+        ++ctx->currentSequenceNum);
+}
+
+static int handle_move_intent(BattleManager *bm, const char *msg) {
+    BattleContext *ctx = &bm->ctx;
+    if (!ctx->myPokemon || !ctx->oppPokemon) {
+        game_print("[ERROR] Both Pokemon must be set before attacking.\n");
+        return OUTCOME_STAY;
+    }
+
+    // A move the opponent does not know is a wasted turn rather than a
+    // dispute: the result still goes out, so both sides move on
+    char moveName[64];
+    extract(msg, "move_name: ", moveName, sizeof(moveName));
+    ctx->lastMoveUsed = getMoveByName(ctx->dex, moveName, ctx->oppPokemon);
+    if (ctx->lastMoveUsed == MOVE_NONE)
+        game_print("[GAME] Opponent cannot use %s; the turn is lost.\n", moveName);
+    ctx->attackSeq = extract_int(msg, "sequence_number: ");
+    ctx->turn++;
+
+    int dmg = settle_attack(ctx, 0, ctx->lastMoveUsed);
+    build_turn_result(bm, 0);
+    if (ctx->myHP <= 0) {
+        send_game_over(bm, BM_TO_SPECTATORS); // the joiner ends on the TURN_RESULT itself
+        return OUTCOME_OVER;
+    }
+    game_print("[GAME] Opponent used %s for %d damage (HP %d). [YOUR TURN]\n",
+           move_name(ctx->dex, ctx->lastMoveUsed), dmg, ctx->myHP);
+    return OUTCOME_NEXT;
+}
+
+// Joiner side of hosted turns: adopt the host's numbers as they are
+static int handle_turn_result(BattleManager *bm, const char *msg) {
+    BattleContext *ctx = &bm->ctx;
+    char move[64];
+    extract(msg, "move_used: ", move, sizeof(move));
+    ctx->lastMoveUsed = findMoveId(ctx->dex, move);
+    ctx->lastDamage = (int16_t)extract_int(msg, "damage_dealt: ");
+    ctx->oppHP = (int16_t)extract_int(msg, "host_hp: ");
+    ctx->myHP = (int16_t)extract_int(msg, "joiner_hp: ");
+    ctx->turn = (uint32_t)extract_int(msg, "turn: ");
+    ctx->attackSeq = extract_int(msg, "attack_sequence: ");
+    extract_hash(msg, &ctx->stateHash);
+    log_attack(ctx, ctx->currentState == STATE_WAITING_FOR_RESULT, ctx->lastMoveUsed, ctx->lastDamage);
+
+    game_print("[GAME] %s used %s for %d damage (you %d HP, opponent %d HP).\n",
+           ctx->currentState == STATE_WAITING_FOR_RESULT ? "You" : "Opponent",
+           move, ctx->lastDamage, ctx->myHP, ctx->oppHP);
+    if (ctx->myHP <= 0 || ctx->oppHP <= 0)
+        return OUTCOME_OVER;
+    return OUTCOME_NEXT;
 }
 
 
 // --- Public API ---
 void BattleManager_Init(BattleManager *bm, int isHost, const char *myPokeName) {
-    if (!pokemon_data_is_loaded) {
-        int loaded_count = loadPokemonCSV("pokemon.csv");
-        
-        if (loaded_count > 0) {
-            pokemon_data_is_loaded = true;
-            printf("[GAME INIT] Pokemon data loaded successfully (%d records).\n", loaded_count);
-        } else {
-            printf("[GAME INIT] CRITICAL ERROR: Failed to load pokemon.csv. Exiting.\n");
-            exit(1); // Stop the application if data is critical
-        }
+    // Pin the current Pokedex snapshot for the whole battle; a reload only
+    // affects battles initialised after it.
+    const Pokedex *dex = pokedex_acquire();
+    if (!dex || dex->move_count == 0 || dex->pokemon_count == 0) {
+        game_print("[GAME INIT] CRITICAL ERROR: Failed to load moves.csv/pokemon.csv. Exiting.\n");
+        exit(1); // Stop the application if data is critical
+    }
+    // init_battle clears the context; the outbox only needs its counters
+    // reset, so reused session slots are not wiped in full
+    BattleManager_ClearOutgoingMessage(bm);
+    init_battle(&bm->ctx, dex, isHost, myPokeName);
+}
+
+void BattleManager_Release(BattleManager *bm) {
+    log_end(&bm->ctx); // an abandoned battle still gets its END record
+    pokedex_release(bm->ctx.dex);
+    bm->ctx.dex = NULL;
+    bm->ctx.myPokemon = NULL;
+    bm->ctx.oppPokemon = NULL;
+}
+
+void BattleManager_SetSeed(BattleManager *bm, uint64_t seed) {
+    bm->ctx.seed = seed;
+    bm->ctx.stateHash = splitmix64(seed); // before any attack
+}
+
+int BattleManager_SetTurnMode(BattleManager *bm, BattleTurnMode mode) {
+    if (bm->ctx.turn != 0 || mode >= TURN_MODE_COUNT) return 0; // the mode cannot change mid-battle
+    bm->ctx.turnMode = (uint8_t)mode;
+    return 1;
+}
+
+BattleTurnMode BattleManager_NegotiateTurnMode(const char *hostMode, const char *joinerMode) {
+    if (!strcmp(hostMode, "HOSTED"))
+        return TURN_MODE_HOSTED;
+    if (!strcmp(hostMode, "FAST") && !strcmp(joinerMode, "FAST"))
+        return TURN_MODE_FAST;
+    return TURN_MODE_CLASSIC;
+}
+
+void BattleManager_SetLog(BattleManager *bm, BattleLog *log) {
+    bm->ctx.log = log;
+}
+
+void BattleManager_SetAi(BattleManager *bm, BattleAi *ai) {
+    bm->ctx.ai = ai;
+}
+
+void BattleManager_SetDamageCache(BattleManager *bm, DamageCache *cache) {
+    bm->ctx.sharedDamage = cache;
+}
+
+void BattleManager_SetOpponent(BattleManager *bm, const char *oppPokeName) {
+    const Pokemon *p = getPokemonByName(bm->ctx.dex, oppPokeName);
+    if (!p) {
+        game_print("[ERROR] Opponent Pokemon not found: %s\n", oppPokeName);
+        print_name_hints(bm->ctx.dex, DEX_POKEMON_NAMES, oppPokeName, NULL);
+        return;
     }
-    memset(bm, 0, sizeof(BattleManager));
-    init_battle(&bm->ctx, isHost, (char*)myPokeName);
+    bm->ctx.oppPokemon = p;
+    bm->ctx.oppHP = (int16_t)p->hp;
+    memset(bm->ctx.damageCache, 0, sizeof(bm->ctx.damageCache)); // new matchup
+    game_print("[GAME] Opponent is %s (HP %d).\n", pokemon_name(bm->ctx.dex, p), p->hp);
+}
+
+const char* BattleManager_MyPokemonName(const BattleManager *bm) {
+    return pokemon_name(bm->ctx.dex, bm->ctx.myPokemon);
+}
+
+const char* BattleManager_OppPokemonName(const BattleManager *bm) {
+    return pokemon_name(bm->ctx.dex, bm->ctx.oppPokemon);
+}
+
+const char* BattleManager_LastMoveName(const BattleManager *bm) {
+    return move_name(bm->ctx.dex, bm->ctx.lastMoveUsed);
 }
 
 
 void BattleManager_HandleUserInput(BattleManager *bm, const char *input) {
     BattleContext *ctx = &bm->ctx;
-    memset(bm->outgoingBuffer, 0, BM_MAX_MSG_SIZE);
 
     // Special case: user types "GAME_OVER"
     if (strcmp(input, "GAME_OVER") == 0) {
-        BattleManager_TriggerGameOver(bm, ctx->myPokemon.name, ctx->oppPokemon.name);
+        BattleManager_TriggerGameOver(bm, pokemon_name(ctx->dex, ctx->myPokemon), pokemon_name(ctx->dex, ctx->oppPokemon));
+        return;
+    }
+
+    // "Fla?" lists the moves starting with "Fla" that this Pokemon knows
+    size_t len = strlen(input);
+    if (len > 0 && input[len - 1] == '?' && ctx->myPokemon) {
+        char prefix[POKEMON_NAME_MAX];
+        const char *matches[DEX_SUGGEST_MAX];
+        snprintf(prefix, sizeof(prefix), "%.*s", (int)(len - 1), input);
+        int total = pokedex_complete(ctx->dex, DEX_MOVE_NAMES, prefix, ctx->myPokemon, matches, DEX_SUGGEST_MAX);
+        game_print("[GAME] %d move(s) starting with \"%s\":", total, prefix);
+        for (int i = 0; i < total && i < DEX_SUGGEST_MAX; i++) game_print("%s %s", i ? "," : "", matches[i]);
+        game_print("%s\n", total > DEX_SUGGEST_MAX ? ", ..." : "");
         return;
     }
 
+    // "AUTO": the computer player picks the move, which is then played as typed
+    if (strcmp(input, "AUTO") == 0 && ctx->currentState == STATE_WAITING_FOR_MOVE) {
+        BattleAiResult ai;
+        uint16_t move = battle_ai_choose(ctx->ai, ctx, &ai);
+        if (move == MOVE_NONE) {
+            game_print("[GAME] No computer player for AUTO (or no move to play).\n");
+            return;
+        }
+        game_print("[GAME] AI picks %s (win chance %.0f%%, %d plies%s, %llu nodes in %u ms)\n",
+                   move_name(ctx->dex, move), ai.winChance * 100.0f, ai.depth, ai.exact ? ", exact" : "",
+                   (unsigned long long)ai.nodes, (unsigned)ai.elapsedMs);
+        input = move_name(ctx->dex, move);
+    }
+
     // Normal move handling
-    if (ctx->currentState == STATE_WAITING_FOR_MOVE && ctx->isMyTurn) {
-        strcpy(ctx->lastMoveUsed, input);
-        snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
+    if (ctx->currentState == STATE_WAITING_FOR_MOVE) {
+        uint16_t move = getMoveByName(ctx->dex, input, ctx->myPokemon);
+        if (move == MOVE_NONE) {
+            game_print("[GAME] %s does not know %s!\n", pokemon_name(ctx->dex, ctx->myPokemon), input);
+            print_name_hints(ctx->dex, DEX_MOVE_NAMES, input, ctx->myPokemon);
+            return;
+        }
+        // FAST and HOSTED turns resolve the attack against the opponent; the
+        // classic ATTACK_ANNOUNCE is no fallback (their tables never answer it)
+        if (ctx->turnMode != TURN_MODE_CLASSIC && !ctx->oppPokemon) {
+            game_print("[GAME] Opponent not set yet; wait for its BATTLE_SETUP.\n");
+            return;
+        }
+        ctx->lastMoveUsed = move;
+        ctx->attackSeq = ++ctx->currentSequenceNum;
+        if (ctx->turnMode == TURN_MODE_HOSTED && !ctx->isHost) {
+            // The host resolves it; TURN_RESULT brings back the outcome
+            BattleManager_Send(bm, BM_TO_PEER,
+                "message_type: MOVE_INTENT\n"
+                "move_name: %s\n"
+                "sequence_number: %d\n",
+                move_name(ctx->dex, move),
+                ctx->attackSeq);
+            ctx->currentState = STATE_WAITING_FOR_RESULT;
+            ctx->isMyTurn = 0;
+            game_print("[GAME] Sending move intent: %s\n", move_name(ctx->dex, move));
+            return;
+        }
+        ctx->turn++;
+        if (ctx->turnMode == TURN_MODE_HOSTED) {
+            int dmg = settle_attack(ctx, 1, move);
+            build_turn_result(bm, 1);
+            game_print("[GAME] %s dealt %d damage (opponent HP %d)\n", move_name(ctx->dex, move), dmg, ctx->oppHP);
+            if (ctx->oppHP <= 0) {
+                send_game_over(bm, BM_TO_SPECTATORS);
+                end_battle(ctx, ctx->currentSequenceNum);
+            } else {
+                ctx->currentState = STATE_WAITING_FOR_ATTACK;
+                ctx->isMyTurn = 0;
+            }
+            return;
+        }
+        if (ctx->turnMode == TURN_MODE_FAST) {
+            // Resolve the attack now and commit to the result; the defender
+            // checks it against its own and settles the turn in one reply
+            int dmg = settle_attack(ctx, 1, move);
+            BattleManager_Send(bm, BM_TO_PEER,
+                "message_type: ATTACK_ANNOUNCE\n"
+                "move_name: %s\n"
+                "damage_dealt: %d\n"
+                "defender_hp_remaining: %d\n"
+                "state_hash: %016llx\n"
+                "sequence_number: %d\n",
+                move_name(ctx->dex, move),
+                dmg,
+                ctx->oppHP,
+                (unsigned long long)ctx->stateHash,
+                ctx->attackSeq);
+            ctx->currentState = STATE_WAITING_FOR_CONFIRM;
+            game_print("[GAME] Sending attack: %s (%d damage, opponent HP %d)\n", move_name(ctx->dex, move), dmg, ctx->oppHP);
+            return;
+        }
+        BattleManager_Send(bm, BM_TO_PEER,
             "message_type: ATTACK_ANNOUNCE\n"
             "move_name: %s\n"
             "sequence_number: %d\n",
-            input,
-            ++ctx->currentSequenceNum);
-        printf("[GAME] Sending attack: %s\n", input);
+            move_name(ctx->dex, move),
+            ctx->attackSeq);
+        ctx->currentState = STATE_WAITING_FOR_DEFENSE;
+        game_print("[GAME] Sending attack: %s\n", move_name(ctx->dex, move));
     } else {
-        printf("[GAME] Not your turn or wrong state!\n");
+        game_print("[GAME] Not your turn or wrong state!\n");
     }
 }
 
 int BattleManager_CheckWinLoss(BattleManager *bm) {
-    if (bm->ctx.myPokemon.hp <= 0) return -1; // lost
-    if (bm->ctx.oppPokemon.hp <= 0) return 1; // won
+    if (bm->ctx.myPokemon && bm->ctx.myHP <= 0) return -1; // lost
+    if (bm->ctx.oppPokemon && bm->ctx.oppHP <= 0) return 1; // won
     return 0; // ongoing
 }
 
 
-const char* BattleManager_GetOutgoingMessage(BattleManager *bm) {
-    return bm->outgoingBuffer;
+void BattleManager_AnswerNameQuery(const char *query, char *reply, size_t reply_size) {
+    char kind[16], prefix[POKEMON_NAME_MAX];
+    extract(query, "kind: ", kind, sizeof(kind));
+    extract(query, "prefix: ", prefix, sizeof(prefix));
+    DexNameKind k = strcasecmp(kind, "move") == 0 ? DEX_MOVE_NAMES : DEX_POKEMON_NAMES;
+
+    const Pokedex *dex = pokedex_acquire();
+    const char *names[DEX_SUGGEST_MAX];
+    int total = 0, n = 0;
+    if (dex) {
+        total = pokedex_complete(dex, k, prefix, NULL, names, DEX_SUGGEST_MAX);
+        n = total < DEX_SUGGEST_MAX ? total : DEX_SUGGEST_MAX;
+        if (n == 0) n = pokedex_suggest(dex, k, prefix, NULL, names, DEX_SUGGEST_MAX);
+    }
+
+    int used = snprintf(reply, reply_size,
+        "message_type: NAME_QUERY_RESULT\n"
+        "kind: %s\n"
+        "prefix: %s\n"
+        "total: %d\n"
+        "%s: ",
+        k == DEX_MOVE_NAMES ? "move" : "pokemon", prefix, total,
+        total > 0 ? "matches" : "suggestions");
+    for (int i = 0; i < n && used > 0 && (size_t)used < reply_size; i++) {
+        used += snprintf(reply + used, reply_size - (size_t)used, "%s%s", i ? ", " : "", names[i]);
+    }
+    if (used > 0 && (size_t)used < reply_size) snprintf(reply + used, reply_size - (size_t)used, "\n");
+    pokedex_release(dex);
 }
 
-void BattleManager_ClearOutgoingMessage(BattleManager *bm) {
-    memset(bm->outgoingBuffer, 0, BM_MAX_MSG_SIZE);
-}   
-void init_battle(BattleContext *ctx, int isHost, const char *myPokeName) {
+void init_battle(BattleContext *ctx, const Pokedex *dex, int isHost, const char *myPokeName) {
     // Clear the BattleContext
     memset(ctx, 0, sizeof(BattleContext));
+    ctx->dex = dex;
 
-    ctx->currentState = STATE_WAITING_FOR_MOVE;
-    ctx->isMyTurn = isHost;  // Host goes first
+    // Host goes first
+    ctx->currentState = isHost ? STATE_WAITING_FOR_MOVE : STATE_WAITING_FOR_ATTACK;
+    ctx->isMyTurn = isHost;
+    ctx->isHost = isHost;
+    ctx->lastMoveUsed = MOVE_NONE;
     // Initialize myPokemon
-    Pokemon *p = getPokemonByName(myPokeName);
+    const Pokemon *p = getPokemonByName(dex, myPokeName);
     if (p) {
-        ctx->myPokemon = *p;
-        printf("[GAME] Found Pokemon!\n");
+        ctx->myPokemon = p;
+        ctx->myHP = (int16_t)p->hp;
+        game_print("[GAME] Found Pokemon!\n");
+        game_print("[GAME] Moves:");
+        for (uint16_t id = 0; console_output && getMoveById(dex, id); id++) {
+            if (pokemon_knows_move(p, id) && getMoveById(dex, id)->power > 0)
+                game_print(" %s,", move_name(dex, id));
+        }
+        game_print("\n");
     } else {
-        printf("[ERROR] Pokemon not found: %s\n", myPokeName);
+        game_print("[ERROR] Pokemon not found: %s\n", myPokeName);
+        print_name_hints(dex, DEX_POKEMON_NAMES, myPokeName, NULL);
     }
 
     ctx->currentSequenceNum = 0;
 }
 
-static float get_type_multiplier(const char *moveType, const char *defType1, const char *defType2) {
-    float mult = 1.0f;
+// Integer-only so both peers get bit-identical results whatever the
+// compiler, FPU or optimisation flags. Each stage truncates, in this order.
+int32_t calculate_damage_base(const Pokemon *attacker, const Pokemon *defender, const Move *move) {
+    if (!move || move->category == MOVE_STATUS)
+        return DAMAGE_BASE_NONE; // status move / invalid
 
-    // EXAMPLE type chart (add more as needed)
-    if (strcmp(moveType, "Fire") == 0) {
-        if (strcmp(defType1, "Grass") == 0 || strcmp(defType2, "Grass") == 0) mult *= 2.0f;
-        if (strcmp(defType1, "Water") == 0 || strcmp(defType2, "Water") == 0) mult *= 0.5f;
-    }
+    // PHYSICAL vs SPECIAL
+    int physical = move->category == MOVE_PHYSICAL;
+    int32_t atk = physical ? attacker->attack : attacker->sp_attack;
+    int32_t def = physical ? defender->defense : defender->sp_defense;
 
-    if (strcmp(moveType, "Water") == 0) {
-        if (strcmp(defType1, "Fire") == 0 || strcmp(defType2, "Fire") == 0) mult *= 2.0f;
-        if (strcmp(defType1, "Grass") == 0 || strcmp(defType2, "Grass") == 0) mult *= 0.5f;
-    }
+    // TYPE EFFECTIVENESS: one load from the defender's against_* vector
+    int32_t eff = (move->type_id < TYPE_COUNT) ? defender->against[move->type_id] : EFF_SCALE;
 
-    if (strcmp(moveType, "Electric") == 0) {
-        if (strcmp(defType1, "Water") == 0 || strcmp(defType2, "Water") == 0) mult *= 2.0f;
-        if (strcmp(defType1, "Ground") == 0 || strcmp(defType2, "Ground") == 0) mult = 0.0f; // immune
-    }
+    // STAB: Same-Type Attack Bonus
+    int stab = move->type_id != TYPE_NONE &&
+               (attacker->type1_id == move->type_id || attacker->type2_id == move->type_id);
 
-    return mult;
+    // The stages themselves live in damage_batch.h, shared with damage_batch()
+    return damage_base(move->power, atk, def, stab, eff);
 }
 
+int calculate_damage(const Pokemon *attacker, const Pokemon *defender, const Move *move, int roll) {
+    return (int)damage_apply_roll(calculate_damage_base(attacker, defender, move), roll);
+}
 
+// Pre-roll damage of one side's move: this battle's per-move cache first,
+// then the optional shared cache, and only then the full formula
+static int32_t matchup_base(BattleContext *ctx, int byMe, uint16_t move) {
+    const Pokemon *attacker = byMe ? ctx->myPokemon : ctx->oppPokemon;
+    const Pokemon *defender = byMe ? ctx->oppPokemon : ctx->myPokemon;
+    if (move >= MOVE_MAX)
+        return calculate_damage_base(attacker, defender, getMoveById(ctx->dex, move));
+
+    BattleDamageSlot *slot = &ctx->damageCache[byMe ? 1 : 0][move % BM_DAMAGE_SLOTS];
+    if (slot->base && slot->move == move)
+        return (int32_t)slot->base - 2;
+
+    int32_t base;
+    DamageCache *shared = ctx->sharedDamage && ctx->sharedDamage->dex == ctx->dex ? ctx->sharedDamage : NULL;
+    if (!shared || !damage_cache_get(shared, attacker, defender, move, &base)) {
+        base = calculate_damage_base(attacker, defender, getMoveById(ctx->dex, move));
+        if (shared)
+            damage_cache_put(shared, attacker, defender, move, base);
+    }
+    if (base + 2 <= 0xFFFF) {
+        slot->move = move;
+        slot->base = (uint16_t)(base + 2);
+    }
+    return base;
+}
 
-int calculate_damage(Pokemon *attacker, Pokemon *defender, Move *move) {
-    if (move->power <= 0)
-        return 0; // status move / invalid
-
-    // PHYSICAL vs SPECIAL
-    int atk = (strcmp(move->category, "Physical") == 0)
-                ? attacker->attack
-                : attacker->sp_attack;
-
-    int def = (strcmp(move->category, "Physical") == 0)
-                ? defender->defense
-                : defender->sp_defense;
-
-    // BASE DAMAGE (Pokémon-style simplified)
-    float base = (((2.0f * 50 / 5) + 2) * move->power * (float)atk / (float)def) / 50.0f + 2;
-
-    // STAB: Same-Type Attack Bonus
-    float stab = (
-        strcmp(attacker->type1, move->type) == 0 ||
-        strcmp(attacker->type2, move->type) == 0
-    ) ? 1.5f : 1.0f;
-
-    // TYPE EFFECTIVENESS
-    float typeMult = get_type_multiplier(move->type, defender->type1, defender->type2);
+// Damage for the current attack. Both peers draw the random multiplier from
+// (handshake seed, turn, attacker's ATTACK_ANNOUNCE sequence number), so they
+// get the same number independently. After the first use of a move this is
+// one cache lookup and the roll multiply.
+static int roll_damage(BattleContext *ctx, int byMe, uint16_t move) {
+    uint64_t r = battle_rng(ctx->seed, ctx->turn, (uint32_t)ctx->attackSeq, BATTLE_RNG_DAMAGE_ROLL);
+    return (int)damage_apply_roll(matchup_base(ctx, byMe, move), battle_rng_range(r, 85, 100));
+}
 
-    // RANDOM VARIATION
-    float randMult = (rand() % 16 + 85) / 100.0f; // 0.85 to 1.00
+// Fold a settled attack into the running state hash: the RNG position
+// (turn, attack sequence), the move and both HPs, host first, so the
+// value is the same on both peers
+static void fold_state_hash(BattleContext *ctx) {
+    uint16_t hostHP = (uint16_t)(ctx->isHost ? ctx->myHP : ctx->oppHP);
+    uint16_t joinerHP = (uint16_t)(ctx->isHost ? ctx->oppHP : ctx->myHP);
+    uint64_t h = splitmix64(ctx->stateHash ^ (((uint64_t)ctx->turn << 32) | (uint32_t)ctx->attackSeq));
+    ctx->stateHash = splitmix64(h ^ (((uint64_t)ctx->lastMoveUsed << 32) | ((uint32_t)hostHP << 16) | joinerHP));
+}
 
-    // FINAL DAMAGE
-    float dmg = base * stab * typeMult * randMult;
+int battle_apply_attack(BattleContext *ctx, int byMe, uint16_t move) {
+    int16_t *hp = byMe ? &ctx->oppHP : &ctx->myHP;
 
-    if (dmg < 1) dmg = 1; // minimum damage rule
+    int dmg = roll_damage(ctx, byMe, move);
+    *hp -= dmg;
+    if (*hp < 0)
+        *hp = 0;
 
-    return (int)dmg;
+    ctx->lastDamage = dmg;
+    ctx->lastRemainingHP = *hp;
+    fold_state_hash(ctx);
+    return dmg;
 }
 
-void handle_defense_announce(BattleManager *bm, const char *msg, char name[64]) {
+static int handle_defense_announce(BattleManager *bm, const char *msg) {
+    (void)msg;
     BattleContext *ctx = &bm->ctx;
 
-    printf("[GAME] Opponent ready. Calculating damage...\n");
-
-    Move *mv = getMoveByName(ctx->lastMoveUsed,name);
+    game_print("[GAME] Opponent ready. Calculating damage...\n");
 
-    int dmg = calculate_damage(&ctx->myPokemon, &ctx->oppPokemon, mv);
-    
-    ctx->oppPokemon.hp -= dmg;
-    if (ctx->oppPokemon.hp < 0)
-        ctx->oppPokemon.hp = 0;
-
-    ctx->lastDamage = dmg;
-    ctx->lastRemainingHP = ctx->oppPokemon.hp;
+    if (!ctx->myPokemon || !ctx->oppPokemon) {
+        game_print("[ERROR] Both Pokemon must be set before attacking.\n");
+        return OUTCOME_STAY;
+    }
 
-    if (ctx->oppPokemon.hp <= 0) {
-    
-        snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
-            "message_type: GAME_OVER\n"
-            "winner: %s\n"
-            "loser: %s\n"
-            "sequence_number: %d\n",
-            ctx->myPokemon.name,
-            ctx->oppPokemon.name,
-            ++ctx->currentSequenceNum
-        );
+    int dmg = settle_attack(ctx, 1, ctx->lastMoveUsed);
 
-        ctx->currentState = STATE_GAME_OVER;
-        printf("[GAME] Opponent fainted! GAME_OVER triggered.\n");
-        return;
+    if (ctx->oppHP <= 0) {
+        send_game_over(bm, BM_TO_PEER);
+        game_print("[GAME] Opponent fainted! GAME_OVER triggered.\n");
+        return OUTCOME_ALT;
     }
 
-    snprintf(bm->outgoingBuffer, BM_MAX_MSG_SIZE,
+    // Only the hash goes out; the full numbers follow in a
+    // RESOLUTION_REQUEST if the defender's hash differs
+    game_print("[GAME] %s dealt %d damage with %s (opponent HP %d)\n",
+           pokemon_name(ctx->dex, ctx->myPokemon), dmg, move_name(ctx->dex, ctx->lastMoveUsed), ctx->oppHP);
+    BattleManager_Send(bm, BM_TO_PEER,
         "message_type: CALCULATION_REPORT\n"
-        "attacker: %s\n"
-        "move_used: %s\n"
-        "remaining_health: %d\n"
-        "damage_dealt: %d\n"
-        "defender_hp_remaining: %d\n"
-        "status_message: %s dealt %d damage with %s\n"
+        "state_hash: %016llx\n"
         "sequence_number: %d\n",
-        ctx->myPokemon.name,
-        ctx->lastMoveUsed,
-        ctx->myPokemon.hp,
-        dmg,
-        ctx->oppPokemon.hp,
-        ctx->myPokemon.name,
-        dmg,
-        ctx->lastMoveUsed,
+        (unsigned long long)ctx->stateHash,
         ++ctx->currentSequenceNum
     );
+    return OUTCOME_NEXT;
+}
+
+/* ------------------------------------------
+    Battle state machine
+------------------------------------------- */
+typedef int (*BattleHandler)(BattleManager *bm, const char *msg);
+
+typedef struct {
+    BattleHandler handler; // NULL = message not allowed in this state
+    uint8_t next;          // state after OUTCOME_NEXT
+    uint8_t alt;           // state after OUTCOME_ALT
+} BattleTransition;
+
+// A peer may concede or faint at any point until the battle is over
+#define ON_GAME_OVER [BATTLE_MSG_GAME_OVER] = { handle_game_over, STATE_GAME_OVER, STATE_GAME_OVER }
+
+static const BattleTransition battle_fsm[STATE_COUNT][BATTLE_MSG_COUNT] = {
+    [STATE_WAITING_FOR_MOVE] = {
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_ATTACK] = {
+        [BATTLE_MSG_ATTACK_ANNOUNCE] = { handle_attack_announce, STATE_WAITING_FOR_REPORT, STATE_WAITING_FOR_REPORT },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_DEFENSE] = {
+        [BATTLE_MSG_DEFENSE_ANNOUNCE] = { handle_defense_announce, STATE_WAITING_FOR_CONFIRM, STATE_GAME_OVER },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_REPORT] = {
+        [BATTLE_MSG_CALCULATION_REPORT] = { handle_calculation_report, STATE_WAITING_FOR_MOVE, STATE_WAITING_FOR_RESOLUTION },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_CONFIRM] = {
+        [BATTLE_MSG_CALCULATION_CONFIRM] = { handle_calculation_confirm, STATE_WAITING_FOR_ATTACK, STATE_WAITING_FOR_ATTACK },
+        [BATTLE_MSG_RESOLUTION_REQUEST] = { handle_resolution_request, STATE_WAITING_FOR_ATTACK, STATE_GAME_OVER },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_RESOLUTION] = {
+        [BATTLE_MSG_ACK] = { handle_ack, STATE_WAITING_FOR_MOVE, STATE_WAITING_FOR_MOVE },
+        ON_GAME_OVER,
+    },
+    [STATE_GAME_OVER] = { { NULL, 0, 0 } },
+};
+
+// Fast turns (negotiated in BATTLE_SETUP): ATTACK_ANNOUNCE carries the result
+// and a state commitment, and a single reply settles the turn
+static const BattleTransition battle_fsm_fast[STATE_COUNT][BATTLE_MSG_COUNT] = {
+    [STATE_WAITING_FOR_MOVE] = {
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_ATTACK] = {
+        [BATTLE_MSG_ATTACK_ANNOUNCE] = { handle_attack_commit, STATE_WAITING_FOR_MOVE, STATE_WAITING_FOR_RESOLUTION },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_DEFENSE] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_REPORT] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_CONFIRM] = {
+        [BATTLE_MSG_CALCULATION_CONFIRM] = { handle_calculation_confirm, STATE_WAITING_FOR_ATTACK, STATE_WAITING_FOR_ATTACK },
+        [BATTLE_MSG_RESOLUTION_REQUEST] = { handle_resolution_request, STATE_WAITING_FOR_ATTACK, STATE_GAME_OVER },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_RESOLUTION] = {
+        [BATTLE_MSG_ACK] = { handle_ack, STATE_WAITING_FOR_MOVE, STATE_WAITING_FOR_MOVE },
+        ON_GAME_OVER,
+    },
+    [STATE_GAME_OVER] = { { NULL, 0, 0 } },
+};
+
+// Hosted turns: the host resolves every attack. Its own moves go straight
+// out as TURN_RESULT; the joiner's arrive as MOVE_INTENT and are answered
+// with one. The roles see different messages, so each has a table.
+static const BattleTransition battle_fsm_hosted_host[STATE_COUNT][BATTLE_MSG_COUNT] = {
+    [STATE_WAITING_FOR_MOVE] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_ATTACK] = {
+        [BATTLE_MSG_MOVE_INTENT] = { handle_move_intent, STATE_WAITING_FOR_MOVE, STATE_WAITING_FOR_MOVE },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_DEFENSE] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_REPORT] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_CONFIRM] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_RESOLUTION] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_RESULT] = { ON_GAME_OVER },
+    [STATE_GAME_OVER] = { { NULL, 0, 0 } },
+};
+
+static const BattleTransition battle_fsm_hosted_joiner[STATE_COUNT][BATTLE_MSG_COUNT] = {
+    [STATE_WAITING_FOR_MOVE] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_ATTACK] = {
+        [BATTLE_MSG_TURN_RESULT] = { handle_turn_result, STATE_WAITING_FOR_MOVE, STATE_WAITING_FOR_MOVE },
+        ON_GAME_OVER,
+    },
+    [STATE_WAITING_FOR_DEFENSE] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_REPORT] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_CONFIRM] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_RESOLUTION] = { ON_GAME_OVER },
+    [STATE_WAITING_FOR_RESULT] = {
+        [BATTLE_MSG_TURN_RESULT] = { handle_turn_result, STATE_WAITING_FOR_ATTACK, STATE_WAITING_FOR_ATTACK },
+        ON_GAME_OVER,
+    },
+    [STATE_GAME_OVER] = { { NULL, 0, 0 } },
+};
+
+typedef BattleTransition BattleTable[STATE_COUNT][BATTLE_MSG_COUNT];
+
+// [turn mode][isHost]
+static const BattleTable *const battle_tables[TURN_MODE_COUNT][2] = {
+    [TURN_MODE_CLASSIC] = { &battle_fsm, &battle_fsm },
+    [TURN_MODE_FAST] = { &battle_fsm_fast, &battle_fsm_fast },
+    [TURN_MODE_HOSTED] = { &battle_fsm_hosted_joiner, &battle_fsm_hosted_host },
+};
+
+static const char *const battle_state_names[STATE_COUNT] = {
+    "WAITING_FOR_MOVE", "WAITING_FOR_ATTACK", "WAITING_FOR_DEFENSE", "WAITING_FOR_REPORT",
+    "WAITING_FOR_CONFIRM", "WAITING_FOR_RESOLUTION", "WAITING_FOR_RESULT", "GAME_OVER"
+};
+
+static const char *const battle_msg_names[BATTLE_MSG_COUNT] = {
+    "ATTACK_ANNOUNCE", "DEFENSE_ANNOUNCE", "CALCULATION_REPORT", "CALCULATION_CONFIRM",
+    "RESOLUTION_REQUEST", "ACK", "GAME_OVER", "MOVE_INTENT", "TURN_RESULT"
+};
+
+const char* BattleManager_StateName(int state) {
+    return state >= 0 && state < STATE_COUNT ? battle_state_names[state] : "?";
+}
 
-    // ctx->oppPokemon.hp = remaining_hp;
+// One switch on the name length picks the only candidate, one memcmp confirms it
+BattleMsgType BattleManager_MessageType(const char *msg) {
+    const char *t = strstr(msg, "message_type: ");
+    if (!t) return BATTLE_MSG_NONE;
+    t += strlen("message_type: ");
+    if (*t == '"') t++; // tolerate a quoted value
+    size_t len = strcspn(t, "\"\r\n ");
+
+    BattleMsgType type;
+    switch (len) {
+    case 3:  type = BATTLE_MSG_ACK; break;
+    case 9:  type = BATTLE_MSG_GAME_OVER; break;
+    case 11: type = t[0] == 'M' ? BATTLE_MSG_MOVE_INTENT : BATTLE_MSG_TURN_RESULT; break;
+    case 15: type = BATTLE_MSG_ATTACK_ANNOUNCE; break;
+    case 16: type = BATTLE_MSG_DEFENSE_ANNOUNCE; break;
+    case 18: type = t[0] == 'C' ? BATTLE_MSG_CALCULATION_REPORT : BATTLE_MSG_RESOLUTION_REQUEST; break;
+    case 19: type = BATTLE_MSG_CALCULATION_CONFIRM; break;
+    default: return BATTLE_MSG_NONE;
+    }
+    return memcmp(t, battle_msg_names[type], len) == 0 ? type : BATTLE_MSG_NONE;
+}
 
-    // Keep turn state
-    ctx->currentState = STATE_PROCESSING_TURN;
-}
\ No newline at end of file
+int BattleManager_HandleMessage(BattleManager *bm, const char *msg) {
+    BattleContext *ctx = &bm->ctx;
+    BattleMsgType type = BattleManager_MessageType(msg);
+    if (type == BATTLE_MSG_NONE) return -1;
+
+    const BattleTransition *tr = &(*battle_tables[ctx->turnMode][ctx->isHost])[ctx->currentState][type];
+    int seq = extract_int(msg, "sequence_number: ");
+    if (!tr->handler || (seq > 0 && seq <= ctx->lastPeerSeq)) {
+        ctx->rejectedMessages++;
+        game_print("[GAME] Ignored %s (sequence %d) in state %s (%u rejected so far)\n",
+               battle_msg_names[type], seq, battle_state_names[ctx->currentState], (unsigned)ctx->rejectedMessages);
+        return 0;
+    }
+    if (seq > 0) ctx->lastPeerSeq = seq;
+
+    int outcome = tr->handler(bm, msg);
+    if (outcome == OUTCOME_OVER) {
+        end_battle(ctx, seq);
+    } else if (outcome != OUTCOME_STAY) {
+        ctx->currentState = outcome == OUTCOME_NEXT ? tr->next : tr->alt;
+        if (ctx->currentState == STATE_GAME_OVER)
+            log_end(ctx);
+        ctx->isMyTurn = ctx->currentState == STATE_WAITING_FOR_MOVE ||
+                        ctx->currentState == STATE_WAITING_FOR_DEFENSE ||
+                        ctx->currentState == STATE_WAITING_FOR_CONFIRM;
+    }
+    return 1;
+}
@@ -2,13 +2,49 @@
 #define BATTLE_MANAGER_H
 
 #define BM_MAX_MSG_SIZE 1024
-#define STATE_WAITING_FOR_MOVE 0
-#define STATE_PROCESSING_TURN 1
-#define STATE_WAITING_FOR_RESOLUTION 2
-#define STATE_GAME_OVER 3
 #include "pokemon_data.h" // Includes the correct definitions for Pokemon and Move
+#include "damage_cache.h"
+#include "battle_log.h"
 #include <stdbool.h> 
 
+typedef struct BattleAi BattleAi; // computer player, battle_ai.h
+
+// --- Battle states: one per step of a turn, from this peer's point of view ---
+typedef enum {
+    STATE_WAITING_FOR_MOVE,       // our turn: the local player picks a move
+    STATE_WAITING_FOR_ATTACK,     // their turn: expecting ATTACK_ANNOUNCE
+    STATE_WAITING_FOR_DEFENSE,    // we attacked: expecting DEFENSE_ANNOUNCE
+    STATE_WAITING_FOR_REPORT,     // we defended: expecting CALCULATION_REPORT
+    STATE_WAITING_FOR_CONFIRM,    // we reported: expecting CALCULATION_CONFIRM or RESOLUTION_REQUEST
+    STATE_WAITING_FOR_RESOLUTION, // we disputed the report: expecting ACK
+    STATE_WAITING_FOR_RESULT,     // hosted joiner sent MOVE_INTENT: expecting TURN_RESULT
+    STATE_GAME_OVER,
+    STATE_COUNT
+} BattleState;
+
+// --- Message types the battle state machine dispatches on ---
+typedef enum {
+    BATTLE_MSG_ATTACK_ANNOUNCE,
+    BATTLE_MSG_DEFENSE_ANNOUNCE,
+    BATTLE_MSG_CALCULATION_REPORT,
+    BATTLE_MSG_CALCULATION_CONFIRM,
+    BATTLE_MSG_RESOLUTION_REQUEST,
+    BATTLE_MSG_ACK,
+    BATTLE_MSG_GAME_OVER,
+    BATTLE_MSG_MOVE_INTENT,        // hosted turns: joiner -> host
+    BATTLE_MSG_TURN_RESULT,        // hosted turns: host -> joiner and spectators
+    BATTLE_MSG_COUNT,
+    BATTLE_MSG_NONE = BATTLE_MSG_COUNT // anything else (chat, setup, ...)
+} BattleMsgType;
+
+// --- How a turn is settled, agreed through "turn_mode:" in BATTLE_SETUP ---
+typedef enum {
+    TURN_MODE_CLASSIC, // ATTACK_ANNOUNCE, DEFENSE_ANNOUNCE, CALCULATION_REPORT, CALCULATION_CONFIRM
+    TURN_MODE_FAST,    // ATTACK_ANNOUNCE with a state commitment, then CALCULATION_CONFIRM
+    TURN_MODE_HOSTED,  // the host resolves everything: MOVE_INTENT, then TURN_RESULT
+    TURN_MODE_COUNT
+} BattleTurnMode;
+
 // NOTE: The conflicting Move struct definition has been removed from here.
 
 typedef struct {
@@ -21,51 +57,183 @@ typedef struct {
    int damage;
 } CalculationReport;
 
+// Per-battle pre-roll damage of the moves used so far, direct-mapped by move
+// ID: a battle uses a handful of moves, so a few slots per side keep the
+// context small (a collision only costs a recomputation)
+#define BM_DAMAGE_SLOTS 8
+
 typedef struct {
-    // These now use the updated Pokemon struct from pokemon_data.h
-    Pokemon myPokemon;
-    Pokemon oppPokemon;
+    uint16_t move;           // move ID the slot holds
+    uint16_t base;           // its pre-roll damage + 2, 0 = empty
+} BattleDamageSlot;
 
-    int currentState;
-    bool isMyTurn;
+// Mutable per-battle state only; species data is shared and read-only.
+typedef struct {
+    const Pokedex *dex;      // shared Pokedex the IDs below refer to
+    const Pokemon *myPokemon;
+    const Pokemon *oppPokemon;
+
+    int16_t myHP;
+    int16_t oppHP;
+    uint16_t lastMoveUsed;   // move ID, MOVE_NONE before the first attack
+    int16_t lastDamage;
+    int16_t lastRemainingHP;
+    uint8_t currentState;    // BattleState, changed only by the transition table
+    bool isMyTurn;           // we attack this turn (follows currentState)
     int currentSequenceNum;
-
-    char lastMoveUsed[64];
-    int lastDamage;
-    int lastRemainingHP;
+    uint64_t seed;           // from HANDSHAKE_RESPONSE, shared by both peers
+    uint32_t turn;           // attacks announced so far (both sides count)
+    int attackSeq;           // sequence_number of the current ATTACK_ANNOUNCE
+    int lastPeerSeq;         // highest sequence_number accepted from the peer
+    uint64_t stateHash;      // running hash of every settled attack (both HPs, turn, sequence)
+    uint8_t turnMode;        // BattleTurnMode, fixed before the first turn
+    bool isHost;
+    uint32_t rejectedMessages; // battle messages dropped as invalid in the current state
+    BattleDamageSlot damageCache[2][BM_DAMAGE_SLOTS]; // [byMe][move ID % slots]
+    DamageCache *sharedDamage;         // optional process-wide cache, NULL = off
+    BattleLog *log;                    // optional event log, NULL = off
+    BattleAi *ai;                      // optional computer player for "AUTO" input, NULL = off
 } BattleContext;
 
+// --- Outgoing messages of one step, in the order they were built ---
+// A step (one received message, one input) may produce several messages,
+// e.g. a TURN_RESULT for the peer and spectators plus a GAME_OVER. They are
+// stored back to back, NUL-terminated, so the transport can send them in one
+// batch; clearing only resets the counters.
+#define BM_OUTBOX_MAX 4
+#define BM_OUTBOX_BYTES BM_MAX_MSG_SIZE // battle messages are a few hundred bytes
+
+typedef enum {
+    BM_TO_PEER = 1,       // the other player
+    BM_TO_SPECTATORS = 2, // everyone watching (hosted turns)
+    BM_TO_ALL = BM_TO_PEER | BM_TO_SPECTATORS
+} BattleAudience;
+
+typedef struct {
+    uint16_t offset;  // into BattleOutbox.data
+    uint16_t length;  // without the NUL
+    uint8_t audience; // BattleAudience bits
+} BattleOutMsg;
+
+typedef struct {
+    uint8_t count;
+    uint16_t used;
+    BattleOutMsg msgs[BM_OUTBOX_MAX];
+    char data[BM_OUTBOX_BYTES];
+} BattleOutbox;
+
 typedef struct {
     BattleContext ctx;
-    char outgoingBuffer[BM_MAX_MSG_SIZE]; // buffer for messages to send
+    BattleOutbox outbox; // messages to send, filled by handlers
 } BattleManager;
 
-void handle_attack_announce(BattleManager *bm, const char *msg);
-void handle_defense_announce(BattleManager *bm, const char *msg, char name[64]);
-void handle_calculation_report(BattleManager *bm, const char *msg);
-void handle_calculation_confirm(BattleManager *bm, const char *msg);  
-void handle_game_over(BattleManager *bm, const char *msg);
-void handle_resolution_request(BattleManager *bm, const char *msg);
+// Battle message type of a received packet (BATTLE_MSG_NONE if it is not one)
+BattleMsgType BattleManager_MessageType(const char *msg);
+
+// Run a received battle message through the transition table. Returns 1 if
+// it was handled, 0 if it is not valid in the current state (or repeats an
+// old sequence number) and was dropped and counted, -1 if it is not a
+// battle message at all.
+int BattleManager_HandleMessage(BattleManager *bm, const char *msg);
+
+// Readable name of a BattleState, for logs
+const char* BattleManager_StateName(int state);
 
-// Initialize BattleManager (Host = 1, Joiner = 0)
+// Initialize BattleManager (Host = 1, Joiner = 0). Pins the current Pokedex
+// snapshot; call BattleManager_Release before initialising the same bm again.
 void BattleManager_Init(BattleManager *bm, int isHost, const char *myPokeName);
 
+// Drop this battle's Pokedex snapshot
+void BattleManager_Release(BattleManager *bm);
+
+// Seed the battle's damage rolls with the handshake seed (both peers must use
+// the same value; call after BattleManager_Init)
+void BattleManager_SetSeed(BattleManager *bm, uint64_t seed);
+
+// Pick how turns are settled. Returns 0 once the first turn has started.
+// FAST: the attacker resolves its own attack and sends the move with the
+// result and a hash of the resulting state; the defender recomputes it and
+// answers with one CALCULATION_CONFIRM, or a RESOLUTION_REQUEST on a mismatch.
+// HOSTED: only the host computes damage; the joiner sends MOVE_INTENT and
+// takes the host's TURN_RESULT as final.
+int BattleManager_SetTurnMode(BattleManager *bm, BattleTurnMode mode);
+
+// The mode both peers end up with, from the two BATTLE_SETUP turn_mode
+// values: HOSTED is the host's call, FAST needs both sides, else CLASSIC
+BattleTurnMode BattleManager_NegotiateTurnMode(const char *hostMode, const char *joinerMode);
 
-// Handle user input (move names)
+// Share a process-wide damage cache between battles (NULL = per-battle cache
+// only). The cache must outlive the battle; it is skipped if it was built
+// for a different Pokedex snapshot.
+void BattleManager_SetDamageCache(BattleManager *bm, DamageCache *cache);
+
+// Append this battle to an event log (NULL = off; call after
+// BattleManager_Init). The log must outlive the battle and may be shared by
+// consecutive battles, but not by two at once.
+void BattleManager_SetLog(BattleManager *bm, BattleLog *log);
+
+// Let a computer player pick this side's moves: HandleUserInput("AUTO")
+// plays the move it chooses (NULL = off; call after BattleManager_Init).
+// The BattleAi must outlive the battle and serve no other battle meanwhile.
+void BattleManager_SetAi(BattleManager *bm, BattleAi *ai);
+
+// Set the opponent's Pokemon once their BATTLE_SETUP arrives
+void BattleManager_SetOpponent(BattleManager *bm, const char *oppPokeName);
+
+// Display names for message building (empty string if not set)
+const char* BattleManager_MyPokemonName(const BattleManager *bm);
+const char* BattleManager_OppPokemonName(const BattleManager *bm);
+const char* BattleManager_LastMoveName(const BattleManager *bm);
+
+
+// Handle user input (move names; "Fla?" lists matching moves; "AUTO" lets
+// the computer player set with BattleManager_SetAi choose)
 void BattleManager_HandleUserInput(BattleManager *bm, const char *input);
 
+// Build the NAME_QUERY_RESULT for a lobby NAME_QUERY ("kind: pokemon|move",
+// "prefix: ..."): prefix matches, or nearest spellings when nothing matches.
+void BattleManager_AnswerNameQuery(const char *query, char *reply, size_t reply_size);
+
 // Check if battle is over
 int BattleManager_CheckWinLoss(BattleManager *bm);
 
-// Get the next outgoing message (filled by handlers)
+// Queue a message (printf-style) for the given BattleAudience. Returns 0 and
+// drops it when the outbox is full.
+int BattleManager_Send(BattleManager *bm, int audience, const char *fmt, ...);
+
+// Messages queued since the last clear, and the i-th of them (its length
+// and BattleAudience through len / audience when not NULL)
+int BattleManager_OutgoingCount(const BattleManager *bm);
+const char* BattleManager_OutgoingAt(const BattleManager *bm, int i, size_t *len, int *audience);
+
+// The first queued message ("" if none), for callers that expect one reply
 const char* BattleManager_GetOutgoingMessage(BattleManager *bm);
 
-// Clear outgoing buffer after sending
+// Drop every queued message after sending (O(1))
 void BattleManager_ClearOutgoingMessage(BattleManager *bm);
 
+// Queue GAME_OVER for the peer and spectators and end the battle
 void BattleManager_TriggerGameOver(BattleManager *bm, const char *winner, const char *loser);
+
+// Turn the [GAME] console output on or off for every battle (default on).
+// Processes running many battles at once switch it off before starting.
+void BattleManager_SetConsoleOutput(bool enabled);
+
+// Damage of one hit; roll is the random percentage (85..100)
+int calculate_damage(const Pokemon *attacker, const Pokemon *defender, const Move *move, int roll);
+
+// Everything but the roll (DAMAGE_BASE_NONE if the move cannot hurt);
+// calculate_damage() == damage_apply_roll(calculate_damage_base(), roll)
+int32_t calculate_damage_base(const Pokemon *attacker, const Pokemon *defender, const Move *move);
+
+// One attack on the battle state, no messages or I/O: rolls the damage for
+// (seed, turn, attackSeq), lowers the defender's HP and folds the result
+// into stateHash. byMe = 1 when myPokemon attacks. Returns the damage dealt.
+// Also drives tools/battle_sim.c.
+int battle_apply_attack(BattleContext *ctx, int byMe, uint16_t move);
+
 // Initialize the battle context
-void init_battle(BattleContext *ctx, int isHost, const char *myPokeName);
+void init_battle(BattleContext *ctx, const Pokedex *dex, int isHost, const char *myPokeName);
 
 void clean_newline(char *str);
 
@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+#include "battle_ai.h"
+#include "damage_batch.h"
+#include "thread_compat.h"
+
+#define CACHE_LINE 64
+#define AI_ROLL_MIN 85
+#define AI_ROLLS 16          // damage rolls 85..100
+#define AI_MAX_ATTACKS 32    // distinct moves per side, strongest first
+#define AI_MAX_DEPTH 250
+#define AI_CLOCK_NODES 4096  // nodes between deadline checks (power of two)
+
+// A search position: copied into every child, never undone
+typedef struct {
+    int16_t hp[2]; // [0] = ours, [1] = the opponent's
+    uint8_t side;  // 0 = we attack next
+} AiPosition;
+
+// One move's damage distribution against the other side
+typedef struct {
+    uint16_t move;
+    uint8_t outcomes;
+    uint8_t weight[AI_ROLLS]; // rolls that give damage[i]
+    int16_t damage[AI_ROLLS];
+    int32_t base;
+} AiAttack;
+
+typedef struct {
+    AiAttack attacks[2][AI_MAX_ATTACKS]; // [side]
+    int count[2];
+    int16_t maxHP[2];
+} AiModel;
+
+// Transposition table entry; all zero = empty
+typedef struct {
+    float value;
+    uint8_t depth; // plies the value looked ahead
+    uint8_t exact;
+} AiEntry;
+
+typedef struct {
+    struct BattleAi *ai;
+    int id;
+    int stop;          // own deadline passed
+    uint64_t nodes;
+    AiEntry *table;    // (hp0, hp1, side) -> entry
+    size_t tableCap;
+    bm_thread_t thread;
+    char pad[CACHE_LINE];
+} AiWorker;
+
+struct BattleAi {
+    BattleAiConfig config;
+    AiWorker *workers;
+    int workerCount;
+
+    // Matchup the model and the tables belong to
+    const Pokedex *dex;
+    const Pokemon *mine;
+    const Pokemon *theirs;
+    AiModel model;
+    size_t tableSize;
+
+    // Current search: root move i is searched by worker i % workerCount only
+    AiPosition root;
+    uint64_t deadline;
+    int maxDepth;
+    uint8_t doneDepth[AI_MAX_ATTACKS]; // deepest finished depth
+    uint8_t exactAt[AI_MAX_ATTACKS];   // depth whose value is exact, 0 = none yet
+    float value[AI_MAX_DEPTH + 1][AI_MAX_ATTACKS];
+};
+
+/* ------------------------------------------
+    Model
+------------------------------------------- */
+static int by_base_desc(const void *a, const void *b) {
+    const AiAttack *x = (const AiAttack *)a, *y = (const AiAttack *)b;
+    if (x->base != y->base) return x->base < y->base ? 1 : -1;
+    return (int)x->move - (int)y->move;
+}
+
+// Damaging moves of attacker, one per distinct base damage
+static int build_attacks(const Pokedex *dex, const Pokemon *attacker, const Pokemon *defender, AiAttack *out) {
+    AiAttack all[MOVE_MAX];
+    int n = 0;
+    for (uint16_t id = 0; id < dex->move_count && id < MOVE_MAX; id++) {
+        if (!pokemon_knows_move(attacker, id)) continue;
+        int32_t base = calculate_damage_base(attacker, defender, &dex->moves[id]);
+        if (base == DAMAGE_BASE_NONE) continue;
+        int dup = 0;
+        for (int i = 0; i < n && !dup; i++) dup = all[i].base == base;
+        if (dup) continue; // same distribution as a move already listed
+
+        AiAttack *a = &all[n++];
+        a->move = id;
+        a->base = base;
+        a->outcomes = 0;
+        for (int r = 0; r < AI_ROLLS; r++) {
+            int16_t dmg = (int16_t)damage_apply_roll(base, AI_ROLL_MIN + r);
+            if (a->outcomes && a->damage[a->outcomes - 1] == dmg) {
+                a->weight[a->outcomes - 1]++;
+            } else {
+                a->damage[a->outcomes] = dmg;
+                a->weight[a->outcomes++] = 1;
+            }
+        }
+    }
+    qsort(all, (size_t)n, sizeof(AiAttack), by_base_desc);
+    if (n > AI_MAX_ATTACKS) n = AI_MAX_ATTACKS;
+    memcpy(out, all, sizeof(AiAttack) * (size_t)n);
+    return n;
+}
+
+// New matchup: rebuild the model and empty every table. 0 on failure.
+static int set_matchup(BattleAi *ai, const BattleContext *ctx) {
+    AiModel *m = &ai->model;
+    m->count[0] = build_attacks(ctx->dex, ctx->myPokemon, ctx->oppPokemon, m->attacks[0]);
+    m->count[1] = build_attacks(ctx->dex, ctx->oppPokemon, ctx->myPokemon, m->attacks[1]);
+    m->maxHP[0] = (int16_t)ctx->myPokemon->hp;
+    m->maxHP[1] = (int16_t)ctx->oppPokemon->hp;
+
+    ai->tableSize = ((size_t)m->maxHP[0] + 1) * ((size_t)m->maxHP[1] + 1) * 2;
+    for (int i = 0; i < ai->workerCount; i++) {
+        AiWorker *w = &ai->workers[i];
+        if (w->tableCap < ai->tableSize) {
+            free(w->table);
+            w->table = (AiEntry *)malloc(sizeof(AiEntry) * ai->tableSize);
+            w->tableCap = w->table ? ai->tableSize : 0;
+            if (!w->table) {
+                ai->dex = NULL;
+                return 0;
+            }
+        }
+        memset(w->table, 0, sizeof(AiEntry) * ai->tableSize);
+    }
+    ai->dex = ctx->dex;
+    ai->mine = ctx->myPokemon;
+    ai->theirs = ctx->oppPokemon;
+    return 1;
+}
+
+/* ------------------------------------------
+    Search
+------------------------------------------- */
+// Leaf guess from the HP fractions, strictly between the loss (0) and the
+// win (1) that a finished line scores
+static float estimate(const AiModel *m, AiPosition pos) {
+    return 0.5f + 0.5f * ((float)pos.hp[0] / (float)m->maxHP[0] - (float)pos.hp[1] / (float)m->maxHP[1]);
+}
+
+static float search(AiWorker *w, AiPosition pos, int depth, int *exact);
+
+// Expected value of one attack by pos.side over its damage rolls
+static float expect(AiWorker *w, AiPosition pos, const AiAttack *a, int depth, int *exact) {
+    int target = pos.side ^ 1;
+    AiPosition child = pos;
+    child.side = (uint8_t)target;
+    float sum = 0.0f;
+    for (int i = 0; i < a->outcomes; i++) {
+        int hp = pos.hp[target] - a->damage[i];
+        child.hp[target] = (int16_t)(hp < 0 ? 0 : hp);
+        sum += (float)a->weight[i] * search(w, child, depth - 1, exact);
+    }
+    return sum * (1.0f / AI_ROLLS);
+}
+
+// Value of pos for us looking depth plies ahead; *exact is cleared if the
+// value rests on a guess (depth limit) or an aborted search
+static float search(AiWorker *w, AiPosition pos, int depth, int *exact) {
+    if (pos.hp[1] <= 0) return 1.0f;
+    if (pos.hp[0] <= 0) return 0.0f;
+    const BattleAi *ai = w->ai;
+    if (depth <= 0) {
+        *exact = 0;
+        return estimate(&ai->model, pos);
+    }
+    if ((++w->nodes & (AI_CLOCK_NODES - 1)) == 0 && bm_time_ms() >= ai->deadline) w->stop = 1;
+    if (w->stop) {
+        *exact = 0;
+        return 0.5f;
+    }
+
+    const AiModel *m = &ai->model;
+    size_t at = (((size_t)pos.hp[0] * ((size_t)m->maxHP[1] + 1)) + (size_t)pos.hp[1]) * 2 + pos.side;
+    AiEntry *e = &w->table[at];
+    if (e->exact || e->depth >= depth) {
+        if (!e->exact) *exact = 0;
+        return e->value;
+    }
+
+    int side = pos.side, allExact = 1;
+    float best;
+    if (m->count[side] == 0) {
+        // Nothing that hurts: the turn passes
+        AiPosition child = pos;
+        child.side ^= 1;
+        best = search(w, child, depth - 1, &allExact);
+    } else {
+        best = side ? 2.0f : -1.0f;
+        for (int i = 0; i < m->count[side]; i++) {
+            int ex = 1;
+            float v = expect(w, pos, &m->attacks[side][i], depth, &ex);
+            allExact &= ex;
+            if (side ? v < best : v > best) best = v;
+            // A certain result cannot be improved on (guesses never reach 0 or 1)
+            if (side ? best <= 0.0f : best >= 1.0f) {
+                allExact = ex;
+                break;
+            }
+        }
+    }
+    if (w->stop) {
+        *exact = 0;
+        return best;
+    }
+    e->value = best;
+    e->depth = (uint8_t)depth;
+    e->exact = (uint8_t)allExact;
+    if (!allExact) *exact = 0;
+    return best;
+}
+
+// Iterative deepening over this worker's share of the root moves
+static void search_root(AiWorker *w) {
+    BattleAi *ai = w->ai;
+    const AiModel *m = &ai->model;
+    for (int depth = 1; depth <= ai->maxDepth; depth++) {
+        int pending = 0;
+        for (int i = w->id; i < m->count[0]; i += ai->workerCount) {
+            if (ai->exactAt[i]) continue;
+            int exact = 1;
+            float v = expect(w, ai->root, &m->attacks[0][i], depth, &exact);
+            if (w->stop) return;
+            ai->value[depth][i] = v;
+            ai->doneDepth[i] = (uint8_t)depth;
+            if (exact) ai->exactAt[i] = (uint8_t)depth;
+            else pending = 1;
+        }
+        if (!pending) return;
+    }
+}
+
+static BM_THREAD_RETURN ai_worker_main(void *arg) {
+    search_root((AiWorker *)arg);
+    return BM_THREAD_RESULT;
+}
+
+/* ------------------------------------------
+    Public API
+------------------------------------------- */
+BattleAi* battle_ai_create(const BattleAiConfig *config) {
+    BattleAi *ai = (BattleAi *)calloc(1, sizeof(BattleAi));
+    if (!ai) return NULL;
+    if (config) ai->config = *config;
+    if (ai->config.workers <= 0) ai->config.workers = bm_cpu_count();
+    if (ai->config.workers > AI_MAX_ATTACKS) ai->config.workers = AI_MAX_ATTACKS;
+    if (ai->config.budgetMs <= 0) ai->config.budgetMs = BATTLE_AI_BUDGET_MS;
+    if (ai->config.maxDepth <= 0 || ai->config.maxDepth > AI_MAX_DEPTH) ai->config.maxDepth = AI_MAX_DEPTH;
+
+    ai->workerCount = ai->config.workers;
+    ai->workers = (AiWorker *)calloc((size_t)ai->workerCount, sizeof(AiWorker));
+    if (!ai->workers) {
+        free(ai);
+        return NULL;
+    }
+    for (int i = 0; i < ai->workerCount; i++) {
+        ai->workers[i].ai = ai;
+        ai->workers[i].id = i;
+    }
+    return ai;
+}
+
+void battle_ai_destroy(BattleAi *ai) {
+    if (!ai) return;
+    for (int i = 0; i < ai->workerCount; i++) free(ai->workers[i].table);
+    free(ai->workers);
+    free(ai);
+}
+
+uint16_t battle_ai_choose(BattleAi *ai, const BattleContext *ctx, BattleAiResult *result) {
+    BattleAiResult r;
+    memset(&r, 0, sizeof(r));
+    r.move = MOVE_NONE;
+    uint64_t start = bm_time_ms();
+
+    if (!ai || !ctx->dex || !ctx->myPokemon || !ctx->oppPokemon) {
+        if (result) *result = r;
+        return MOVE_NONE;
+    }
+    if ((ai->dex != ctx->dex || ai->mine != ctx->myPokemon || ai->theirs != ctx->oppPokemon) &&
+        !set_matchup(ai, ctx)) {
+        if (result) *result = r;
+        return MOVE_NONE;
+    }
+
+    const AiModel *m = &ai->model;
+    if (m->count[0] == 0) {
+        // Nothing damaging: any known move does as well as another
+        for (uint16_t id = 0; id < ctx->dex->move_count && r.move == MOVE_NONE; id++)
+            if (pokemon_knows_move(ctx->myPokemon, id)) r.move = id;
+        if (result) *result = r;
+        return r.move;
+    }
+
+    ai->root.hp[0] = (int16_t)(ctx->myHP < m->maxHP[0] ? ctx->myHP : m->maxHP[0]);
+    ai->root.hp[1] = (int16_t)(ctx->oppHP < m->maxHP[1] ? ctx->oppHP : m->maxHP[1]);
+    ai->root.side = 0;
+    ai->deadline = start + (uint64_t)ai->config.budgetMs;
+    ai->maxDepth = ai->config.maxDepth;
+    memset(ai->doneDepth, 0, sizeof(ai->doneDepth));
+    memset(ai->exactAt, 0, sizeof(ai->exactAt));
+
+    // Worker 0 is the calling thread; more threads only if there are moves for them
+    int threads = ai->workerCount < m->count[0] ? ai->workerCount : m->count[0];
+    int started[AI_MAX_ATTACKS] = { 0 };
+    for (int i = 0; i < ai->workerCount; i++) {
+        ai->workers[i].stop = i >= threads; // idle workers skip their (empty) share
+        ai->workers[i].nodes = 0;
+    }
+    for (int i = 1; i < threads; i++)
+        started[i] = bm_thread_create(&ai->workers[i].thread, ai_worker_main, &ai->workers[i]);
+    for (int i = 1; i < threads; i++)
+        if (!started[i]) search_root(&ai->workers[i]); // no thread: search its share here
+    search_root(&ai->workers[0]);
+    for (int i = 1; i < threads; i++)
+        if (started[i]) bm_thread_join(ai->workers[i].thread);
+
+    // Compare every candidate at the deepest depth all of them finished
+    // (all exact: the depth the last of them became exact at)
+    int depth = ai->maxDepth, deepestExact = 0, pending = 0;
+    for (int i = 0; i < m->count[0]; i++) {
+        if (!ai->exactAt[i]) {
+            pending = 1;
+            if (ai->doneDepth[i] < depth) depth = ai->doneDepth[i];
+        } else if (ai->exactAt[i] > deepestExact) {
+            deepestExact = ai->exactAt[i];
+        }
+    }
+    if (!pending) depth = deepestExact;
+
+    int bestIndex = 0;
+    float best = -1.0f;
+    r.exact = 1;
+    for (int i = 0; i < m->count[0] && depth > 0; i++) {
+        int at = ai->exactAt[i] && ai->exactAt[i] <= depth ? ai->exactAt[i] : depth;
+        if (at != ai->exactAt[i]) r.exact = 0;
+        if (ai->value[at][i] > best) {
+            best = ai->value[at][i];
+            bestIndex = i; // ties keep the stronger move
+        }
+    }
+    if (depth == 0) {
+        // Out of time before one ply: the strongest move
+        r.exact = 0;
+        best = estimate(m, ai->root);
+    }
+
+    for (int i = 0; i < ai->workerCount; i++) r.nodes += ai->workers[i].nodes;
+    r.move = m->attacks[0][bestIndex].move;
+    r.winChance = best;
+    r.depth = depth;
+    r.elapsedMs = (uint32_t)(bm_time_ms() - start);
+    if (result) *result = r;
+    return r.move;
+}
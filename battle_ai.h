@@ -0,0 +1,48 @@
+#ifndef BATTLE_AI_H
+#define BATTLE_AI_H
+
+#include <stdint.h>
+#include "BattleManager.h"
+
+// --- Computer player ---
+// Picks a move by expectimax over the battle's own damage model: our move is
+// a max node, each damage roll (85..100 percent, weighted by how many rolls
+// give the same damage) a chance node, the opponent's move a min node. A
+// position is only both HPs and the side to move (6 bytes), so nodes are
+// copied rather than undone, and each search thread keeps a transposition
+// table over all positions of the matchup. The table stays valid for the
+// whole battle, so later moves mostly hit it.
+//
+// The candidate moves are shared out across worker threads. Each deepens its
+// searches one ply at a time until the per-move budget runs out or every
+// value is exact (all lines end in a faint); the choice uses the deepest
+// depth every candidate finished.
+//
+// Plugged into the engine through BattleManager_SetAi: the input "AUTO"
+// then plays the move the AI picks. One BattleAi serves one battle at a time.
+
+#define BATTLE_AI_BUDGET_MS 100 // default time per move
+
+typedef struct {
+    int workers;  // search threads, 0 = one per CPU
+    int budgetMs; // per move, 0 = BATTLE_AI_BUDGET_MS
+    int maxDepth; // plies, 0 = as deep as the budget allows
+} BattleAiConfig;
+
+typedef struct {
+    uint16_t move;     // MOVE_NONE if our Pokemon knows no move
+    float winChance;   // value of the chosen move, 0..1
+    int depth;         // plies every candidate was searched to
+    int exact;         // 1: winChance does not depend on the depth limit
+    uint64_t nodes;
+    uint32_t elapsedMs;
+} BattleAiResult;
+
+// NULL config = defaults; NULL on failure
+BattleAi* battle_ai_create(const BattleAiConfig *config);
+void battle_ai_destroy(BattleAi *ai);
+
+// Best move for ctx->myPokemon, which attacks next. result may be NULL.
+uint16_t battle_ai_choose(BattleAi *ai, const BattleContext *ctx, BattleAiResult *result);
+
+#endif
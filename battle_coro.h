@@ -0,0 +1,103 @@
+#ifndef BATTLE_CORO_H
+#define BATTLE_CORO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Stackless coroutines ---
+// A coroutine is a function that is called again for every event. A switch
+// on the saved resume point jumps back to the wait it stopped at, so a flow
+// reads as straight-line code ("wait for HANDSHAKE_REQUEST, answer, wait for
+// BATTLE_SETUP, ...") instead of callbacks. There is no stack per coroutine:
+// a suspended one costs its BattleCoro plus the frame it keeps in its arena.
+//
+// Rules: locals do not survive a wait (keep them in the frame); a coroutine
+// body cannot contain its own switch around a wait; one wait per line.
+
+typedef struct {
+    uint16_t line; // resume point, 0 = not started
+} BattleCoro;
+
+#define BM_CO_WAITING 0
+#define BM_CO_DONE 1
+#define BM_CO_DONE_LINE 0xFFFF
+
+#define BM_CO_BEGIN(co) switch ((co)->line) { case 0:
+
+// Return until cond holds when the coroutine is resumed (checked right away too)
+#define BM_CO_WAIT(co, cond)                      \
+    do {                                          \
+        (co)->line = __LINE__;                    \
+        /* fall through */                        \
+        case __LINE__:                            \
+        if (!(cond)) return BM_CO_WAITING;        \
+    } while (0)
+
+// Return now; continue after this line on the next resume
+#define BM_CO_YIELD(co)                           \
+    do {                                          \
+        (co)->line = __LINE__;                    \
+        return BM_CO_WAITING;                     \
+        case __LINE__:;                           \
+    } while (0)
+
+#define BM_CO_END(co)                             \
+    default:;                                     \
+    }                                             \
+    (co)->line = BM_CO_DONE_LINE;                 \
+    return BM_CO_DONE
+
+static inline int bm_co_done(const BattleCoro *co) {
+    return co->line == BM_CO_DONE_LINE;
+}
+
+// --- Bump arena for coroutine frames and transient buffers ---
+// Backed by memory the owner provides (a session embeds a block). Frames are
+// allocated first and stay; per-event scratch is allocated after a mark and
+// dropped by rewinding to it. A reset releases everything at once.
+typedef struct {
+    uint8_t *base;
+    uint32_t size;
+    uint32_t used;
+    uint32_t peak; // high-water mark of used
+} BattleArena;
+
+static inline void battle_arena_init(BattleArena *a, void *mem, size_t size) {
+    a->base = (uint8_t *)mem;
+    a->size = (uint32_t)size;
+    a->used = 0;
+    a->peak = 0;
+}
+
+// 8-byte aligned, NULL when the arena is full
+static inline void *battle_arena_alloc(BattleArena *a, size_t size) {
+    uint32_t at = (a->used + 7u) & ~7u;
+    if (at > a->size || size > a->size - at) return NULL;
+    a->used = at + (uint32_t)size;
+    if (a->used > a->peak) a->peak = a->used;
+    return a->base + at;
+}
+
+// NUL-terminated copy of text[0..len), NULL when it does not fit
+static inline char *battle_arena_strndup(BattleArena *a, const char *text, size_t len) {
+    char *copy = (char *)battle_arena_alloc(a, len + 1);
+    if (copy) {
+        for (size_t i = 0; i < len; i++) copy[i] = text[i];
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+static inline uint32_t battle_arena_mark(const BattleArena *a) {
+    return a->used;
+}
+
+static inline void battle_arena_rewind(BattleArena *a, uint32_t mark) {
+    a->used = mark;
+}
+
+static inline void battle_arena_reset(BattleArena *a) {
+    a->used = 0;
+}
+
+#endif
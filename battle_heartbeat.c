@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "battle_heartbeat.h"
+
+// "message_type: <type>" with exactly this type
+static int message_is(const char *msg, const char *type) {
+    const char *t = msg ? strstr(msg, "message_type: ") : NULL;
+    if (!t) return 0;
+    t += strlen("message_type: ");
+    size_t len = strlen(type);
+    return strncmp(t, type, len) == 0 && (t[len] == '\0' || t[len] == '\n' || t[len] == '\r');
+}
+
+static uint32_t sequence_of(const char *msg) {
+    const char *p = strstr(msg, "sequence_number: ");
+    return p ? (uint32_t)strtoul(p + strlen("sequence_number: "), NULL, 10) : 0;
+}
+
+int battle_heartbeat_is_ping(const char *msg) {
+    return message_is(msg, "PING");
+}
+
+int battle_heartbeat_is_pong(const char *msg) {
+    return message_is(msg, "PONG");
+}
+
+void battle_heartbeat_start(BattleHeartbeat *hb, const BattleHeartbeatConfig *config, uint64_t nowMs) {
+    memset(hb, 0, sizeof(*hb));
+    if (config) hb->config = *config;
+    if (hb->config.intervalMs == 0) hb->config.intervalMs = BATTLE_HEARTBEAT_INTERVAL_MS;
+    if (hb->config.minTimeoutMs == 0) hb->config.minTimeoutMs = BATTLE_HEARTBEAT_MIN_TIMEOUT_MS;
+    if (hb->config.maxMissed <= 0) hb->config.maxMissed = BATTLE_HEARTBEAT_MAX_MISSED;
+    hb->lastHeard = nowMs;
+    hb->nextPing = nowMs + hb->config.intervalMs;
+}
+
+// RTO of RFC 6298, clamped: never longer than the PING period, so a quiet
+// peer is probed at a steady rate however slow its link looked
+uint32_t battle_heartbeat_timeout_ms(const BattleHeartbeat *hb) {
+    uint32_t rto = hb->samples ? (uint32_t)(hb->srtt8 / 8 + hb->rttvar4) : hb->config.intervalMs;
+    if (rto < hb->config.minTimeoutMs) rto = hb->config.minTimeoutMs;
+    if (rto > hb->config.intervalMs) rto = hb->config.intervalMs;
+    return rto;
+}
+
+static void rtt_sample(BattleHeartbeat *hb, int32_t rtt) {
+    if (hb->samples++ == 0) {
+        hb->srtt8 = rtt * 8;
+        hb->rttvar4 = rtt * 2; // rttvar = rtt / 2
+        return;
+    }
+    int32_t err = rtt - hb->srtt8 / 8;
+    hb->srtt8 += err;              // srtt += (rtt - srtt) / 8
+    if (err < 0) err = -err;
+    hb->rttvar4 += err - hb->rttvar4 / 4; // rttvar += (|err| - rttvar) / 4
+}
+
+BattleHeartbeatAction battle_heartbeat_poll(BattleHeartbeat *hb, uint64_t nowMs) {
+    if (hb->dead) return BATTLE_HEARTBEAT_IDLE;
+    if (hb->pingOutstanding && nowMs - hb->pingSent >= battle_heartbeat_timeout_ms(hb)) {
+        hb->pingOutstanding = 0;
+        if (hb->lastHeard >= hb->pingSent) {
+            // Other traffic arrived instead of the PONG: alive, no sample
+            hb->nextPing = hb->lastHeard + hb->config.intervalMs;
+        } else if (++hb->missed >= hb->config.maxMissed) {
+            hb->dead = 1;
+            return BATTLE_HEARTBEAT_DEAD;
+        } else {
+            hb->nextPing = nowMs; // probe again straight away
+        }
+    }
+    if (!hb->pingOutstanding && nowMs >= hb->nextPing) {
+        hb->pingSeq++;
+        hb->pingSent = nowMs;
+        hb->pingOutstanding = 1;
+        hb->nextPing = nowMs + hb->config.intervalMs;
+        return BATTLE_HEARTBEAT_PING;
+    }
+    return BATTLE_HEARTBEAT_IDLE;
+}
+
+void battle_heartbeat_heard(BattleHeartbeat *hb, const char *msg, uint64_t nowMs) {
+    if (hb->dead) return; // already reported; battle_heartbeat_start tracks it afresh
+    hb->lastHeard = nowMs;
+    hb->missed = 0;
+    if (hb->pingOutstanding && msg && battle_heartbeat_is_pong(msg) && sequence_of(msg) == hb->pingSeq) {
+        rtt_sample(hb, (int32_t)(nowMs - hb->pingSent));
+        hb->pingOutstanding = 0;
+    }
+    if (!hb->pingOutstanding) hb->nextPing = nowMs + hb->config.intervalMs;
+}
+
+int battle_heartbeat_format_ping(const BattleHeartbeat *hb, char *out, size_t size) {
+    return snprintf(out, size, "message_type: PING\nsequence_number: %u\n", (unsigned)hb->pingSeq);
+}
+
+int battle_heartbeat_answer(const char *msg, char *reply, size_t reply_size) {
+    if (!battle_heartbeat_is_ping(msg)) return 0;
+    snprintf(reply, reply_size, "message_type: PONG\nsequence_number: %u\n", (unsigned)sequence_of(msg));
+    return 1;
+}
@@ -0,0 +1,78 @@
+#ifndef BATTLE_HEARTBEAT_H
+#define BATTLE_HEARTBEAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Liveness of one peer ---
+// While a peer is quiet it is sent a PING every intervalMs, which it answers
+// with a PONG carrying the same sequence number. Each PONG is an RTT sample
+// for a smoothed RTT and RTT variation (Jacobson/Karels, as TCP does), and
+// a probe counts as missed once it has gone unanswered for srtt + 4 * rttvar
+// (at least minTimeoutMs, at most intervalMs). A miss is probed again at
+// once, so a vanished peer is declared dead maxMissed timeouts after the
+// first miss instead of maxMissed whole intervals. Any packet from the peer
+// counts as a sign of life and holds the next PING back.
+//
+// No sockets and no clock here: the caller passes the time (bm_time_ms) and
+// sends the PINGs, so one tracker works for a UDP peer or a pool session.
+//
+//   PING  message_type: PING / sequence_number: n
+//   PONG  message_type: PONG / sequence_number: n
+
+#define BATTLE_HEARTBEAT_INTERVAL_MS 1000   // default PING period of a quiet peer
+#define BATTLE_HEARTBEAT_MIN_TIMEOUT_MS 200 // default floor of the probe timeout
+#define BATTLE_HEARTBEAT_MAX_MISSED 3       // default misses in a row before the peer is dead
+
+typedef struct {
+    uint32_t intervalMs;   // 0 = BATTLE_HEARTBEAT_INTERVAL_MS
+    uint32_t minTimeoutMs; // 0 = BATTLE_HEARTBEAT_MIN_TIMEOUT_MS
+    int maxMissed;         // 0 = BATTLE_HEARTBEAT_MAX_MISSED
+} BattleHeartbeatConfig;
+
+typedef enum {
+    BATTLE_HEARTBEAT_IDLE, // nothing to do
+    BATTLE_HEARTBEAT_PING, // send battle_heartbeat_format_ping now
+    BATTLE_HEARTBEAT_DEAD  // the peer just missed its last probe (reported once)
+} BattleHeartbeatAction;
+
+typedef struct {
+    BattleHeartbeatConfig config;
+    uint64_t lastHeard;    // time of the peer's last packet
+    uint64_t nextPing;
+    uint64_t pingSent;     // time the outstanding PING went out
+    uint32_t pingSeq;      // sequence number of the last PING
+    uint8_t pingOutstanding;
+    uint8_t dead;
+    int missed;            // probes missed in a row
+    uint32_t samples;      // RTT samples taken
+    int32_t srtt8;         // smoothed RTT in ms, times 8
+    int32_t rttvar4;       // RTT variation in ms, times 4
+} BattleHeartbeat;
+
+// Start tracking a peer that was just heard from. NULL config = defaults.
+void battle_heartbeat_start(BattleHeartbeat *hb, const BattleHeartbeatConfig *config, uint64_t nowMs);
+
+// Call on every loop iteration (or timer tick)
+BattleHeartbeatAction battle_heartbeat_poll(BattleHeartbeat *hb, uint64_t nowMs);
+
+// Any packet from the peer. For a PONG, pass the message: a reply to the
+// outstanding PING is an RTT sample (stale replies are not, Karn's rule).
+void battle_heartbeat_heard(BattleHeartbeat *hb, const char *msg, uint64_t nowMs);
+
+// Probe timeout in ms given the RTT seen so far
+uint32_t battle_heartbeat_timeout_ms(const BattleHeartbeat *hb);
+static inline double battle_heartbeat_srtt_ms(const BattleHeartbeat *hb) { return hb->srtt8 / 8.0; }
+static inline double battle_heartbeat_rttvar_ms(const BattleHeartbeat *hb) { return hb->rttvar4 / 4.0; }
+
+// The PING for the current sequence number; returns its length
+int battle_heartbeat_format_ping(const BattleHeartbeat *hb, char *out, size_t size);
+
+// PING / PONG recognisers ("message_type: PING" etc., exact type)
+int battle_heartbeat_is_ping(const char *msg);
+int battle_heartbeat_is_pong(const char *msg);
+
+// If msg is a PING, write the PONG to send back and return 1; 0 otherwise
+int battle_heartbeat_answer(const char *msg, char *reply, size_t reply_size);
+
+#endif
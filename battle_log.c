@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include "battle_log.h"
+#include "battle_rng.h"
+#include "BattleManager.h"
+
+#define SETUP_SIZE 19
+#define END_SIZE 13
+
+static size_t put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return 2;
+}
+
+static size_t put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+    return 8;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+BattleLog* battle_log_open(const char *path) {
+    FILE *f = fopen(path, "ab");
+    if (!f) return NULL;
+    BattleLog *log = (BattleLog *)calloc(1, sizeof(BattleLog));
+    if (!log) {
+        fclose(f);
+        return NULL;
+    }
+    log->file = f;
+    return log;
+}
+
+void battle_log_close(BattleLog *log) {
+    if (!log) return;
+    fclose(log->file);
+    free(log);
+}
+
+void battle_log_setup(BattleLog *log, const Pokedex *dex, uint64_t seed,
+                      uint16_t hostPokemon, uint16_t joinerPokemon, uint8_t turnMode) {
+    uint8_t rec[SETUP_SIZE], *p = rec;
+    *p++ = 'S';
+    *p++ = BATTLE_LOG_VERSION;
+    p += put_u64(p, seed);
+    p += put_u16(p, hostPokemon);
+    p += put_u16(p, joinerPokemon);
+    *p++ = turnMode;
+    p += put_u16(p, (uint16_t)dex->pokemon_count);
+    p += put_u16(p, (uint16_t)dex->move_count);
+    fwrite(rec, 1, sizeof(rec), log->file);
+    log->inBattle = 1;
+}
+
+void battle_log_attack(BattleLog *log, int byHost, uint16_t move, uint32_t attackSeq, int damage) {
+    uint8_t rec[10], *p = rec;
+    *p++ = byHost ? 'H' : 'J';
+    p += put_u16(p, move);
+    p += put_varint(p, attackSeq);
+    p += put_u16(p, (uint16_t)damage);
+    fwrite(rec, 1, (size_t)(p - rec), log->file);
+}
+
+void battle_log_end(BattleLog *log, int hostHP, int joinerHP, uint64_t stateHash) {
+    uint8_t rec[END_SIZE], *p = rec;
+    *p++ = 'E';
+    p += put_u16(p, (uint16_t)hostHP);
+    p += put_u16(p, (uint16_t)joinerHP);
+    p += put_u64(p, stateHash);
+    fwrite(rec, 1, sizeof(rec), log->file);
+    fflush(log->file); // a finished battle is on disk even if we crash later
+    log->inBattle = 0;
+}
+
+/* ------------------------------------------
+    Replay
+------------------------------------------- */
+int battle_replay_next(const Pokedex *dex, const uint8_t *data, size_t size, size_t *pos,
+                       BattleReplay *out, BattleReplayTurnFn on_turn, void *user) {
+    size_t p = *pos;
+    if (p >= size) return 0;
+    if (data[p] != 'S' || size - p < SETUP_SIZE || data[p + 1] != BATTLE_LOG_VERSION) return -1;
+
+    memset(out, 0, sizeof(*out));
+    out->seed = get_u64(data + p + 2);
+    out->hostPokemon = get_u16(data + p + 10);
+    out->joinerPokemon = get_u16(data + p + 12);
+    out->turnMode = data[p + 14];
+    if (get_u16(data + p + 15) != dex->pokemon_count || get_u16(data + p + 17) != dex->move_count ||
+        out->hostPokemon >= dex->pokemon_count || out->joinerPokemon >= dex->pokemon_count)
+        return -1;
+    p += SETUP_SIZE;
+
+    // Replayed from the host's side; the state hash is the same from either.
+    // One context per battle keeps its damage cache warm across turns.
+    BattleContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.dex = dex;
+    ctx.isHost = true;
+    ctx.myPokemon = &dex->pokemon[out->hostPokemon];
+    ctx.oppPokemon = &dex->pokemon[out->joinerPokemon];
+    ctx.myHP = (int16_t)ctx.myPokemon->hp;
+    ctx.oppHP = (int16_t)ctx.oppPokemon->hp;
+    ctx.seed = out->seed;
+    ctx.stateHash = splitmix64(out->seed);
+
+    while (p < size && data[p] != 'S') {
+        uint8_t tag = data[p++];
+        if (tag == 'H' || tag == 'J') {
+            if (size - p < 2) return -1;
+            uint16_t move = get_u16(data + p);
+            p += 2;
+            uint32_t seq = 0;
+            for (int shift = 0;; shift += 7) {
+                if (p >= size || shift > 28) return -1;
+                uint8_t b = data[p++];
+                seq |= (uint32_t)(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            if (size - p < 2) return -1;
+            int logged = get_u16(data + p);
+            p += 2;
+
+            ctx.turn++;
+            ctx.attackSeq = (int)seq;
+            ctx.lastMoveUsed = move;
+            int dmg = battle_apply_attack(&ctx, tag == 'H', move);
+            if (dmg != logged) out->damageMismatches++;
+            if (on_turn) {
+                out->turns = ctx.turn;
+                out->hostHP = ctx.myHP;
+                out->joinerHP = ctx.oppHP;
+                out->stateHash = ctx.stateHash;
+                on_turn(user, out, tag == 'H', move, logged, dmg);
+            }
+        } else if (tag == 'E') {
+            if (size - p < END_SIZE - 1) return -1;
+            out->ended = 1;
+            out->endMatches = get_u16(data + p) == (uint16_t)ctx.myHP &&
+                              get_u16(data + p + 2) == (uint16_t)ctx.oppHP &&
+                              get_u64(data + p + 4) == ctx.stateHash;
+            p += END_SIZE - 1;
+            break;
+        } else {
+            return -1;
+        }
+    }
+    out->turns = ctx.turn;
+    out->hostHP = ctx.myHP;
+    out->joinerHP = ctx.oppHP;
+    out->stateHash = ctx.stateHash;
+    *pos = p;
+    return 1;
+}
@@ -0,0 +1,62 @@
+#ifndef BATTLE_LOG_H
+#define BATTLE_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pokemon_data.h"
+
+// --- Append-only binary battle log ---
+// A file holds any number of battles back to back. Each one is a SETUP
+// record, one ATTACK record per settled attack (about 6 bytes) and an END
+// record once the battle is decided. Integers are little-endian; the attack
+// sequence number is a LEB128 varint. Attacks hold only what the roll needs,
+// so the damage is recomputed on replay and checked against the logged value.
+//
+//   SETUP  'S' version:u8 seed:u64 host:u16 joiner:u16 turn_mode:u8
+//              pokemon_count:u16 move_count:u16
+//   ATTACK 'H' (host attacks) or 'J' (joiner attacks)
+//              move:u16 attack_seq:varint damage:u16
+//   END    'E' host_hp:u16 joiner_hp:u16 state_hash:u64
+#define BATTLE_LOG_VERSION 1
+
+typedef struct BattleLog {
+    FILE *file;
+    int inBattle; // a SETUP was written and no END yet
+} BattleLog;
+
+// Open `path` for appending; NULL if it cannot be opened
+BattleLog* battle_log_open(const char *path);
+void battle_log_close(BattleLog *log);
+
+// Writers, used by the BattleManager. Pokemon are dex->pokemon indexes.
+void battle_log_setup(BattleLog *log, const Pokedex *dex, uint64_t seed,
+                      uint16_t hostPokemon, uint16_t joinerPokemon, uint8_t turnMode);
+void battle_log_attack(BattleLog *log, int byHost, uint16_t move, uint32_t attackSeq, int damage);
+void battle_log_end(BattleLog *log, int hostHP, int joinerHP, uint64_t stateHash);
+
+// --- Replay ---
+typedef struct {
+    uint64_t seed;
+    uint16_t hostPokemon;
+    uint16_t joinerPokemon;
+    uint8_t turnMode;
+    uint32_t turns;
+    int hostHP;              // after the last replayed attack
+    int joinerHP;
+    uint64_t stateHash;      // recomputed, comparable with BattleContext.stateHash
+    uint32_t damageMismatches; // attacks whose recomputed damage differs from the log
+    int ended;               // an END record closed the battle
+    int endMatches;          // END's HP values and hash equal the recomputed ones
+} BattleReplay;
+
+// Called after each replayed attack (NULL to skip), e.g. for spectator playback
+typedef void (*BattleReplayTurnFn)(void *user, const BattleReplay *battle, int byHost,
+                                   uint16_t move, int loggedDamage, int damage);
+
+// Replay the battle that starts at data[*pos] and advance *pos past it.
+// Returns 1 for a battle, 0 at the end of the data, -1 if the data is
+// malformed or was logged with a different Pokedex.
+int battle_replay_next(const Pokedex *dex, const uint8_t *data, size_t size, size_t *pos,
+                       BattleReplay *out, BattleReplayTurnFn on_turn, void *user);
+
+#endif
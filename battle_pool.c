@@ -0,0 +1,354 @@
+#include <stdlib.h>
+#include <string.h>
+#include "battle_pool.h"
+#include "battle_rng.h"
+#include "thread_compat.h"
+
+#define CACHE_LINE 64
+
+// Fixed pool of session objects with a free stack: taking and returning a
+// slot is O(1) and never touches the heap after the worker starts.
+typedef struct {
+    BattleSession *items;
+    int *freeList;
+    int freeCount;
+    int capacity;
+} SessionSlab;
+
+// One queued event. seq is the slot's turn counter (bounded MPMC queue after
+// D. Vyukov, with a single consumer): producers claim a position with a CAS
+// on the tail, fill the slot and publish it by storing position + 1.
+typedef struct {
+    bm_atomic_int seq;
+    uint8_t event;
+    uint64_t session;
+    union {
+        BattleSessionSetup setup;
+        char text[BATTLE_POOL_TEXT_MAX];
+    } u;
+} PoolSlot;
+
+typedef struct {
+    // --- Inbox: written by producers, read by the worker ---
+    PoolSlot *slots;
+    unsigned long mask;
+    char pad0[CACHE_LINE];
+    bm_atomic_int tail;
+    char pad1[CACHE_LINE];
+    unsigned long head; // worker only
+
+    // --- Sessions: worker only, allocated by the worker itself ---
+    SessionSlab slab;
+    uint64_t *mapKeys;   // open addressing, linear probing
+    int *mapIndex;       // slab index, -1 = empty
+    unsigned long mapMask;
+
+    // --- Statistics: written by the worker, read by anyone ---
+    bm_atomic64 processed;
+    bm_atomic_int live;
+    bm_atomic_int highWater;
+    bm_atomic_int rejected;
+    bm_atomic_int arenaPeak;
+    bm_thread_t thread;
+    int id;
+    struct BattlePool *pool;
+    char pad2[CACHE_LINE];
+} PoolWorker;
+
+struct BattlePool {
+    PoolWorker *workers;
+    int workerCount;
+    int cpuCount;
+    BattlePoolConfig config;
+    bm_atomic_int started; // workers done allocating (or failed)
+    bm_atomic_int failed;
+    bm_atomic_int stop;
+};
+
+static unsigned long round_pow2(unsigned long n) {
+    unsigned long p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+int battle_pool_workers(const BattlePool *pool) {
+    return pool->workerCount;
+}
+
+// High bits pick the worker, low bits the map bucket, so a worker's sessions
+// still spread over its whole map
+int battle_pool_worker_of(const BattlePool *pool, uint64_t session) {
+    return (int)(((splitmix64(session) >> 32) * (uint64_t)pool->workerCount) >> 32);
+}
+
+/* ------------------------------------------
+    Inbox
+------------------------------------------- */
+static PoolSlot *inbox_claim(PoolWorker *w) {
+    for (;;) {
+        long pos = bm_atomic_load(&w->tail);
+        PoolSlot *slot = &w->slots[(unsigned long)pos & w->mask];
+        long diff = (long)((unsigned long)bm_atomic_load(&slot->seq) - (unsigned long)pos);
+        if (diff == 0) {
+            if (bm_atomic_cas(&w->tail, pos, (long)((unsigned long)pos + 1))) return slot;
+        } else if (diff < 0) {
+            return NULL; // full: the worker has not consumed this slot yet
+        }
+        // else another producer took the position; reload the tail
+    }
+}
+
+static void inbox_publish(PoolSlot *slot) {
+    // The slot was claimed at seq == pos; pos + 1 marks it readable
+    bm_atomic_store(&slot->seq, (long)((unsigned long)bm_atomic_load(&slot->seq) + 1));
+}
+
+static PoolSlot *inbox_peek(PoolWorker *w) {
+    PoolSlot *slot = &w->slots[w->head & w->mask];
+    long diff = (long)((unsigned long)bm_atomic_load(&slot->seq) - (w->head + 1));
+    return diff == 0 ? slot : NULL;
+}
+
+static void inbox_pop(PoolWorker *w, PoolSlot *slot) {
+    // Free the slot for the producer that will reach it one lap later
+    bm_atomic_store(&slot->seq, (long)(w->head + w->mask + 1));
+    w->head++;
+}
+
+int battle_pool_submit(BattlePool *pool, uint64_t session, BattlePoolEvent event, const char *text) {
+    size_t len = text ? strlen(text) : 0;
+    if (len >= BATTLE_POOL_TEXT_MAX) return 0;
+    PoolSlot *slot = inbox_claim(&pool->workers[battle_pool_worker_of(pool, session)]);
+    if (!slot) return 0;
+    slot->event = (uint8_t)event;
+    slot->session = session;
+    memcpy(slot->u.text, text ? text : "", len + 1);
+    inbox_publish(slot);
+    return 1;
+}
+
+int battle_pool_open(BattlePool *pool, uint64_t session, const BattleSessionSetup *setup) {
+    PoolSlot *slot = inbox_claim(&pool->workers[battle_pool_worker_of(pool, session)]);
+    if (!slot) return 0;
+    slot->event = BATTLE_POOL_OPEN;
+    slot->session = session;
+    slot->u.setup = *setup;
+    inbox_publish(slot);
+    return 1;
+}
+
+uint64_t battle_pool_processed(const BattlePool *pool, int worker) {
+    return bm_atomic_load64(&pool->workers[worker].processed);
+}
+
+void battle_pool_stats(const BattlePool *pool, int worker, BattlePoolStats *out) {
+    PoolWorker *w = &pool->workers[worker];
+    out->capacity = pool->config.sessionsPerWorker;
+    out->live = (int)bm_atomic_load(&w->live);
+    out->highWater = (int)bm_atomic_load(&w->highWater);
+    out->rejected = (uint32_t)bm_atomic_load(&w->rejected);
+    out->arenaPeak = (uint32_t)bm_atomic_load(&w->arenaPeak);
+    out->processed = bm_atomic_load64(&w->processed);
+}
+
+/* ------------------------------------------
+    Session map (worker only)
+------------------------------------------- */
+static unsigned long map_find(const PoolWorker *w, uint64_t session) {
+    unsigned long i = (unsigned long)splitmix64(session) & w->mapMask;
+    while (w->mapIndex[i] >= 0 && w->mapKeys[i] != session) i = (i + 1) & w->mapMask;
+    return i; // the session's bucket, or the empty bucket where it would go
+}
+
+static void map_remove(PoolWorker *w, unsigned long i) {
+    // Backward-shift deletion keeps every probe chain unbroken
+    w->mapIndex[i] = -1;
+    for (unsigned long j = (i + 1) & w->mapMask; w->mapIndex[j] >= 0; j = (j + 1) & w->mapMask) {
+        unsigned long home = (unsigned long)splitmix64(w->mapKeys[j]) & w->mapMask;
+        // Move j into the hole unless its home lies cyclically in (i, j]
+        if (((j - home) & w->mapMask) >= ((j - i) & w->mapMask)) {
+            w->mapKeys[i] = w->mapKeys[j];
+            w->mapIndex[i] = w->mapIndex[j];
+            w->mapIndex[j] = -1;
+            i = j;
+        }
+    }
+}
+
+static BattleSession *open_session(PoolWorker *w, uint64_t session, const BattleSessionSetup *setup) {
+    unsigned long i = map_find(w, session);
+    SessionSlab *slab = &w->slab;
+    BattleSession *s;
+    if (w->mapIndex[i] >= 0) {
+        s = &slab->items[w->mapIndex[i]];
+        battle_session_end(s); // reopened: start the session over
+    } else {
+        if (slab->freeCount == 0) {
+            bm_atomic_inc(&w->rejected);
+            return NULL;
+        }
+        int index = slab->freeList[--slab->freeCount];
+        w->mapKeys[i] = session;
+        w->mapIndex[i] = index;
+        s = &slab->items[index];
+
+        long live = slab->capacity - slab->freeCount;
+        bm_atomic_store(&w->live, live);
+        if (live > bm_atomic_load(&w->highWater)) bm_atomic_store(&w->highWater, live);
+    }
+    battle_session_start(s, setup);
+    return s;
+}
+
+// O(1): the battle, its arena and the slot all go back at once
+static void close_session(PoolWorker *w, unsigned long bucket) {
+    SessionSlab *slab = &w->slab;
+    int index = w->mapIndex[bucket];
+    BattleSession *s = &slab->items[index];
+    if (s->arena.peak > (uint32_t)bm_atomic_load(&w->arenaPeak)) bm_atomic_store(&w->arenaPeak, (long)s->arena.peak);
+    battle_session_end(s);
+    map_remove(w, bucket);
+    slab->freeList[slab->freeCount++] = index;
+    bm_atomic_store(&w->live, slab->capacity - slab->freeCount);
+}
+
+static void process(PoolWorker *w, PoolSlot *slot) {
+    const BattlePoolConfig *config = &w->pool->config;
+    BattleSession *s = NULL;
+    int done = 0;
+
+    if (slot->event == BATTLE_POOL_OPEN) {
+        s = open_session(w, slot->session, &slot->u.setup);
+    } else {
+        unsigned long i = map_find(w, slot->session);
+        if (w->mapIndex[i] >= 0) {
+            s = &w->slab.items[w->mapIndex[i]];
+            if (slot->event == BATTLE_POOL_MESSAGE) {
+                done = battle_session_resume(s, BATTLE_SESSION_MESSAGE, slot->u.text) == BM_CO_DONE;
+            } else if (slot->event == BATTLE_POOL_INPUT) {
+                done = battle_session_resume(s, BATTLE_SESSION_INPUT, slot->u.text) == BM_CO_DONE;
+            } else {
+                close_session(w, i);
+                s = NULL;
+            }
+        }
+    }
+
+    if (config->handler) config->handler(config->user, w->id, slot->session, s);
+    if (done) {
+        close_session(w, map_find(w, slot->session)); // GAME_OVER: nothing more to wait for
+    } else if (s) {
+        BattleManager_ClearOutgoingMessage(&s->bm);
+    }
+}
+
+/* ------------------------------------------
+    Workers
+------------------------------------------- */
+static int worker_alloc(PoolWorker *w, int sessions) {
+    SessionSlab *slab = &w->slab;
+    w->mapMask = round_pow2((unsigned long)sessions * 2) - 1;
+    slab->items = (BattleSession *)malloc(sizeof(BattleSession) * (size_t)sessions);
+    slab->freeList = (int *)malloc(sizeof(int) * (size_t)sessions);
+    w->mapKeys = (uint64_t *)malloc(sizeof(uint64_t) * (w->mapMask + 1));
+    w->mapIndex = (int *)malloc(sizeof(int) * (w->mapMask + 1));
+    if (!slab->items || !slab->freeList || !w->mapKeys || !w->mapIndex) return 0;
+
+    // First touch from the (pinned) worker places the pages on its node
+    memset(slab->items, 0, sizeof(BattleSession) * (size_t)sessions);
+    memset(w->mapIndex, 0xFF, sizeof(int) * (w->mapMask + 1));
+    for (int i = 0; i < sessions; i++) slab->freeList[i] = sessions - 1 - i;
+    slab->freeCount = slab->capacity = sessions;
+    return 1;
+}
+
+static BM_THREAD_RETURN worker_main(void *arg) {
+    PoolWorker *w = (PoolWorker *)arg;
+    BattlePool *pool = w->pool;
+
+    if (pool->config.pin) bm_thread_pin(w->id % pool->cpuCount);
+    if (!worker_alloc(w, pool->config.sessionsPerWorker)) bm_atomic_inc(&pool->failed);
+    bm_atomic_inc(&pool->started);
+
+    uint64_t processed = 0;
+    int idle = 0;
+    for (;;) {
+        PoolSlot *slot = inbox_peek(w);
+        if (slot) {
+            process(w, slot);
+            inbox_pop(w, slot);
+            bm_atomic_store64(&w->processed, ++processed);
+            idle = 0;
+        } else if (bm_atomic_load(&pool->stop)) {
+            break; // stop is set after the last submit, so the inbox is drained
+        } else if (++idle < 64) {
+            bm_yield();
+        } else {
+            bm_sleep_ms(1); // quiet: stop spinning
+        }
+    }
+    return BM_THREAD_RESULT;
+}
+
+static void worker_free(PoolWorker *w) {
+    if (w->slab.items && w->mapIndex) {
+        for (unsigned long i = 0; i <= w->mapMask; i++)
+            if (w->mapIndex[i] >= 0) battle_session_end(&w->slab.items[w->mapIndex[i]]);
+    }
+    free(w->slab.items);
+    free(w->slab.freeList);
+    free(w->mapKeys);
+    free(w->mapIndex);
+    free(w->slots);
+}
+
+BattlePool* battle_pool_create(const BattlePoolConfig *config) {
+    BattlePool *pool = (BattlePool *)calloc(1, sizeof(BattlePool));
+    if (!pool) return NULL;
+    pool->config = *config;
+    pool->cpuCount = bm_cpu_count();
+    pool->workerCount = config->workers > 0 ? config->workers : pool->cpuCount;
+    if (pool->config.sessionsPerWorker < 1) pool->config.sessionsPerWorker = 1;
+    if (pool->config.queueSize < 2) pool->config.queueSize = 2;
+
+    pool->workers = (PoolWorker *)calloc((size_t)pool->workerCount, sizeof(PoolWorker));
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+
+    unsigned long capacity = round_pow2((unsigned long)pool->config.queueSize);
+    int created = 0;
+    for (int i = 0; i < pool->workerCount; i++) {
+        PoolWorker *w = &pool->workers[i];
+        w->id = i;
+        w->pool = pool;
+        w->mask = capacity - 1;
+        w->slots = (PoolSlot *)malloc(sizeof(PoolSlot) * capacity);
+        if (!w->slots) break;
+        for (unsigned long s = 0; s < capacity; s++) bm_atomic_store(&w->slots[s].seq, (long)s);
+        if (!bm_thread_create(&w->thread, worker_main, w)) break;
+        created++;
+    }
+
+    // Wait until every started worker has its sessions (or gave up)
+    while (bm_atomic_load(&pool->started) < created) bm_yield();
+    if (created < pool->workerCount || bm_atomic_load(&pool->failed)) {
+        bm_atomic_store(&pool->stop, 1);
+        for (int i = 0; i < created; i++) bm_thread_join(pool->workers[i].thread);
+        for (int i = 0; i < pool->workerCount; i++) worker_free(&pool->workers[i]);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void battle_pool_destroy(BattlePool *pool) {
+    if (!pool) return;
+    bm_atomic_store(&pool->stop, 1);
+    for (int i = 0; i < pool->workerCount; i++) bm_thread_join(pool->workers[i].thread);
+    for (int i = 0; i < pool->workerCount; i++) worker_free(&pool->workers[i]);
+    free(pool->workers);
+    free(pool);
+}
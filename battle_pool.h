@@ -0,0 +1,77 @@
+#ifndef BATTLE_POOL_H
+#define BATTLE_POOL_H
+
+#include <stdint.h>
+#include "battle_session.h"
+
+// --- Battle worker pool ---
+// I/O threads parse packets and hand them to worker threads. The worker is
+// picked by a hash of the session ID, so all events of a session reach the
+// same worker in the order they were submitted, and each BattleSession (its
+// BattleManager and coroutine) is only ever touched by that worker (no
+// locks). Workers can
+// be pinned to a CPU each; a worker allocates and clears its own session
+// slots after pinning, so they sit in its CPU's NUMA node.
+
+#define BATTLE_POOL_TEXT_MAX BM_MAX_MSG_SIZE
+
+typedef enum {
+    BATTLE_POOL_OPEN,    // start the session (BattleSessionSetup)
+    BATTLE_POOL_MESSAGE, // received message, resumes the session's flow
+    BATTLE_POOL_INPUT,   // local move, resumes the session's flow
+    BATTLE_POOL_CLOSE    // end the session and free its slot
+} BattlePoolEvent;
+
+// Sessions answer PINGs themselves; the I/O thread keeps a BattleHeartbeat
+// per peer and submits CLOSE when battle_heartbeat_poll reports it dead, so
+// an abandoned battle gives its slot back within a few probe timeouts.
+
+// Runs on the owning worker after every event. The messages to send, if any,
+// are queued in s->bm (BattleManager_OutgoingAt) and cleared afterwards. s is NULL after CLOSE,
+// for events of unknown sessions and when an OPEN found no free slot. A
+// session whose battle reached GAME_OVER is freed right after its handler
+// call; later events for it arrive with s == NULL.
+typedef void (*BattlePoolHandler)(void *user, int worker, uint64_t session, BattleSession *s);
+
+typedef struct {
+    int workers;           // 0 = one per CPU
+    int pin;               // pin worker i to CPU i (modulo the CPU count)
+    int sessionsPerWorker; // session slots of each worker, allocated once up front
+    int queueSize;         // events each worker's inbox holds (rounded up to a power of two)
+    BattlePoolHandler handler;
+    void *user;
+} BattlePoolConfig;
+
+typedef struct BattlePool BattlePool;
+
+// NULL if a worker could not start or allocate its sessions
+BattlePool* battle_pool_create(const BattlePoolConfig *config);
+
+// Call once nothing submits any more (handlers included): processes what is
+// still queued, then stops the workers and releases the open sessions
+void battle_pool_destroy(BattlePool *pool);
+
+int battle_pool_workers(const BattlePool *pool);
+int battle_pool_worker_of(const BattlePool *pool, uint64_t session);
+
+// Queue an event; safe from any thread, including the handler. Returns 0 when
+// the worker's inbox is full (submit again later) or text does not fit.
+int battle_pool_submit(BattlePool *pool, uint64_t session, BattlePoolEvent event, const char *text);
+int battle_pool_open(BattlePool *pool, uint64_t session, const BattleSessionSetup *setup);
+
+// Events processed by one worker so far
+uint64_t battle_pool_processed(const BattlePool *pool, int worker);
+
+typedef struct {
+    int capacity;       // session slots
+    int live;           // sessions open now
+    int highWater;      // most sessions open at once
+    uint32_t rejected;  // OPENs that found no free slot
+    uint32_t arenaPeak; // most arena bytes any closed session used
+    uint64_t processed; // events
+} BattlePoolStats;
+
+// One worker's occupancy; safe to call while the pool runs
+void battle_pool_stats(const BattlePool *pool, int worker, BattlePoolStats *out);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef BATTLE_RNG_H
+#define BATTLE_RNG_H
+
+#include <stdint.h>
+
+// Counter-based random numbers for battles. A draw is a pure function of
+// (session seed, turn, sequence number, stream), so both peers get the same
+// value without exchanging it, and no RNG state is shared between sessions
+// or threads.
+
+// Independent draws within one attack
+enum {
+    BATTLE_RNG_DAMAGE_ROLL = 0
+};
+
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t battle_rng(uint64_t seed, uint32_t turn, uint32_t seq, uint32_t stream) {
+    uint64_t key = splitmix64(seed ^ (((uint64_t)turn << 32) | seq));
+    return splitmix64(key + stream);
+}
+
+// Map a draw onto [lo, hi] (multiply-high, no division)
+static inline int battle_rng_range(uint64_t r, int lo, int hi) {
+    uint64_t span = (uint64_t)(hi - lo + 1);
+    return lo + (int)(((r >> 32) * span) >> 32);
+}
+
+#endif
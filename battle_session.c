@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "battle_session.h"
+#include "battle_heartbeat.h"
+
+// Everything the flow needs across waits
+typedef struct {
+    uint8_t lobby;
+    uint8_t myMode;  // BattleTurnMode this side asked for
+    uint8_t playing;
+    uint64_t seed;
+    char oppPokemon[POKEMON_NAME_MAX];
+} SessionFrame;
+
+static const char *turn_mode_names[TURN_MODE_COUNT] = { "CLASSIC", "FAST", "HOSTED" };
+
+// "message_type: <type>" with exactly this type
+static int message_is(const char *msg, const char *type) {
+    const char *t = msg ? strstr(msg, "message_type: ") : NULL;
+    if (!t) return 0;
+    t += strlen("message_type: ");
+    size_t len = strlen(type);
+    return strncmp(t, type, len) == 0 && (t[len] == '\0' || t[len] == '\n' || t[len] == '\r');
+}
+
+// Value of "key: value" up to the end of the line ("" if missing)
+static void field(const char *msg, const char *key, char *out, size_t size) {
+    const char *v = strstr(msg, key);
+    out[0] = '\0';
+    if (!v) return;
+    v += strlen(key);
+    while (*v == ' ') v++;
+    size_t len = strcspn(v, "\r\n");
+    if (len >= size) len = size - 1;
+    memcpy(out, v, len);
+    out[len] = '\0';
+}
+
+static void send_setup(BattleSession *s, const SessionFrame *f) {
+    BattleManager_Send(&s->bm, BM_TO_PEER,
+             "message_type: BATTLE_SETUP\n"
+             "communication_mode: P2P\n"
+             "pokemon_name: %s\n"
+             "stat_boosts: { \"special_attack_uses\": 5, \"special_defense_uses\": 5 }\n"
+             "turn_mode: %s\n",
+             BattleManager_MyPokemonName(&s->bm), turn_mode_names[f->myMode]);
+}
+
+// Peer's BATTLE_SETUP: opponent and the negotiated turn mode
+static void take_setup(BattleSession *s, SessionFrame *f, const char *msg) {
+    char mode[16];
+    field(msg, "pokemon_name: ", f->oppPokemon, sizeof(f->oppPokemon));
+    field(msg, "turn_mode: ", mode, sizeof(mode));
+    if (!mode[0]) strcpy(mode, "CLASSIC");
+    BattleManager_SetOpponent(&s->bm, f->oppPokemon);
+    BattleManager_SetTurnMode(&s->bm, s->bm.ctx.isHost
+        ? BattleManager_NegotiateTurnMode(turn_mode_names[f->myMode], mode)
+        : BattleManager_NegotiateTurnMode(mode, turn_mode_names[f->myMode]));
+}
+
+/* ------------------------------------------
+    The session flow
+------------------------------------------- */
+static int session_flow(BattleSession *s, int event, const char *text) {
+    SessionFrame *f = (SessionFrame *)s->frame;
+    BattleManager *bm = &s->bm;
+    char buf[32];
+
+    BM_CO_BEGIN(&s->co);
+
+    if (!f->lobby) {
+        BattleManager_SetSeed(bm, f->seed);
+        BattleManager_SetTurnMode(bm, (BattleTurnMode)f->myMode);
+        BattleManager_SetOpponent(bm, f->oppPokemon);
+    } else if (bm->ctx.isHost) {
+        BM_CO_WAIT(&s->co, event == BATTLE_SESSION_MESSAGE && message_is(text, "HANDSHAKE_REQUEST"));
+        BattleManager_SetSeed(bm, f->seed);
+        BattleManager_Send(bm, BM_TO_PEER,
+                 "message_type: HANDSHAKE_RESPONSE\nseed: %llu\n", (unsigned long long)f->seed);
+
+        BM_CO_WAIT(&s->co, event == BATTLE_SESSION_MESSAGE && message_is(text, "BATTLE_SETUP"));
+        take_setup(s, f, text);
+        send_setup(s, f);
+    } else {
+        BattleManager_Send(bm, BM_TO_PEER, "message_type: HANDSHAKE_REQUEST\n");
+
+        BM_CO_WAIT(&s->co, event == BATTLE_SESSION_MESSAGE && message_is(text, "HANDSHAKE_RESPONSE"));
+        field(text, "seed: ", buf, sizeof(buf));
+        f->seed = strtoull(buf, NULL, 10);
+        BattleManager_SetSeed(bm, f->seed);
+        send_setup(s, f);
+
+        BM_CO_WAIT(&s->co, event == BATTLE_SESSION_MESSAGE && message_is(text, "BATTLE_SETUP"));
+        take_setup(s, f, text);
+    }
+
+    // Turns: the transition table validates every message and move
+    f->playing = 1;
+    while (bm->ctx.currentState != STATE_GAME_OVER) {
+        BM_CO_YIELD(&s->co);
+        if (event == BATTLE_SESSION_MESSAGE) BattleManager_HandleMessage(bm, text);
+        else if (event == BATTLE_SESSION_INPUT) BattleManager_HandleUserInput(bm, text);
+    }
+
+    BM_CO_END(&s->co);
+}
+
+int battle_session_start(BattleSession *s, const BattleSessionSetup *setup) {
+    BattleManager_Init(&s->bm, setup->isHost, setup->myPokemon);
+    s->co.line = 0;
+    battle_arena_init(&s->arena, s->arenaMem, sizeof(s->arenaMem));
+
+    SessionFrame *f = (SessionFrame *)battle_arena_alloc(&s->arena, sizeof(SessionFrame));
+    if (!f) return 0;
+    memset(f, 0, sizeof(*f));
+    f->lobby = (uint8_t)(setup->lobby != 0);
+    f->myMode = setup->turnMode < TURN_MODE_COUNT ? setup->turnMode : TURN_MODE_CLASSIC;
+    f->seed = setup->seed;
+    snprintf(f->oppPokemon, sizeof(f->oppPokemon), "%s", setup->oppPokemon);
+    s->frame = f;
+    s->frameEnd = battle_arena_mark(&s->arena);
+    s->chatSender = s->chatText = NULL;
+
+    session_flow(s, -1, NULL);
+    return 1;
+}
+
+// Copy "key: value" into the arena; NULL if missing or too long
+static const char *arena_field(BattleArena *a, const char *msg, const char *key) {
+    const char *v = strstr(msg, key);
+    if (!v) return NULL;
+    v += strlen(key);
+    while (*v == ' ') v++;
+    return battle_arena_strndup(a, v, strcspn(v, "\r\n"));
+}
+
+int battle_session_resume(BattleSession *s, BattleSessionEvent event, const char *text) {
+    battle_arena_rewind(&s->arena, s->frameEnd);
+    s->chatSender = s->chatText = NULL;
+
+    // Keepalives are answered here and never reach the flow; the transport
+    // that sent the PING tracks the PONG
+    char pong[64];
+    if (event == BATTLE_SESSION_MESSAGE && battle_heartbeat_answer(text, pong, sizeof(pong))) {
+        BattleManager_Send(&s->bm, BM_TO_PEER, "%s", pong);
+        return bm_co_done(&s->co) ? BM_CO_DONE : BM_CO_WAITING;
+    }
+    if (event == BATTLE_SESSION_MESSAGE && battle_heartbeat_is_pong(text))
+        return bm_co_done(&s->co) ? BM_CO_DONE : BM_CO_WAITING;
+
+    if (event == BATTLE_SESSION_MESSAGE && message_is(text, "CHAT_MESSAGE")) {
+        s->chatSticker = strstr(text, "content_type: STICKER") != NULL;
+        s->chatSender = arena_field(&s->arena, text, "sender_name: ");
+        s->chatText = arena_field(&s->arena, text, s->chatSticker ? "sticker_data: " : "message_text: ");
+        return bm_co_done(&s->co) ? BM_CO_DONE : BM_CO_WAITING;
+    }
+    return session_flow(s, (int)event, text);
+}
+
+int battle_session_playing(const BattleSession *s) {
+    return s->frame && ((const SessionFrame *)s->frame)->playing;
+}
+
+void battle_session_end(BattleSession *s) {
+    BattleManager_Release(&s->bm);
+    battle_arena_reset(&s->arena);
+    s->frame = NULL;
+}
@@ -0,0 +1,66 @@
+#ifndef BATTLE_SESSION_H
+#define BATTLE_SESSION_H
+
+#include <stdint.h>
+#include "BattleManager.h"
+#include "battle_coro.h"
+
+// --- One peer's side of a battle, as a coroutine ---
+// The whole session - the optional lobby handshake, then every turn until
+// GAME_OVER - is one sequential flow (battle_session.c). Turn messages still
+// go through the BattleManager and its transition table; the flow only
+// decides what the session is waiting for. Replies are queued in the
+// BattleManager's outbox (BattleManager_OutgoingAt), possibly several per event.
+//
+// The session's arena holds the coroutine frame and, after it, scratch for
+// the current event (a received chat line); the scratch is dropped when the
+// next event arrives, so a session never allocates from the heap.
+
+#define BATTLE_SESSION_ARENA 1280 // frame + one chat line or sticker
+
+typedef struct {
+    int isHost;
+    int lobby;         // 1: HANDSHAKE + BATTLE_SETUP exchange first; 0: already agreed
+    uint8_t turnMode;  // BattleTurnMode; with lobby, the mode this side asks for
+    uint64_t seed;     // host: the seed to hand out; without lobby: the agreed one
+    char myPokemon[POKEMON_NAME_MAX];
+    char oppPokemon[POKEMON_NAME_MAX]; // without lobby only; learned from BATTLE_SETUP otherwise
+} BattleSessionSetup;
+
+typedef enum {
+    BATTLE_SESSION_MESSAGE, // a received packet
+    BATTLE_SESSION_INPUT    // the local player's move
+} BattleSessionEvent;
+
+typedef struct {
+    BattleManager bm;
+    BattleCoro co;
+    BattleArena arena;
+    void *frame;
+    uint32_t frameEnd;      // arena mark after the frame: scratch starts here
+    // CHAT_MESSAGE of the current event, in the arena (NULL otherwise). Chat
+    // never resumes the flow, so it is accepted in the lobby and between turns.
+    const char *chatSender;
+    const char *chatText;   // message_text, or sticker_data for a sticker
+    bool chatSticker;
+    uint64_t arenaMem[BATTLE_SESSION_ARENA / sizeof(uint64_t)];
+} BattleSession;
+
+// Initialise the session and run its flow up to the first wait (a joiner
+// with lobby then has HANDSHAKE_REQUEST queued). 0 on failure.
+int battle_session_start(BattleSession *s, const BattleSessionSetup *setup);
+
+// Feed one event; returns BM_CO_DONE once the battle is over. Events the flow
+// is not waiting for (input during the lobby, a stray BATTLE_SETUP) are dropped.
+// A PING is answered with a PONG (battle_heartbeat.h) and a PONG is ignored;
+// neither resumes the flow.
+// Any scratch of the previous event (chatSender / chatText) is released first.
+int battle_session_resume(BattleSession *s, BattleSessionEvent event, const char *text);
+
+// 1 once the lobby is done and turns are being played
+int battle_session_playing(const BattleSession *s);
+
+// O(1): releases the battle and the whole arena
+void battle_session_end(BattleSession *s);
+
+#endif
@@ -0,0 +1,321 @@
+#include "csv_reader.h"
+#include "thread_compat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- File mapping ---
+
+int csv_map_file(const char *path, CsvMap *map) {
+    memset(map, 0, sizeof(*map));
+#ifdef _WIN32
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (map->file == INVALID_HANDLE_VALUE) {
+        map->file = NULL;
+        return 0;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(map->file, &size) || size.QuadPart == 0) {
+        CloseHandle(map->file);
+        map->file = NULL;
+        return 0;
+    }
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!map->mapping) {
+        CloseHandle(map->file);
+        map->file = NULL;
+        return 0;
+    }
+    map->data = (const char *)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!map->data) {
+        CloseHandle(map->mapping);
+        CloseHandle(map->file);
+        memset(map, 0, sizeof(*map));
+        return 0;
+    }
+    map->size = (size_t)size.QuadPart;
+#else
+    map->fd = open(path, O_RDONLY);
+    if (map->fd < 0) return 0;
+    struct stat st;
+    if (fstat(map->fd, &st) != 0 || st.st_size == 0) {
+        close(map->fd);
+        map->fd = -1;
+        return 0;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+    if (p == MAP_FAILED) {
+        close(map->fd);
+        map->fd = -1;
+        return 0;
+    }
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    map->data = (const char *)p;
+    map->size = (size_t)st.st_size;
+#endif
+    return 1;
+}
+
+void csv_unmap_file(CsvMap *map) {
+    if (!map->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+#else
+    munmap((void *)map->data, map->size);
+    close(map->fd);
+#endif
+    memset(map, 0, sizeof(*map));
+}
+
+// --- Record / field parsing ---
+
+int csv_parse_record(const char **pos, const char *end, CsvField *fields, int max_fields) {
+    const char *p = *pos;
+    if (p >= end) return -1;
+
+    int count = 0;
+    for (;;) {
+        CsvField f;
+        f.ptr = p;
+        f.quoted = 0;
+
+        if (p < end && *p == '"') {
+            f.quoted = 1;
+            f.ptr = ++p;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') { p += 2; continue; } // escaped quote
+                    break;
+                }
+                p++;
+            }
+            f.len = (size_t)(p - f.ptr);
+            if (p < end) p++; // closing quote
+            // Tolerate stray characters between the closing quote and the delimiter
+            while (p < end && *p != ',' && *p != '\n' && *p != '\r') p++;
+        } else {
+            while (p < end && *p != ',' && *p != '\n' && *p != '\r') p++;
+            f.len = (size_t)(p - f.ptr);
+        }
+
+        if (count < max_fields) fields[count] = f;
+        count++;
+
+        if (p < end && *p == ',') {
+            p++;
+            continue;
+        }
+        break;
+    }
+
+    if (p < end && *p == '\r') p++;
+    if (p < end && *p == '\n') p++;
+    *pos = p;
+    return count;
+}
+
+size_t csv_field_copy(const CsvField *f, char *dst, size_t dst_size) {
+    if (dst_size == 0) return 0;
+
+    const char *s = f->ptr;
+    const char *e = f->ptr + f->len;
+    while (s < e && isspace((unsigned char)*s)) s++;
+    while (e > s && isspace((unsigned char)e[-1])) e--;
+
+    size_t n = 0;
+    while (s < e && n < dst_size - 1) {
+        if (f->quoted && *s == '"' && s + 1 < e && s[1] == '"') s++; // "" -> "
+        dst[n++] = *s++;
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+int csv_field_int(const CsvField *f) {
+    const char *s = f->ptr;
+    const char *e = f->ptr + f->len;
+    while (s < e && isspace((unsigned char)*s)) s++;
+
+    int sign = 1;
+    if (s < e && (*s == '-' || *s == '+')) {
+        if (*s == '-') sign = -1;
+        s++;
+    }
+    int value = 0;
+    while (s < e && *s >= '0' && *s <= '9') {
+        value = value * 10 + (*s - '0');
+        s++;
+    }
+    return sign * value;
+}
+
+int csv_field_scaled(const CsvField *f, int scale) {
+    const char *s = f->ptr;
+    const char *e = f->ptr + f->len;
+    while (s < e && isspace((unsigned char)*s)) s++;
+
+    int sign = 1;
+    if (s < e && (*s == '-' || *s == '+')) {
+        if (*s == '-') sign = -1;
+        s++;
+    }
+    long whole = 0;
+    while (s < e && *s >= '0' && *s <= '9') whole = whole * 10 + (*s++ - '0');
+
+    // Fraction as num/den, then round (num * scale) / den
+    long num = 0, den = 1;
+    if (s < e && *s == '.') {
+        s++;
+        while (s < e && *s >= '0' && *s <= '9' && den < 100000000L) {
+            num = num * 10 + (*s++ - '0');
+            den *= 10;
+        }
+    }
+    long value = whole * scale + (num * scale + den / 2) / den;
+    return (int)(sign * value);
+}
+
+int csv_find_column(const CsvField *header, int count, const char *name) {
+    size_t name_len = strlen(name);
+    for (int i = 0; i < count; i++) {
+        const char *h = header[i].ptr;
+        size_t len = header[i].len;
+        while (len > 0 && isspace((unsigned char)h[len - 1])) len--;
+        if (len != name_len) continue;
+
+        size_t k = 0;
+        while (k < len && tolower((unsigned char)h[k]) == tolower((unsigned char)name[k])) k++;
+        if (k == len) return i;
+    }
+    return -1;
+}
+
+// Walks the records with csv_parse_record itself (storing no fields), so the
+// boundaries are exactly the ones the parse will see: quotes only open a
+// field at its start, and CR, LF or CRLF end a record.
+size_t csv_index_records(const char *begin, const char *end, const char **starts, size_t max_records) {
+    size_t n = 0;
+    const char *p = begin;
+    while (p < end) {
+        if (starts && n < max_records) starts[n] = p;
+        n++;
+        csv_parse_record(&p, end, NULL, 0);
+    }
+    return n;
+}
+
+// --- Row iteration ---
+
+typedef struct {
+    const char *const *starts;
+    size_t first;
+    size_t last; // exclusive
+    const char *end;
+    CsvRowFn fn;
+    void *user;
+} CsvRangeJob;
+
+static void parse_range(const CsvRangeJob *job) {
+    CsvField fields[CSV_MAX_FIELDS];
+    const char *pos = job->starts[job->first];
+
+    for (size_t row = job->first; row < job->last; row++) {
+        int n = csv_parse_record(&pos, job->end, fields, CSV_MAX_FIELDS);
+        if (n < 0) break;
+        job->fn(job->user, row, fields, n < CSV_MAX_FIELDS ? n : CSV_MAX_FIELDS);
+    }
+}
+
+static BM_THREAD_RETURN parse_range_thread(void *arg) {
+    parse_range((const CsvRangeJob *)arg);
+    return BM_THREAD_RESULT;
+}
+
+const char *csv_read_header(const char *data, size_t size, CsvField *header, int *header_count) {
+    const char *pos = data;
+    const char *end = data + size;
+
+    // Skip a UTF-8 byte order mark so the first header name still matches
+    if (size >= 3 && (unsigned char)data[0] == 0xEF &&
+        (unsigned char)data[1] == 0xBB && (unsigned char)data[2] == 0xBF) {
+        pos += 3;
+    }
+
+    int n = csv_parse_record(&pos, end, header, CSV_MAX_FIELDS);
+    if (n < 0) return NULL;
+    *header_count = n < CSV_MAX_FIELDS ? n : CSV_MAX_FIELDS;
+    return pos;
+}
+
+long csv_for_each_row(const char *rows_begin, const char *end, CsvRowFn fn, void *user, int num_threads) {
+    const char *pos = rows_begin;
+    int n;
+
+    if (num_threads <= 1) {
+        CsvField fields[CSV_MAX_FIELDS];
+        long row = 0;
+        while ((n = csv_parse_record(&pos, end, fields, CSV_MAX_FIELDS)) >= 0) {
+            fn(user, (size_t)row++, fields, n < CSV_MAX_FIELDS ? n : CSV_MAX_FIELDS);
+        }
+        return row;
+    }
+
+    // Parallel path: one quote-aware scan to find record starts, then split
+    size_t rows = csv_index_records(rows_begin, end, NULL, 0);
+    if (rows == 0) return 0;
+
+    const char **starts = (const char **)malloc(rows * sizeof(*starts));
+    if (!starts) return -1;
+    csv_index_records(rows_begin, end, starts, rows);
+
+    if ((size_t)num_threads > rows) num_threads = (int)rows;
+
+    CsvRangeJob *jobs = (CsvRangeJob *)calloc((size_t)num_threads, sizeof(*jobs));
+    bm_thread_t *threads = (bm_thread_t *)calloc((size_t)num_threads, sizeof(*threads));
+    if (!jobs || !threads) {
+        free(jobs);
+        free(threads);
+        free(starts);
+        return -1;
+    }
+
+    size_t chunk = (rows + (size_t)num_threads - 1) / (size_t)num_threads;
+    for (int t = 0; t < num_threads; t++) {
+        jobs[t].starts = starts;
+        jobs[t].first = (size_t)t * chunk < rows ? (size_t)t * chunk : rows;
+        jobs[t].last = jobs[t].first + chunk < rows ? jobs[t].first + chunk : rows;
+        jobs[t].end = jobs[t].last < rows ? starts[jobs[t].last] : end;
+        jobs[t].fn = fn;
+        jobs[t].user = user;
+    }
+
+    // Range 0 runs on the calling thread; a range whose thread cannot be
+    // spawned is parsed inline instead and marked empty so it is not joined.
+    for (int t = 1; t < num_threads; t++) {
+        if (jobs[t].first >= jobs[t].last) continue;
+        if (!bm_thread_create(&threads[t], parse_range_thread, &jobs[t])) {
+            parse_range(&jobs[t]);
+            jobs[t].last = jobs[t].first;
+        }
+    }
+    if (jobs[0].first < jobs[0].last) parse_range(&jobs[0]);
+    for (int t = 1; t < num_threads; t++) {
+        if (jobs[t].first < jobs[t].last) bm_thread_join(threads[t]);
+    }
+
+    free(threads);
+    free(jobs);
+    free(starts);
+    return (long)rows;
+}
@@ -0,0 +1,73 @@
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define CSV_MAX_FIELDS 64
+
+// --- Memory-mapped file ---
+typedef struct {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} CsvMap;
+
+// --- One field of a record. Points straight into the mapped buffer ---
+typedef struct {
+    const char *ptr;
+    size_t len;
+    int quoted; // field was wrapped in "..." (may still contain "" escapes)
+} CsvField;
+
+// Called once per data row. row_index is the 0-based row within the range
+// handed to csv_for_each_row. The return value is currently ignored.
+typedef int (*CsvRowFn)(void *user, size_t row_index, const CsvField *fields, int count);
+
+// Map a whole file read-only. Returns 1 on success, 0 on failure.
+int csv_map_file(const char *path, CsvMap *map);
+void csv_unmap_file(CsvMap *map);
+
+// Parse one record at *pos (RFC 4180: quoted fields, "" escapes, empty fields,
+// CRLF or LF). Advances *pos past the record. Returns the number of fields,
+// or -1 when *pos is already at end. Fields beyond max_fields are skipped.
+int csv_parse_record(const char **pos, const char *end, CsvField *fields, int max_fields);
+
+// Copy a field into dst, undoing "" escapes and trimming surrounding whitespace.
+// Always NUL-terminates (when dst_size > 0) and returns the copied length.
+size_t csv_field_copy(const CsvField *f, char *dst, size_t dst_size);
+
+// Parse a field as a base-10 integer (leading/trailing blanks allowed, 0 if empty).
+int csv_field_int(const CsvField *f);
+
+// Parse a decimal field ("0.25", "2", "1.5") scaled by `scale` and rounded to
+// the nearest integer, without going through floating point.
+int csv_field_scaled(const CsvField *f, int scale);
+
+// Case-insensitive exact header lookup. Returns the column index or -1.
+int csv_find_column(const CsvField *header, int count, const char *name);
+
+// Record starts exactly as csv_parse_record finds them (quotes only at a field
+// start; CR, LF or CRLF end a record). Returns the number of records found; at
+// most max_records starts are stored (pass NULL to only count).
+size_t csv_index_records(const char *begin, const char *end, const char **starts, size_t max_records);
+
+// Parse the header record (skipping a UTF-8 BOM). header must hold
+// CSV_MAX_FIELDS entries. Returns a pointer to the first data row, or NULL if
+// the buffer is empty.
+const char *csv_read_header(const char *data, size_t size, CsvField *header, int *header_count);
+
+// Call fn for every record in [rows, end). With num_threads > 1 the records
+// are split into contiguous ranges and parsed in parallel, so fn must only
+// touch per-row state. Returns the number of rows, or -1 on allocation failure.
+long csv_for_each_row(const char *rows, const char *end, CsvRowFn fn, void *user, int num_threads);
+
+#endif
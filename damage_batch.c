@@ -0,0 +1,183 @@
+#include "damage_batch.h"
+#include "thread_compat.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DAMAGE_BATCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+// --- Building the view ---
+
+int damage_tables_build(DamageTables *t, const Pokedex *dex) {
+    memset(t, 0, sizeof(*t));
+    size_t np = (size_t)dex->pokemon_count;
+    size_t nm = (size_t)dex->move_count;
+    size_t words = np * (6 + DAMAGE_AGAINST_STRIDE) + nm * 3;
+
+    int32_t *w = (int32_t *)malloc((words + 1) * sizeof(int32_t));
+    if (!w) return 0;
+    t->block = w;
+
+    t->pokemon_count = (int)np;
+    t->attack     = w; w += np;
+    t->defense    = w; w += np;
+    t->sp_attack  = w; w += np;
+    t->sp_defense = w; w += np;
+    t->type1      = w; w += np;
+    t->type2      = w; w += np;
+    t->against    = w; w += np * DAMAGE_AGAINST_STRIDE;
+
+    t->move_count = (int)nm;
+    t->power    = w; w += nm;
+    t->type_id  = w; w += nm;
+    t->physical = w;
+
+    for (size_t i = 0; i < np; i++) {
+        const Pokemon *p = &dex->pokemon[i];
+        t->attack[i] = p->attack;
+        t->defense[i] = p->defense;
+        t->sp_attack[i] = p->sp_attack;
+        t->sp_defense[i] = p->sp_defense;
+        t->type1[i] = p->type1_id;
+        t->type2[i] = p->type2_id;
+        int32_t *row = t->against + i * DAMAGE_AGAINST_STRIDE;
+        for (int k = 0; k < TYPE_COUNT; k++) row[k] = p->against[k];
+        row[TYPE_COUNT] = EFF_SCALE;
+    }
+    for (size_t i = 0; i < nm; i++) {
+        const Move *m = &dex->moves[i];
+        // Status moves are folded into power 0 so the kernel has one rule
+        t->power[i] = m->category == MOVE_STATUS ? 0 : m->power;
+        t->type_id[i] = m->type_id < TYPE_COUNT ? m->type_id : TYPE_COUNT;
+        t->physical[i] = m->category == MOVE_PHYSICAL;
+    }
+    return 1;
+}
+
+void damage_tables_free(DamageTables *t) {
+    free(t->block);
+    memset(t, 0, sizeof(*t));
+}
+
+// --- Scalar path ---
+
+static void damage_range_scalar(const DamageTables *t, const uint16_t *attacker, const uint16_t *defender,
+                                const uint16_t *move, int first, int n, int roll, int32_t *out) {
+    for (int i = first; i < n; i++) {
+        int a = attacker[i], d = defender[i], m = move[i];
+        int32_t type = t->type_id[m];
+        int phys = t->physical[m];
+        int stab = t->type1[a] == type || t->type2[a] == type;
+        out[i] = damage_formula(t->power[m],
+                                phys ? t->attack[a] : t->sp_attack[a],
+                                phys ? t->defense[d] : t->sp_defense[d],
+                                stab, t->against[d * DAMAGE_AGAINST_STRIDE + type], roll);
+    }
+}
+
+void damage_batch_scalar(const DamageTables *t, const uint16_t *attacker, const uint16_t *defender,
+                         const uint16_t *move, int n, int roll, int32_t *out) {
+    damage_range_scalar(t, attacker, defender, move, 0, n, roll, out);
+}
+
+// --- AVX2 path: 8 tuples per iteration ---
+#ifdef DAMAGE_BATCH_AVX2
+
+// Truncating int32 division through double lanes. Operands stay far below
+// 2^26, so the correctly rounded quotient truncates to the exact result.
+__attribute__((target("avx2")))
+static inline __m256i div_trunc_epi32(__m256i a, __m256i b) {
+    __m256d qlo = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)),
+                                _mm256_cvtepi32_pd(_mm256_castsi256_si128(b)));
+    __m256d qhi = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)),
+                                _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1)));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(qlo)),
+                                   _mm256_cvttpd_epi32(qhi), 1);
+}
+
+#define GATHER(base, idx) _mm256_i32gather_epi32((const int *)(base), (idx), 4)
+
+__attribute__((target("avx2")))
+static void damage_batch_avx2(const DamageTables *t, const uint16_t *attacker, const uint16_t *defender,
+                              const uint16_t *move, int n, int roll, int32_t *out) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k22 = _mm256_set1_epi32(22);
+    const __m256i k50 = _mm256_set1_epi32(50);
+    const __m256i k100 = _mm256_set1_epi32(100);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i stride = _mm256_set1_epi32(DAMAGE_AGAINST_STRIDE);
+    const __m256i vroll = _mm256_set1_epi32(roll);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(attacker + i)));
+        __m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(defender + i)));
+        __m256i m = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(move + i)));
+
+        __m256i power = GATHER(t->power, m);
+        __m256i type = GATHER(t->type_id, m);
+        __m256i phys = _mm256_cmpgt_epi32(GATHER(t->physical, m), zero);
+
+        __m256i atk = _mm256_blendv_epi8(GATHER(t->sp_attack, a), GATHER(t->attack, a), phys);
+        __m256i def = _mm256_blendv_epi8(GATHER(t->sp_defense, d), GATHER(t->defense, d), phys);
+        def = _mm256_max_epi32(def, one);
+
+        __m256i eff = GATHER(t->against, _mm256_add_epi32(_mm256_mullo_epi32(d, stride), type));
+        __m256i stab = _mm256_or_si256(_mm256_cmpeq_epi32(GATHER(t->type1, a), type),
+                                       _mm256_cmpeq_epi32(GATHER(t->type2, a), type));
+
+        // Same stages as damage_formula(); all values are non-negative, so
+        // the /2 and /EFF_SCALE steps are plain shifts
+        __m256i dmg = div_trunc_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(k22, power), atk),
+                                      _mm256_mullo_epi32(k50, def));
+        dmg = _mm256_add_epi32(dmg, two);
+        dmg = _mm256_blendv_epi8(dmg, _mm256_srli_epi32(_mm256_mullo_epi32(dmg, three), 1), stab);
+        dmg = _mm256_srli_epi32(_mm256_mullo_epi32(dmg, eff), 2);
+        dmg = div_trunc_epi32(_mm256_mullo_epi32(dmg, vroll), k100);
+        dmg = _mm256_max_epi32(dmg, one);
+
+        __m256i none = _mm256_or_si256(_mm256_cmpeq_epi32(power, zero), _mm256_cmpeq_epi32(eff, zero));
+        dmg = _mm256_andnot_si256(none, dmg);
+        _mm256_storeu_si256((__m256i *)(out + i), dmg);
+    }
+    damage_range_scalar(t, attacker, defender, move, i, n, roll, out);
+}
+
+int damage_batch_has_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}
+
+#else
+
+int damage_batch_has_avx2(void) {
+    return 0;
+}
+
+#endif
+
+#ifdef DAMAGE_BATCH_AVX2
+// Probed once for the process; workers call damage_batch concurrently
+static int use_avx2 = 0;
+static bm_once_t avx2_probe_once = BM_ONCE_INIT;
+
+static void probe_avx2(void) {
+    use_avx2 = damage_batch_has_avx2();
+}
+#endif
+
+void damage_batch(const DamageTables *t, const uint16_t *attacker, const uint16_t *defender,
+                  const uint16_t *move, int n, int roll, int32_t *out) {
+#ifdef DAMAGE_BATCH_AVX2
+    bm_once(&avx2_probe_once, probe_avx2);
+    if (use_avx2) {
+        damage_batch_avx2(t, attacker, defender, move, n, roll, out);
+        return;
+    }
+#endif
+    damage_range_scalar(t, attacker, defender, move, 0, n, roll, out);
+}
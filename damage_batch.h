@@ -0,0 +1,77 @@
+#ifndef DAMAGE_BATCH_H
+#define DAMAGE_BATCH_H
+
+#include <stdint.h>
+#include "pokemon_data.h"
+
+// --- The damage formula on plain integers ---
+// Shared by calculate_damage(), the damage caches and the batch paths so
+// they cannot drift. Every stage truncates, in this order; intermediates fit
+// in 32 bits.
+
+// No damage at all (status move / immune), as opposed to the 1 HP minimum
+#define DAMAGE_BASE_NONE (-1)
+
+// Everything but the random roll: the same for every turn of a matchup
+static inline int32_t damage_base(int32_t power, int32_t atk, int32_t def, int stab, int32_t eff) {
+    if (power <= 0 || eff == 0) return DAMAGE_BASE_NONE;
+    if (def <= 0) def = 1;
+
+    int32_t dmg = 22 * power * atk / (50 * def) + 2; // level 50 base damage
+    if (stab) dmg = dmg * 3 / 2;                     // same-type bonus x1.5
+    return dmg * eff / EFF_SCALE;                    // effectiveness in quarters
+}
+
+// The roll (85..100 percent) comes last, then the minimum damage rule
+static inline int32_t damage_apply_roll(int32_t base, int32_t roll) {
+    if (base == DAMAGE_BASE_NONE) return 0;
+    int32_t dmg = base * roll / 100;
+    return dmg < 1 ? 1 : dmg;
+}
+
+static inline int32_t damage_formula(int32_t power, int32_t atk, int32_t def,
+                                     int stab, int32_t eff, int32_t roll) {
+    return damage_apply_roll(damage_base(power, atk, def, stab, eff), roll);
+}
+
+// Each against row has one extra neutral (EFF_SCALE) column at TYPE_COUNT
+// for moves without a type, so lookups never branch
+#define DAMAGE_AGAINST_STRIDE (TYPE_COUNT + 1)
+
+// --- Struct-of-arrays view of a Pokedex for batch evaluation ---
+// Fields are widened to int32 so SIMD lanes can gather them directly.
+typedef struct {
+    int pokemon_count;
+    int32_t *attack;
+    int32_t *defense;
+    int32_t *sp_attack;
+    int32_t *sp_defense;
+    int32_t *type1;
+    int32_t *type2;
+    int32_t *against;    // pokemon_count rows of DAMAGE_AGAINST_STRIDE
+
+    int move_count;
+    int32_t *power;      // 0 for status moves
+    int32_t *type_id;    // TypeId, or TYPE_COUNT for moves without a type
+    int32_t *physical;   // 1 = physical, 0 = special
+
+    void *block;         // single allocation behind all arrays
+} DamageTables;
+
+// Build / free the view. Returns 1 on success.
+int damage_tables_build(DamageTables *t, const Pokedex *dex);
+void damage_tables_free(DamageTables *t);
+
+// out[i] = damage of move[i] used by attacker[i] on defender[i] at `roll`
+// percent (85..100). Indexes must be in range. Uses AVX2 when the CPU has it.
+void damage_batch(const DamageTables *t, const uint16_t *attacker, const uint16_t *defender,
+                  const uint16_t *move, int n, int roll, int32_t *out);
+
+// Portable reference path (same results as damage_batch)
+void damage_batch_scalar(const DamageTables *t, const uint16_t *attacker, const uint16_t *defender,
+                         const uint16_t *move, int n, int roll, int32_t *out);
+
+// 1 if damage_batch runs the AVX2 path on this machine
+int damage_batch_has_avx2(void);
+
+#endif
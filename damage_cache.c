@@ -0,0 +1,58 @@
+#include "damage_cache.h"
+#include "damage_batch.h"
+
+// Slot layout: valid bit | attacker:16 | defender:16 | move:8 | base + 1:16
+#define SLOT_VALID (1ull << 63)
+#define SLOT_KEY(a, d, m) (((uint64_t)(a) << 40) | ((uint64_t)(d) << 24) | ((uint64_t)(m) << 16))
+#define SLOT_KEY_MASK 0x7FFFFFFFFFFF0000ull
+
+DamageCache* damage_cache_create(const Pokedex *dex, int bits) {
+    if (!dex || bits < 1 || bits > 28) return NULL;
+    DamageCache *cache = (DamageCache *)malloc(sizeof(DamageCache));
+    if (!cache) return NULL;
+    cache->slots = (bm_atomic64 *)calloc((size_t)1 << bits, sizeof(bm_atomic64));
+    if (!cache->slots) {
+        free(cache);
+        return NULL;
+    }
+    cache->dex = dex;
+    cache->mask = (1u << bits) - 1;
+    return cache;
+}
+
+void damage_cache_free(DamageCache *cache) {
+    if (!cache) return;
+    free((void *)cache->slots);
+    free(cache);
+}
+
+// Key of a matchup, 0 if it cannot be cached
+static uint64_t matchup_key(const DamageCache *cache, const Pokemon *attacker, const Pokemon *defender, uint16_t move) {
+    ptrdiff_t a = attacker - cache->dex->pokemon, d = defender - cache->dex->pokemon;
+    if (a < 0 || a >= cache->dex->pokemon_count || d < 0 || d >= cache->dex->pokemon_count || move >= MOVE_MAX)
+        return 0;
+    return SLOT_VALID | SLOT_KEY(a, d, move);
+}
+
+static uint32_t slot_index(const DamageCache *cache, uint64_t key) {
+    key ^= key >> 29;
+    key *= 0xBF58476D1CE4E5B9ull;
+    return (uint32_t)(key >> 32) & cache->mask;
+}
+
+int damage_cache_get(DamageCache *cache, const Pokemon *attacker, const Pokemon *defender,
+                     uint16_t move, int32_t *base) {
+    uint64_t key = matchup_key(cache, attacker, defender, move);
+    if (!key) return 0;
+    uint64_t slot = bm_atomic_load64(&cache->slots[slot_index(cache, key)]);
+    if ((slot & (SLOT_VALID | SLOT_KEY_MASK)) != key) return 0;
+    *base = (int32_t)(slot & 0xFFFF) - 1;
+    return 1;
+}
+
+void damage_cache_put(DamageCache *cache, const Pokemon *attacker, const Pokemon *defender,
+                      uint16_t move, int32_t base) {
+    uint64_t key = matchup_key(cache, attacker, defender, move);
+    if (!key || base < DAMAGE_BASE_NONE || base > 0xFFFE) return;
+    bm_atomic_store64(&cache->slots[slot_index(cache, key)], key | (uint64_t)(base + 1));
+}
@@ -0,0 +1,31 @@
+#ifndef DAMAGE_CACHE_H
+#define DAMAGE_CACHE_H
+
+#include <stdint.h>
+#include "pokemon_data.h"
+#include "thread_compat.h"
+
+// --- Process-wide cache of pre-roll damage (damage_base) ---
+// Optional second level behind each battle's own per-move cache, for
+// servers and tools that run many battles over the same popular matchups.
+// Direct-mapped and lock-free: every slot is one 64-bit word holding the
+// (attacker, defender, move) key and the value, so readers never see a torn
+// entry and a collision just overwrites the older matchup. A cache belongs
+// to one Pokedex snapshot and is ignored for battles pinned to another.
+typedef struct {
+    const Pokedex *dex;
+    uint32_t mask;
+    bm_atomic64 *slots;
+} DamageCache;
+
+// 2^bits slots (8 bytes each); NULL on failure
+DamageCache* damage_cache_create(const Pokedex *dex, int bits);
+void damage_cache_free(DamageCache *cache);
+
+// 1 and *base set if the matchup is cached
+int damage_cache_get(DamageCache *cache, const Pokemon *attacker, const Pokemon *defender,
+                     uint16_t move, int32_t *base);
+void damage_cache_put(DamageCache *cache, const Pokemon *attacker, const Pokemon *defender,
+                      uint16_t move, int32_t base);
+
+#endif
@@ -0,0 +1,731 @@
+#include "pokemon_data.h"
+#include "csv_reader.h"
+#include "thread_compat.h"
+#include <stddef.h>
+
+// Case-insensitive name hash shared by the index builder and the lookup
+static uint32_t name_hash(uint32_t seed, const char *s) {
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (; *s; s++) {
+        h ^= (uint8_t)tolower((unsigned char)*s);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+#ifndef POKEDEX_EMBEDDED
+
+/* ------------------------------------------
+    String interning (loader only, single-threaded)
+------------------------------------------- */
+static uint32_t intern_string(PokedexTables *t, const char *s, size_t len) {
+    if (len == 0) return 0;
+    if (t->strings_used + len + 1 > t->strings_cap) return 0; // pool full: degrade to ""
+    uint32_t offset = t->strings_used;
+    memcpy(t->strings + offset, s, len);
+    t->strings[offset + len] = '\0';
+    t->strings_used += (uint32_t)len + 1;
+    return offset;
+}
+
+/* ------------------------------------------
+    Parsed row - wide, per-row scratch that worker threads can fill
+    independently before the serial interning pass.
+------------------------------------------- */
+typedef struct {
+    char name[POKEMON_NAME_MAX];
+    Pokemon stats; // everything except the interned name and learnset
+} PokemonRow;
+
+/* ------------------------------------------
+    Column resolution - header names instead of fixed indexes
+------------------------------------------- */
+typedef struct {
+    int attack;
+    int defense;
+    int hp;
+    int name;
+    int sp_attack;
+    int sp_defense;
+    int speed;
+    int type1;
+    int type2;
+    int against[TYPE_COUNT];
+} PokemonColumns;
+
+static int resolve_pokemon_columns(const CsvField *header, int count, PokemonColumns *cols) {
+    cols->attack     = csv_find_column(header, count, "attack");
+    cols->defense    = csv_find_column(header, count, "defense");
+    cols->hp         = csv_find_column(header, count, "hp");
+    cols->name       = csv_find_column(header, count, "name");
+    cols->sp_attack  = csv_find_column(header, count, "sp_attack");
+    cols->sp_defense = csv_find_column(header, count, "sp_defense");
+    cols->speed      = csv_find_column(header, count, "speed");
+    cols->type1      = csv_find_column(header, count, "type1");
+    cols->type2      = csv_find_column(header, count, "type2");
+    for (int t = 0; t < TYPE_COUNT; t++) {
+        cols->against[t] = csv_find_column(header, count, type_against_column((unsigned char)t));
+    }
+
+    // Only the name is mandatory; missing stat columns load as 0
+    return cols->name >= 0;
+}
+
+typedef struct {
+    PokemonColumns cols;
+    PokemonRow *rows;   // one slot per data row, compacted afterwards
+    int max_rows;
+} PokemonParseJob;
+
+static uint16_t field_stat(const CsvField *fields, int count, int col) {
+    if (col < 0 || col >= count) return 0;
+    int v = csv_field_int(&fields[col]);
+    return (uint16_t)(v < 0 ? 0 : v > 0xFFFF ? 0xFFFF : v);
+}
+
+static int parse_pokemon_row(void *user, size_t index, const CsvField *fields, int count) {
+    PokemonParseJob *job = (PokemonParseJob *)user;
+    if (index >= (size_t)job->max_rows) return 0;
+
+    PokemonRow *row = &job->rows[index];
+    memset(row, 0, sizeof(PokemonRow));
+    Pokemon *p = &row->stats;
+    const PokemonColumns *c = &job->cols;
+
+    if (c->name >= count) return 0; // short/blank line; stays unnamed and is dropped
+    csv_field_copy(&fields[c->name], row->name, sizeof(row->name));
+
+    p->attack     = field_stat(fields, count, c->attack);
+    p->defense    = field_stat(fields, count, c->defense);
+    p->hp         = field_stat(fields, count, c->hp);
+    p->sp_attack  = field_stat(fields, count, c->sp_attack);
+    p->sp_defense = field_stat(fields, count, c->sp_defense);
+    p->speed      = field_stat(fields, count, c->speed);
+
+    p->type1_id = TYPE_NONE;
+    p->type2_id = TYPE_NONE;
+    if (c->type1 >= 0 && c->type1 < count) p->type1_id = type_id_from_name(fields[c->type1].ptr, fields[c->type1].len);
+    if (c->type2 >= 0 && c->type2 < count) p->type2_id = type_id_from_name(fields[c->type2].ptr, fields[c->type2].len);
+
+    // Prefer the dataset's precomputed against_* vector (it already folds in
+    // dual typing and abilities such as Levitate); fall back to the chart.
+    for (int t = 0; t < TYPE_COUNT; t++) {
+        int col = c->against[t];
+        if (col >= 0 && col < count && fields[col].len > 0) {
+            int q = csv_field_scaled(&fields[col], EFF_SCALE);
+            p->against[t] = (uint8_t)(q < 0 ? 0 : q > 255 ? 255 : q);
+        } else {
+            p->against[t] = type_effectiveness((unsigned char)t, p->type1_id, p->type2_id);
+        }
+    }
+    return 0;
+}
+
+/* ------------------------------------------
+    Learnsets - pokemon.csv carries no move lists, so a Pokemon may use every
+    move of its own types plus all Normal moves. Requires the move table.
+------------------------------------------- */
+static void build_learnset(const PokedexTables *t, Pokemon *p) {
+    memset(p->learnset, 0, sizeof(p->learnset));
+    for (int i = 0; i < t->move_count; i++) {
+        uint8_t type = t->moves[i].type_id;
+        if (type == TYPE_NORMAL || type == p->type1_id || type == p->type2_id) {
+            p->learnset[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+    }
+}
+
+/* ------------------------------------------
+    parsePokemonCSV - reentrant core
+    Parses an in-memory CSV into the caller's tables (no globals, no strtok).
+    num_threads > 1 splits the rows across worker threads; interning of
+    names happens afterwards on the calling thread. Load moves first so the
+    learnsets can be built.
+    Returns the number of Pokemon stored, or -1 if the header is unusable.
+------------------------------------------- */
+int parsePokemonCSV(const char *data, size_t size, PokedexTables *out, int num_threads) {
+    CsvField header[CSV_MAX_FIELDS];
+    int header_count = 0;
+    const char *end = data + size;
+    const char *rows_begin = csv_read_header(data, size, header, &header_count);
+
+    PokemonParseJob job;
+    if (!rows_begin || !resolve_pokemon_columns(header, header_count, &job.cols)) return -1;
+
+    size_t rows = csv_index_records(rows_begin, end, NULL, 0);
+    if (rows == 0) return 0;
+
+    job.max_rows = (int)rows;
+    job.rows = (PokemonRow *)malloc(rows * sizeof(PokemonRow));
+    if (!job.rows) return -1;
+
+    long parsed = csv_for_each_row(rows_begin, end, parse_pokemon_row, &job, num_threads);
+    if (parsed > job.max_rows) parsed = job.max_rows;
+
+    for (long i = 0; i < parsed && out->pokemon_count < out->pokemon_cap; i++) {
+        PokemonRow *row = &job.rows[i];
+        if (row->name[0] == '\0') continue;
+
+        Pokemon *p = &out->pokemon[out->pokemon_count++];
+        *p = row->stats;
+        p->name = intern_string(out, row->name, strlen(row->name));
+        build_learnset(out, p);
+    }
+
+    free(job.rows);
+    return out->pokemon_count;
+}
+
+/* ------------------------------------------
+    parseMovesCSV - move table (name,type,power,category,accuracy)
+    Move IDs are assigned in file order. Returns the number of moves, -1
+    without a usable header, or -2 if the file has more than move_cap moves
+    (nothing past them would be usable, so the load must not go on).
+------------------------------------------- */
+typedef struct {
+    int name;
+    int type;
+    int power;
+    int category;
+    int accuracy;
+} MoveColumns;
+
+static uint8_t parse_move_category(const CsvField *f) {
+    char buf[16];
+    csv_field_copy(f, buf, sizeof(buf));
+    if (strcasecmp(buf, "Physical") == 0) return MOVE_PHYSICAL;
+    if (strcasecmp(buf, "Special") == 0) return MOVE_SPECIAL;
+    return MOVE_STATUS;
+}
+
+int parseMovesCSV(const char *data, size_t size, PokedexTables *out) {
+    CsvField header[CSV_MAX_FIELDS];
+    CsvField fields[CSV_MAX_FIELDS];
+    int header_count = 0;
+    const char *end = data + size;
+    const char *pos = csv_read_header(data, size, header, &header_count);
+    if (!pos) return -1;
+
+    MoveColumns c;
+    c.name     = csv_find_column(header, header_count, "name");
+    c.type     = csv_find_column(header, header_count, "type");
+    c.power    = csv_find_column(header, header_count, "power");
+    c.category = csv_find_column(header, header_count, "category");
+    c.accuracy = csv_find_column(header, header_count, "accuracy");
+    if (c.name < 0 || c.type < 0 || c.power < 0 || c.category < 0) return -1;
+
+    int n;
+    while ((n = csv_parse_record(&pos, end, fields, CSV_MAX_FIELDS)) >= 0) {
+        if (n > CSV_MAX_FIELDS) n = CSV_MAX_FIELDS;
+        if (c.name >= n || fields[c.name].len == 0) continue;
+        if (out->move_count >= out->move_cap) return -2;
+
+        char name[POKEMON_NAME_MAX];
+        size_t len = csv_field_copy(&fields[c.name], name, sizeof(name));
+
+        Move *m = &out->moves[out->move_count];
+        memset(m, 0, sizeof(*m));
+        m->id = (uint16_t)out->move_count;
+        m->name = intern_string(out, name, len);
+        m->type_id = c.type < n ? type_id_from_name(fields[c.type].ptr, fields[c.type].len) : TYPE_NONE;
+        m->power = field_stat(fields, n, c.power);
+        m->category = c.category < n ? parse_move_category(&fields[c.category]) : MOVE_STATUS;
+        int acc = c.accuracy >= 0 && c.accuracy < n ? csv_field_int(&fields[c.accuracy]) : 0;
+        m->accuracy = (uint8_t)(acc < 0 ? 0 : acc > 100 ? 100 : acc);
+        out->move_count++;
+    }
+    return out->move_count;
+}
+
+/* ------------------------------------------
+    Perfect-hash name index (hash and displace)
+    Names are split into buckets by name_hash(0, name); each bucket then gets
+    the first seed that sends all of its names to free slots. A lookup is two
+    hashes and one compare, with no probing. Duplicate names always share a
+    bucket, so only the first of them is indexed (same as a linear scan).
+------------------------------------------- */
+static uint32_t name_index_buckets(int count) {
+    return count > 0 && count < NAME_SLOT_EMPTY ? (uint32_t)(count + 1) / 2 : 0;
+}
+
+#define NAME_BUCKET_MAX 16
+
+static int build_name_index(const PokedexTables *t, uint16_t *seeds, uint32_t buckets, uint16_t *slots) {
+    uint32_t n = (uint32_t)t->pokemon_count;
+    uint32_t *bucket_of = (uint32_t *)malloc(n * sizeof(uint32_t));
+    uint32_t *first = (uint32_t *)calloc(buckets + 1, sizeof(uint32_t));
+    uint32_t *cursor = (uint32_t *)malloc(buckets * sizeof(uint32_t));
+    uint16_t *members = (uint16_t *)malloc(n * sizeof(uint16_t));
+    int ok = bucket_of && first && cursor && members;
+
+    // Counting sort of Pokemon indexes by bucket
+    uint32_t max_size = 0;
+    for (uint32_t i = 0; ok && i < n; i++) {
+        bucket_of[i] = name_hash(0, t->strings + t->pokemon[i].name) % buckets;
+        first[bucket_of[i] + 1]++;
+    }
+    for (uint32_t b = 0; ok && b < buckets; b++) {
+        if (first[b + 1] > max_size) max_size = first[b + 1];
+        first[b + 1] += first[b];
+        cursor[b] = first[b];
+    }
+    for (uint32_t i = 0; ok && i < n; i++) members[cursor[bucket_of[i]]++] = (uint16_t)i;
+    if (max_size > NAME_BUCKET_MAX) ok = 0;
+
+    for (uint32_t i = 0; ok && i < n; i++) slots[i] = NAME_SLOT_EMPTY;
+    for (uint32_t b = 0; ok && b < buckets; b++) seeds[b] = 0;
+
+    // Largest buckets first, while most slots are still free
+    for (uint32_t size = max_size; ok && size > 0; size--) {
+        for (uint32_t b = 0; ok && b < buckets; b++) {
+            if (first[b + 1] - first[b] != size) continue;
+            uint16_t *m = members + first[b];
+
+            // Drop repeated names
+            uint32_t k = 0;
+            for (uint32_t i = 0; i < size; i++) {
+                uint32_t j = 0;
+                while (j < k && strcasecmp(t->strings + t->pokemon[m[j]].name, t->strings + t->pokemon[m[i]].name) != 0) j++;
+                if (j == k) m[k++] = m[i];
+            }
+
+            uint32_t seed, chosen[NAME_BUCKET_MAX];
+            for (seed = 1; seed < NAME_SLOT_EMPTY; seed++) {
+                uint32_t placed = 0;
+                for (; placed < k; placed++) {
+                    uint32_t slot = name_hash(seed, t->strings + t->pokemon[m[placed]].name) % n;
+                    uint32_t j = 0;
+                    while (j < placed && chosen[j] != slot) j++;
+                    if (j < placed || slots[slot] != NAME_SLOT_EMPTY) break;
+                    chosen[placed] = slot;
+                }
+                if (placed == k) break;
+            }
+            if (seed == NAME_SLOT_EMPTY) {
+                ok = 0;
+                break;
+            }
+            seeds[b] = (uint16_t)seed;
+            for (uint32_t i = 0; i < k; i++) slots[chosen[i]] = m[i];
+        }
+    }
+
+    free(bucket_of);
+    free(first);
+    free(cursor);
+    free(members);
+    return ok;
+}
+
+/* ------------------------------------------
+    Alphabetical name order (case-insensitive) for prefix ranges.
+    Merge sort so the comparison can see the string pool without globals.
+------------------------------------------- */
+static void merge_sort_names(uint16_t *ids, uint16_t *tmp, int n, const char *const *names) {
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = lo + width < n ? lo + width : n;
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            int a = lo, b = mid, k = lo;
+            while (a < mid && b < hi) {
+                tmp[k++] = strcasecmp(names[ids[b]], names[ids[a]]) < 0 ? ids[b++] : ids[a++];
+            }
+            while (a < mid) tmp[k++] = ids[a++];
+            while (b < hi) tmp[k++] = ids[b++];
+        }
+        memcpy(ids, tmp, (size_t)n * sizeof(uint16_t));
+    }
+}
+
+static int build_sorted_names(const PokedexTables *t, uint16_t *pokemon_sorted, uint16_t *moves_sorted) {
+    int n = t->pokemon_count > t->move_count ? t->pokemon_count : t->move_count;
+    const char **names = (const char **)malloc((size_t)(n + 1) * sizeof(*names));
+    uint16_t *tmp = (uint16_t *)malloc((size_t)(n + 1) * sizeof(uint16_t));
+    if (!names || !tmp) {
+        free(names);
+        free(tmp);
+        return 0;
+    }
+
+    for (int i = 0; i < t->pokemon_count; i++) {
+        names[i] = t->strings + t->pokemon[i].name;
+        pokemon_sorted[i] = (uint16_t)i;
+    }
+    merge_sort_names(pokemon_sorted, tmp, t->pokemon_count, names);
+
+    for (int i = 0; i < t->move_count; i++) {
+        names[i] = t->strings + t->moves[i].name;
+        moves_sorted[i] = (uint16_t)i;
+    }
+    merge_sort_names(moves_sorted, tmp, t->move_count, names);
+
+    free(names);
+    free(tmp);
+    return 1;
+}
+
+/* ------------------------------------------
+    Snapshot allocation: the reference count sits in front of the public
+    Pokedex so readers never see (or touch) it.
+------------------------------------------- */
+typedef struct {
+    bm_atomic_int refs;
+    Pokedex dex;
+} PokedexBlock;
+
+#define DEX_BLOCK(d) ((PokedexBlock *)((char *)(d) - offsetof(PokedexBlock, dex)))
+
+// Copy the scratch tables into one block: header, Pokemon, moves, name
+// indexes, then the string pool
+static Pokedex* pack_pokedex(const PokedexTables *t) {
+    uint32_t buckets = name_index_buckets(t->pokemon_count);
+    uint32_t slot_count = buckets ? (uint32_t)t->pokemon_count : 0;
+    size_t pokemon_bytes = (size_t)t->pokemon_count * sizeof(Pokemon);
+    size_t move_bytes = (size_t)t->move_count * sizeof(Move);
+    size_t index_bytes = ((size_t)buckets + slot_count + t->pokemon_count + t->move_count) * sizeof(uint16_t);
+
+    char *block = (char *)malloc(sizeof(PokedexBlock) + pokemon_bytes + move_bytes + index_bytes + t->strings_used);
+    if (!block) return NULL;
+
+    Pokemon *p = (Pokemon *)(block + sizeof(PokedexBlock));
+    Move *m = (Move *)((char *)p + pokemon_bytes);
+    uint16_t *seeds = (uint16_t *)((char *)m + move_bytes);
+    uint16_t *slots = seeds + buckets;
+    uint16_t *pokemon_sorted = slots + slot_count;
+    uint16_t *moves_sorted = pokemon_sorted + t->pokemon_count;
+    char *str = (char *)(moves_sorted + t->move_count);
+
+    memcpy(p, t->pokemon, pokemon_bytes);
+    memcpy(m, t->moves, move_bytes);
+    memcpy(str, t->strings, t->strings_used);
+    if (buckets && !build_name_index(t, seeds, buckets, slots)) {
+        buckets = slot_count = 0; // fall back to a linear scan
+    }
+    if (!build_sorted_names(t, pokemon_sorted, moves_sorted)) {
+        free(block);
+        return NULL;
+    }
+
+    ((PokedexBlock *)block)->refs = 1;
+    Pokedex *dex = &((PokedexBlock *)block)->dex;
+    dex->pokemon = p;
+    dex->pokemon_count = t->pokemon_count;
+    dex->moves = m;
+    dex->move_count = t->move_count;
+    dex->strings = str;
+    dex->strings_size = t->strings_used;
+    dex->name_seeds = buckets ? seeds : NULL;
+    dex->name_slots = buckets ? slots : NULL;
+    dex->name_buckets = buckets;
+    dex->name_slot_count = slot_count;
+    dex->pokemon_sorted = pokemon_sorted;
+    dex->moves_sorted = moves_sorted;
+    return dex;
+}
+
+/* ------------------------------------------
+    pokedex_load - builds one immutable Pokedex in a single allocation
+------------------------------------------- */
+Pokedex* pokedex_load(const char *moves_path, const char *pokemon_path, int num_threads) {
+    CsvMap moves_map, pokemon_map;
+    if (!csv_map_file(moves_path, &moves_map)) {
+        printf("[MOVE LOADER] ERROR: Cannot open %s\n", moves_path);
+        return NULL;
+    }
+    if (!csv_map_file(pokemon_path, &pokemon_map)) {
+        printf("[POKEMON LOADER] ERROR: Cannot open %s\n", pokemon_path);
+        csv_unmap_file(&moves_map);
+        return NULL;
+    }
+    printf("[POKEMON LOADER] Loading data...");
+
+    // Scratch tables sized from the inputs: every name is a substring of a
+    // file, and there is at most one Pokemon/move per record.
+    PokedexTables t;
+    memset(&t, 0, sizeof(t));
+    t.pokemon_cap = (int)csv_index_records(pokemon_map.data, pokemon_map.data + pokemon_map.size, NULL, 0);
+    t.move_cap = MOVE_MAX;
+    t.strings_cap = (uint32_t)(moves_map.size + pokemon_map.size + 1);
+    t.pokemon = (Pokemon *)malloc(((size_t)t.pokemon_cap + 1) * sizeof(Pokemon));
+    t.moves = (Move *)malloc((size_t)t.move_cap * sizeof(Move));
+    t.strings = (char *)malloc(t.strings_cap);
+
+    Pokedex *dex = NULL;
+    if (t.pokemon && t.moves && t.strings) {
+        t.strings[0] = '\0';
+        t.strings_used = 1;
+
+        int moves = parseMovesCSV(moves_map.data, moves_map.size, &t);
+        int pokemon = moves < 0 ? -1 : parsePokemonCSV(pokemon_map.data, pokemon_map.size, &t, num_threads);
+
+        if (moves == -2) {
+            printf("[MOVE LOADER] ERROR: %s has more than %d moves\n", moves_path, MOVE_MAX);
+        } else if (moves < 0) {
+            printf("[MOVE LOADER] ERROR: %s has no usable header\n", moves_path);
+        } else if (pokemon < 0) {
+            printf("[POKEMON LOADER] ERROR: %s has no usable header\n", pokemon_path);
+        } else {
+            dex = pack_pokedex(&t);
+            if (dex) printf(" %d Pokemon, %d moves.\n", dex->pokemon_count, dex->move_count);
+        }
+    }
+
+    free(t.pokemon);
+    free(t.moves);
+    free(t.strings);
+    csv_unmap_file(&pokemon_map);
+    csv_unmap_file(&moves_map);
+    return dex;
+}
+
+void pokedex_free(Pokedex *dex) {
+    if (dex) free(DEX_BLOCK(dex));
+}
+
+/* ------------------------------------------
+    Shared snapshot (RCU-style)
+    current_dex always holds one reference. Readers pin a snapshot with
+    pokedex_acquire(); a reload builds a new one off to the side, swaps the
+    pointer, and drops the old slot reference. The last battle to release a
+    retired snapshot frees it. Lookups never lock.
+
+    An acquire in flight (pointer loaded, reference not yet counted) is
+    counted in acquiring[epoch], and only once it has seen the epoch
+    unchanged after counting. A publish swaps the pointer, then flips the
+    epoch and waits only for the counter of the epoch it closed: acquires
+    that begin after the flip can only see the new snapshot, so a steady
+    stream of battles starting cannot hold the reload back.
+------------------------------------------- */
+static Pokedex *volatile current_dex = NULL;
+static bm_atomic_int acquiring[2] = { 0, 0 }; // acquires in flight, per epoch
+static bm_atomic_int epoch = 0;
+static bm_atomic_int publishing = 0;          // one swap + grace period at a time
+static bm_atomic_int reloading = 0;
+static bm_once_t first_load_once = BM_ONCE_INIT;
+
+static void load_first_dex(void) {
+    current_dex = pokedex_load(POKEDEX_MOVES_FILE, POKEDEX_POKEMON_FILE, 1);
+}
+
+const Pokedex* pokedex_acquire(void) {
+    bm_once(&first_load_once, load_first_dex);
+
+    // Count ourselves in the current epoch; if a publish flipped it before
+    // the count landed, that publish may not have seen us, so go again.
+    bm_atomic_int *inFlight;
+    for (;;) {
+        long e = bm_atomic_load(&epoch) & 1;
+        inFlight = &acquiring[e];
+        bm_atomic_inc(inFlight);
+        if ((bm_atomic_load(&epoch) & 1) == e) break;
+        bm_atomic_dec(inFlight);
+    }
+    Pokedex *dex = (Pokedex *)bm_atomic_load_ptr((void *volatile *)&current_dex);
+    if (dex) bm_atomic_inc(&DEX_BLOCK(dex)->refs);
+    bm_atomic_dec(inFlight);
+    return dex;
+}
+
+void pokedex_release(const Pokedex *dex) {
+    if (dex && bm_atomic_dec(&DEX_BLOCK(dex)->refs) == 0) free(DEX_BLOCK(dex));
+}
+
+int pokedex_reload(void) {
+    bm_once(&first_load_once, load_first_dex);
+
+    Pokedex *fresh = pokedex_load(POKEDEX_MOVES_FILE, POKEDEX_POKEMON_FILE, bm_cpu_count());
+    if (!fresh || fresh->pokemon_count == 0 || fresh->move_count == 0) {
+        printf("[POKEMON LOADER] Reload failed; keeping the current Pokedex.\n");
+        pokedex_free(fresh);
+        return -1;
+    }
+
+    int count = fresh->pokemon_count; // a later reload may retire `fresh`
+    while (!bm_atomic_cas(&publishing, 0, 1)) bm_yield();
+    Pokedex *old = (Pokedex *)bm_atomic_exchange_ptr((void *volatile *)&current_dex, fresh);
+
+    // A reader of the closing epoch may have loaded `old` without having
+    // counted its reference yet; wait out just those before dropping the
+    // slot's ref. Readers counted in the new epoch load `fresh`.
+    long closing = bm_atomic_load(&epoch) & 1;
+    bm_atomic_store(&epoch, closing ^ 1);
+    while (bm_atomic_load(&acquiring[closing]) != 0) bm_yield();
+    bm_atomic_store(&publishing, 0);
+    pokedex_release(old);
+
+    printf("[POKEMON LOADER] New Pokedex published; running battles keep their snapshot.\n");
+    return count;
+}
+
+static BM_THREAD_RETURN reload_thread(void *arg) {
+    (void)arg;
+    pokedex_reload();
+    bm_atomic_store(&reloading, 0);
+    return BM_THREAD_RESULT;
+}
+
+int pokedex_reload_async(void) {
+    if (!bm_atomic_cas(&reloading, 0, 1)) return 0; // one reload at a time
+
+    bm_thread_t t;
+    if (!bm_thread_create(&t, reload_thread, NULL)) {
+        bm_atomic_store(&reloading, 0);
+        return 0;
+    }
+    bm_thread_detach(t);
+    return 1;
+}
+
+#else
+
+/* ------------------------------------------
+    Embedded build: the tables are compiled in (see tools/gen_pokedex.c)
+    and live in read-only data, so there is nothing to load or free.
+------------------------------------------- */
+const Pokedex* pokedex_acquire(void) {
+    return &pokedex_embedded;
+}
+
+void pokedex_release(const Pokedex *dex) {
+    (void)dex;
+}
+
+int pokedex_reload(void) {
+    printf("[POKEMON LOADER] This build has an embedded Pokedex; regenerate it to change the data.\n");
+    return -1;
+}
+
+int pokedex_reload_async(void) {
+    return 0;
+}
+
+#endif
+
+/* ------------------------------------------
+    Lookups
+------------------------------------------- */
+const Pokemon* getPokemonByName(const Pokedex *dex, const char* name) {
+    if (dex->name_buckets) {
+        uint16_t seed = dex->name_seeds[name_hash(0, name) % dex->name_buckets];
+        uint16_t i = dex->name_slots[name_hash(seed, name) % dex->name_slot_count];
+        if (i != NAME_SLOT_EMPTY && strcasecmp(pokemon_name(dex, &dex->pokemon[i]), name) == 0)
+            return &dex->pokemon[i];
+        return NULL;
+    }
+    for (int i = 0; i < dex->pokemon_count; i++) {
+        if (strcasecmp(pokemon_name(dex, &dex->pokemon[i]), name) == 0)
+            return &dex->pokemon[i];
+    }
+    return NULL;
+}
+
+uint16_t findMoveId(const Pokedex *dex, const char *name) {
+    for (int i = 0; i < dex->move_count; i++) {
+        if (strcasecmp(move_name(dex, (uint16_t)i), name) == 0)
+            return (uint16_t)i;
+    }
+    return MOVE_NONE;
+}
+
+uint16_t getMoveByName(const Pokedex *dex, const char *name, const Pokemon *p) {
+    if (!p) return MOVE_NONE;
+    uint16_t id = findMoveId(dex, name);
+    return pokemon_knows_move(p, id) ? id : MOVE_NONE;
+}
+
+/* ------------------------------------------
+    Name search - prefix completion and nearest matches for typos
+------------------------------------------- */
+static const char* entry_name(const Pokedex *dex, DexNameKind kind, uint16_t i) {
+    return kind == DEX_MOVE_NAMES ? move_name(dex, i) : pokemon_name(dex, &dex->pokemon[i]);
+}
+
+static int entry_allowed(DexNameKind kind, const Pokemon *learner, uint16_t i) {
+    return kind != DEX_MOVE_NAMES || !learner || pokemon_knows_move(learner, i);
+}
+
+int pokedex_complete(const Pokedex *dex, DexNameKind kind, const char *prefix,
+                     const Pokemon *learner, const char **out, int max) {
+    const uint16_t *sorted = kind == DEX_MOVE_NAMES ? dex->moves_sorted : dex->pokemon_sorted;
+    int count = kind == DEX_MOVE_NAMES ? dex->move_count : dex->pokemon_count;
+    size_t len = strlen(prefix);
+
+    // Lower bound of the prefix; every match follows contiguously
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcasecmp(entry_name(dex, kind, sorted[mid]), prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    int found = 0;
+    for (int i = lo; i < count; i++) {
+        const char *name = entry_name(dex, kind, sorted[i]);
+        if (strncasecmp(name, prefix, len) != 0) break;
+        if (!entry_allowed(kind, learner, sorted[i])) continue;
+        if (found < max) out[found] = name;
+        found++;
+    }
+    return found;
+}
+
+// Case-insensitive Levenshtein distance, giving up once it exceeds `bound`
+static int bounded_distance(const char *a, const char *b, int bound) {
+    int la = (int)strlen(a), lb = (int)strlen(b);
+    if (la - lb > bound || lb - la > bound || lb >= POKEMON_NAME_MAX) return bound + 1;
+
+    int row[POKEMON_NAME_MAX];
+    for (int j = 0; j <= lb; j++) row[j] = j;
+    for (int i = 1; i <= la; i++) {
+        int diag = row[0], best = i;
+        row[0] = i;
+        for (int j = 1; j <= lb; j++) {
+            int up = row[j];
+            int cost = tolower((unsigned char)a[i - 1]) != tolower((unsigned char)b[j - 1]);
+            int v = diag + cost;
+            if (up + 1 < v) v = up + 1;
+            if (row[j - 1] + 1 < v) v = row[j - 1] + 1;
+            row[j] = v;
+            diag = up;
+            if (v < best) best = v;
+        }
+        if (best > bound) return bound + 1;
+    }
+    return row[lb];
+}
+
+int pokedex_suggest(const Pokedex *dex, DexNameKind kind, const char *name,
+                    const Pokemon *learner, const char **out, int max) {
+    const uint16_t *sorted = kind == DEX_MOVE_NAMES ? dex->moves_sorted : dex->pokemon_sorted;
+    int count = kind == DEX_MOVE_NAMES ? dex->move_count : dex->pokemon_count;
+    int len = (int)strlen(name);
+    int bound = len / 3 > 2 ? len / 3 : 2;
+    int dist[DEX_SUGGEST_MAX];
+    int found = 0;
+
+    if (max > DEX_SUGGEST_MAX) max = DEX_SUGGEST_MAX;
+    if (len == 0 || len >= POKEMON_NAME_MAX || max <= 0) return 0;
+
+    // Alphabetical walk + stable insertion keeps ties in name order
+    for (int i = 0; i < count; i++) {
+        if (!entry_allowed(kind, learner, sorted[i])) continue;
+        const char *candidate = entry_name(dex, kind, sorted[i]);
+        int limit = found == max ? dist[max - 1] - 1 : bound;
+        if (limit < 0) break;
+        int d = bounded_distance(name, candidate, limit);
+        if (d > limit) continue;
+
+        int pos = found < max ? found++ : max - 1;
+        while (pos > 0 && dist[pos - 1] > d) {
+            dist[pos] = dist[pos - 1];
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        dist[pos] = d;
+        out[pos] = candidate;
+    }
+    return found;
+}
@@ -4,239 +4,167 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h> 
+#include <stdint.h>
+#include <ctype.h>
+#include "type_chart.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #define strcasecmp _stricmp
+#define strncasecmp _strnicmp
 #else
+#include <strings.h>
 #endif
 
-// --- MOVE STRUCTURE (Remains required by BattleManager.h) ---
+#define POKEMON_NAME_MAX 64
+#define MOVE_MAX 256
+#define MOVE_BITSET_WORDS (MOVE_MAX / 64)
+#define MOVE_NONE 0xFFFF
+
+// --- MOVE CATEGORY ---
+typedef enum {
+    MOVE_PHYSICAL,
+    MOVE_SPECIAL,
+    MOVE_STATUS
+} MoveCategory;
+
+// --- MOVE STRUCTURE: one immutable entry of the move table (moves.csv) ---
 typedef struct {
-    char name[64];
-    char type[32];
-    int power;
-    char category[16];
+    uint32_t name;     // offset into the string pool
+    uint16_t id;       // index into the move table
+    uint16_t power;    // 0 for status moves
+    uint8_t type_id;   // TypeId, TYPE_NONE if unknown
+    uint8_t category;  // MoveCategory
+    uint8_t accuracy;  // percent, 0 = never misses
 } Move;
 
-// --- POKEMON STRUCTURE ---
+// --- POKEMON STRUCTURE: immutable species record ---
+// Mutable battle state (current HP, last move, ...) lives in BattleContext.
 typedef struct {
-    char name[64];
-    char type1[32];
-    char type2[32];
-    int hp;
-    int attack;
-    int defense;
-    int sp_attack;
-    int sp_defense;
-    int currentHP; 
-    
-    // Moveset array now holds the combined 'Move/Abilities'
-    Move moveset[10]; 
-    int num_moves;
+    uint64_t learnset[MOVE_BITSET_WORDS]; // bit i set = may use move ID i
+    uint32_t name;     // offset into the string pool
+    uint16_t hp;
+    uint16_t attack;
+    uint16_t defense;
+    uint16_t sp_attack;
+    uint16_t sp_defense;
+    uint16_t speed;
+    uint8_t type1_id;  // TypeId interned at load time
+    uint8_t type2_id;  // TYPE_NONE for single-typed Pokemon
+    uint8_t against[TYPE_COUNT]; // damage taken per attacking TypeId, in quarters (EFF_SCALE = 1x)
 } Pokemon;
 
-// --- GLOBAL DATA STORAGE ---
-static Pokemon pokedex[1200];
-static int pokemon_count = 0;
-static Move move_list[512]; // Global list of all Moves/Abilities
-static int total_moves = 0;
+// --- Scratch tables the parsers fill (string pool offset 0 is always "") ---
+typedef struct {
+    Pokemon *pokemon;
+    int pokemon_count;
+    int pokemon_cap;
+    Move *moves;
+    int move_count;
+    int move_cap;
+    char *strings;
+    uint32_t strings_used;
+    uint32_t strings_cap;
+} PokedexTables;
+
+// --- Immutable Pokedex: one allocation, shared read-only by every battle ---
+typedef struct {
+    const Pokemon *pokemon;
+    const Move *moves;
+    const char *strings;   // string pool; offset 0 is ""
+    int pokemon_count;
+    int move_count;
+    uint32_t strings_size;
+    const uint16_t *name_seeds;  // perfect-hash displacement per bucket
+    const uint16_t *name_slots;  // slot -> Pokemon index, NAME_SLOT_EMPTY if unused
+    uint32_t name_buckets;       // 0 = no index, names are scanned linearly
+    uint32_t name_slot_count;
+    const uint16_t *pokemon_sorted; // Pokemon indexes in case-insensitive name order
+    const uint16_t *moves_sorted;   // move IDs in case-insensitive name order
+} Pokedex;
+
+#define NAME_SLOT_EMPTY 0xFFFF
 
 /* ------------------------------------------
-    Utility and Lookups (trim_trailing_whitespace, getPokemonByName, loadMovesCSV)
-    ... (These remain the same) ...
+    Loading
 ------------------------------------------- */
-static void trim_trailing_whitespace(char *str) {
-    size_t len = strlen(str);
-    while (len > 0 && isspace((unsigned char)str[len - 1])) {
-        str[--len] = '\0';
-    }
-}
+// Reentrant parsers filling caller-owned tables. Parse moves first so the
+// Pokemon learnsets can be built. Both return the new count or -1;
+// parseMovesCSV returns -2 when the file has more than move_cap moves.
+int parseMovesCSV(const char *data, size_t size, PokedexTables *out);
+int parsePokemonCSV(const char *data, size_t size, PokedexTables *out, int num_threads);
+
+// Build a standalone Pokedex from the two CSV files (NULL on failure).
+Pokedex* pokedex_load(const char *moves_path, const char *pokemon_path, int num_threads);
+void pokedex_free(Pokedex *dex);
+
+#ifdef POKEDEX_EMBEDDED
+// Generated by tools/gen_pokedex.c; replaces the CSV files at runtime
+extern const Pokedex pokedex_embedded;
+#endif
 
-static Pokemon* getPokemonByName(const char* name) {
-    for (int i = 0; i < pokemon_count; i++) {
-        if (strcasecmp(pokedex[i].name, name) == 0)
-            return &pokedex[i];
-    }
-    return NULL;
-}
+// --- Process-wide snapshot, loaded from these files on first use ---
+#define POKEDEX_MOVES_FILE "moves.csv"
+#define POKEDEX_POKEMON_FILE "pokemon.csv"
 
-// Assumed function: Look up the full Move struct (Type, Power, Category) by name
-static Move* getMoveByName(const char *name,char* pokemon_name) {
-    Pokemon *p = getPokemonByName(pokemon_name);
-    for (int i = 0; i < p->num_moves; i++) {
-        if (strcasecmp(p->moveset[i].name, name) == 0) {
-            return &move_list[i];
-        }
-    }
-    return NULL;
-}
-// Function to check if a character exists in the set of characters to be removed
-static int char_in_set(char c, char *remove_set) {
-    // strchr returns a pointer to the first occurrence of c in remove_set, or NULL if not found.
-    return (strchr(remove_set, c) != NULL);
+// Pin the current snapshot (NULL if it could not be loaded). It stays valid,
+// unchanged, until the matching pokedex_release(), even across reloads.
+const Pokedex* pokedex_acquire(void);
+void pokedex_release(const Pokedex *dex);
+
+// Re-read the CSV files and publish a new snapshot for later acquires.
+// Returns the new Pokemon count, or -1 (current snapshot kept) on failure.
+int pokedex_reload(void);
+
+// pokedex_reload() on a background thread. Returns 0 if a reload is already
+// running or the thread could not be started.
+int pokedex_reload_async(void);
+
+/* ------------------------------------------
+    Utility and Lookups
+------------------------------------------- */
+static inline const char* pokemon_name(const Pokedex *dex, const Pokemon *p) {
+    return p && p->name < dex->strings_size ? dex->strings + p->name : "";
 }
 
-// Function that removes specified characters from a string in place
-static void remove_chars(char *str,char *remove_set) {
-    if (str == NULL || remove_set == NULL) {
-        return;
-    }
-
-    char *read_ptr = str; // Pointer to read from the original string
-    char *write_ptr = str; // Pointer to write to the new (modified) string
-
-    // 1. Iterate through the string using the read_ptr
-    while (*read_ptr != '\0') {
-        
-        // 2. Check if the current character should be kept
-        if (!char_in_set(*read_ptr, remove_set)) {
-            
-            // 3. If the character is a keeper, copy it to the write_ptr location
-            *write_ptr = *read_ptr;
-            write_ptr++; // Advance the write pointer
-        }
-        
-        read_ptr++; // Always advance the read pointer
-    }
-
-    // 4. Null-terminate the new, shorter string
-    *write_ptr = '\0';
+static inline const Move* getMoveById(const Pokedex *dex, uint16_t id) {
+    return id < dex->move_count ? &dex->moves[id] : NULL;
 }
-static int count_quoted_strings(char *str) {
-    if (!str) return 0;
-
-    int count = 0;
-    int in_quote = 0;
-
-    while (*str) {
-        if (*str == '\'') { // found a quote
-            if (!in_quote) {
-                // starting a new quoted string
-                count++;
-                in_quote = 1;
-            } else {
-                // ending the quoted string
-                in_quote = 0;
-            }
-        }
-        str++;
-    }
-
-    return count;
+
+static inline const char* move_name(const Pokedex *dex, uint16_t id) {
+    return id < dex->move_count && dex->moves[id].name < dex->strings_size
+        ? dex->strings + dex->moves[id].name : "";
 }
-/* ------------------------------------------
-    parse_combined_moveset (REVISED)
-    Parses ['Move1', 'Ability2', ...] and stores names in Pokemon.moveset
-------------------------------------------- */
-static void parse_combined_moveset(char *token, Pokemon *p) {
-    if (token == NULL || strlen(token) < 3) return;
-    int num = count_quoted_strings(token);
-    char *end = token + strlen(token) - 1;
-    if (*end == ']') *end = '\0'; // special character for strtok
-    char *chars_to_remove = "[]'\"";
-    remove_chars(token,chars_to_remove);
-    
-    const char delimeters[] = ":\t";
-    // 2. Tokenize by comma
-    char *move_token = strtok(token, delimeters);
-    int i = 0;
-
-    while (move_token != NULL && i < num) { 
-        char *item_name = move_token;
-        
-        if (strlen(item_name) > 0) {
-            // Store the cleaned NAME
-            strncpy(p->moveset[i].name, item_name, sizeof(p->moveset[0].name) - 1);
-            p->moveset[i].name[sizeof(p->moveset[0].name) - 1] = '\0';
-            // printf("Move's name: %s\tPokemon's Name: %s\n", p->moveset[i].name,p->name);
-            i++;
-        }
-
-        move_token = strtok(NULL, delimeters);
-    }
-    p->num_moves = i;
+
+static inline int pokemon_knows_move(const Pokemon *p, uint16_t id) {
+    return id < MOVE_MAX && ((p->learnset[id >> 6] >> (id & 63)) & 1u);
 }
 
+const Pokemon* getPokemonByName(const Pokedex *dex, const char* name);
+uint16_t findMoveId(const Pokedex *dex, const char *name);
+
+// Move ID if `p` may use a move called `name`, MOVE_NONE otherwise
+uint16_t getMoveByName(const Pokedex *dex, const char *name, const Pokemon *p);
 
 /* ------------------------------------------
-    loadPokemonCSV - Integrates moveset parsing
+    Name search (case-insensitive). For move names, a non-NULL learner
+    limits results to the moves that Pokemon may use.
 ------------------------------------------- */
-static int loadPokemonCSV(const char* filename) {
-
-    FILE* f = fopen(filename, "r");
-    if (!f) {
-        printf("[POKEMON LOADER] ERROR: Cannot open %s\n", filename);
-        return 0;
-    }
-    else{
-        printf("[POKEMON LOADER] Loading data...");
-    }
-
-    char line[4096];
-    fgets(line, sizeof(line), f); // Skip header
-    int diagnostic_row_count = 0;
-    while (fgets(line, sizeof(line), f)) {
-        
-        line[strcspn(line, "\r\n")] = 0; 
-        diagnostic_row_count++;
-        char* token;
-        int col = 0;
-
-        Pokemon p;
-        memset(&p, 0, sizeof(Pokemon));
-
-        char temp_line[4096];
-        strncpy(temp_line, line, sizeof(temp_line));
-        temp_line[sizeof(temp_line) - 1] = '\0';
-
-        char* moveset_column_data = NULL; // Pointer to the moveset/abilities array string
-
-        token = strtok(temp_line, ","); 
-        
-        while (token != NULL) {
-            if(col == 0){
-                moveset_column_data = token;
-            }
-            switch (col) {
-                case 19: p.attack = atoi(token);
-                         break;
-                case 25: p.defense = atoi(token); break;
-                case 26: p.hp = atoi(token); break;
-                case 30: 
-                    trim_trailing_whitespace(token); 
-                    strncpy(p.name, token, sizeof(p.name) - 1); 
-                    p.name[sizeof(p.name) - 1] = '\0';
-                    break;
-                case 33: p.sp_attack = atoi(token); break;
-                case 34: p.sp_defense = atoi(token); break;
-                case 36: strncpy(p.type1, token, sizeof(p.type1) - 1); break;
-                case 37: strncpy(p.type2, token, sizeof(p.type2) - 1); break;
-            }
-
-            token = strtok(NULL, ",");
-            col++;
-        }
-
-        if (strlen(p.name) == 0) continue;
-        
-        // --- SECOND PASS: Parse the moveset/ability array after column tokenizing is done ---
-        if (moveset_column_data) {
-            parse_combined_moveset(moveset_column_data, &p);
-        }
-        
-
-        p.currentHP = p.hp; 
-    
-        
-        if (pokemon_count < 1200) {
-             pokedex[pokemon_count++] = p;
-        }
-    }
-
-    fclose(f);
-    return pokemon_count;
-}
-// ----------------- loadMovesCSV implementation needed here --------------------
-#endif
\ No newline at end of file
+typedef enum {
+    DEX_POKEMON_NAMES,
+    DEX_MOVE_NAMES
+} DexNameKind;
+
+#define DEX_SUGGEST_MAX 16
+
+// Names starting with `prefix`, alphabetical. Returns the total number of
+// matches; at most `max` of them are stored in out.
+int pokedex_complete(const Pokedex *dex, DexNameKind kind, const char *prefix,
+                     const Pokemon *learner, const char **out, int max);
+
+// Closest names by edit distance (at most 2, or a third of the input length),
+// nearest first. Returns how many were stored (max is capped at DEX_SUGGEST_MAX).
+int pokedex_suggest(const Pokedex *dex, DexNameKind kind, const char *name,
+                    const Pokemon *learner, const char **out, int max);
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef THREAD_COMPAT_H
+#define THREAD_COMPAT_H
+
+// Minimal thread wrappers so the loaders and tools build with both the
+// Windows toolchain (CreateThread) and POSIX gcc/clang (pthreads, link -lpthread).
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE bm_thread_t;
+typedef DWORD (WINAPI *bm_thread_entry)(void *arg);
+#define BM_THREAD_RETURN DWORD WINAPI
+#define BM_THREAD_RESULT 0
+
+static inline int bm_thread_create(bm_thread_t *t, bm_thread_entry fn, void *arg) {
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t != NULL;
+}
+
+static inline void bm_thread_join(bm_thread_t t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+static inline int bm_cpu_count(void) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+
+// --- Run-once initialization ---
+typedef INIT_ONCE bm_once_t;
+#define BM_ONCE_INIT INIT_ONCE_STATIC_INIT
+
+static inline BOOL CALLBACK bm_once_trampoline(PINIT_ONCE once, PVOID fn, PVOID *ctx) {
+    (void)once; (void)ctx;
+    ((void (*)(void))fn)();
+    return TRUE;
+}
+
+static inline void bm_once(bm_once_t *once, void (*fn)(void)) {
+    InitOnceExecuteOnce(once, bm_once_trampoline, (PVOID)fn, NULL);
+}
+
+static inline void bm_thread_detach(bm_thread_t t) {
+    CloseHandle(t);
+}
+
+static inline void bm_yield(void) {
+    SwitchToThread();
+}
+
+static inline void bm_sleep_ms(int ms) {
+    Sleep((DWORD)ms);
+}
+
+// Monotonic milliseconds, for timeouts and budgets
+static inline uint64_t bm_time_ms(void) {
+    return (uint64_t)GetTickCount64();
+}
+
+// Pin the calling thread to one CPU; 0 if that is not possible
+static inline int bm_thread_pin(int cpu) {
+    if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) return 0;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+}
+
+// --- Atomics (all sequentially consistent) ---
+typedef volatile LONG bm_atomic_int;
+
+static inline long bm_atomic_load(bm_atomic_int *v) { return InterlockedCompareExchange(v, 0, 0); }
+static inline long bm_atomic_inc(bm_atomic_int *v) { return InterlockedIncrement(v); }
+static inline long bm_atomic_dec(bm_atomic_int *v) { return InterlockedDecrement(v); }
+static inline void bm_atomic_store(bm_atomic_int *v, long x) { InterlockedExchange(v, x); }
+static inline int bm_atomic_cas(bm_atomic_int *v, long expected, long desired) {
+    return InterlockedCompareExchange(v, desired, expected) == expected;
+}
+typedef volatile LONG64 bm_atomic64;
+
+static inline uint64_t bm_atomic_load64(bm_atomic64 *v) { return (uint64_t)InterlockedCompareExchange64(v, 0, 0); }
+static inline void bm_atomic_store64(bm_atomic64 *v, uint64_t x) { InterlockedExchange64(v, (LONG64)x); }
+static inline void *bm_atomic_load_ptr(void *volatile *p) {
+    return InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+static inline void *bm_atomic_exchange_ptr(void *volatile *p, void *x) {
+    return InterlockedExchangePointer(p, x);
+}
+
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+typedef pthread_t bm_thread_t;
+typedef void *(*bm_thread_entry)(void *arg);
+#define BM_THREAD_RETURN void *
+#define BM_THREAD_RESULT NULL
+
+static inline int bm_thread_create(bm_thread_t *t, bm_thread_entry fn, void *arg) {
+    return pthread_create(t, NULL, fn, arg) == 0;
+}
+
+static inline void bm_thread_join(bm_thread_t t) {
+    pthread_join(t, NULL);
+}
+
+static inline int bm_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// --- Run-once initialization ---
+typedef pthread_once_t bm_once_t;
+#define BM_ONCE_INIT PTHREAD_ONCE_INIT
+
+static inline void bm_once(bm_once_t *once, void (*fn)(void)) {
+    pthread_once(once, fn);
+}
+
+static inline void bm_thread_detach(bm_thread_t t) {
+    pthread_detach(t);
+}
+
+static inline void bm_yield(void) {
+    sched_yield();
+}
+
+static inline void bm_sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// Monotonic milliseconds, for timeouts and budgets
+static inline uint64_t bm_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+// Pin the calling thread to one CPU; 0 if that is not possible. Uses the raw
+// syscall so callers need not define _GNU_SOURCE before every include.
+static inline int bm_thread_pin(int cpu) {
+#ifdef __linux__
+    unsigned long mask[16] = { 0 }; // up to 1024 CPUs
+    if (cpu < 0 || cpu >= (int)(sizeof(mask) * 8)) return 0;
+    mask[cpu / (8 * sizeof(long))] = 1ul << (cpu % (8 * sizeof(long)));
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#else
+    (void)cpu;
+    return 0;
+#endif
+}
+
+// --- Atomics (all sequentially consistent) ---
+typedef volatile long bm_atomic_int;
+
+static inline long bm_atomic_load(bm_atomic_int *v) { return __atomic_load_n(v, __ATOMIC_SEQ_CST); }
+static inline long bm_atomic_inc(bm_atomic_int *v) { return __atomic_add_fetch(v, 1, __ATOMIC_SEQ_CST); }
+static inline long bm_atomic_dec(bm_atomic_int *v) { return __atomic_sub_fetch(v, 1, __ATOMIC_SEQ_CST); }
+static inline void bm_atomic_store(bm_atomic_int *v, long x) { __atomic_store_n(v, x, __ATOMIC_SEQ_CST); }
+static inline int bm_atomic_cas(bm_atomic_int *v, long expected, long desired) {
+    return __atomic_compare_exchange_n(v, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+typedef volatile uint64_t bm_atomic64;
+
+static inline uint64_t bm_atomic_load64(bm_atomic64 *v) { return __atomic_load_n(v, __ATOMIC_SEQ_CST); }
+static inline void bm_atomic_store64(bm_atomic64 *v, uint64_t x) { __atomic_store_n(v, x, __ATOMIC_SEQ_CST); }
+static inline void *bm_atomic_load_ptr(void *volatile *p) {
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+static inline void *bm_atomic_exchange_ptr(void *volatile *p, void *x) {
+    return __atomic_exchange_n(p, x, __ATOMIC_SEQ_CST);
+}
+#endif
+
+#endif
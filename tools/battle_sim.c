@@ -0,0 +1,465 @@
+// battle_sim - headless Monte Carlo battles for balancing pokemon.csv
+//
+// Build and run from the repository root:
+//   gcc -O2 -I. tools/battle_sim.c BattleManager.c battle_ai.c damage_cache.c battle_log.c pokemon_data.c csv_reader.c type_chart.c -o battle_sim.exe
+//   battle_sim.exe [-n battles] [-t threads] [-s seed] [-o winrates.csv] [-k ko_turns.csv] [moves.csv pokemon.csv]
+//
+// Plays `battles` (default 64) complete battles for every pairing of Pokemon,
+// including mirror matches, through battle_apply_attack() - the same damage
+// code and seeded rolls the networked game uses, minus the sockets. Each side
+// uses a random damaging move from its learnset and the first mover
+// alternates between battles.
+//
+// Output:
+//   winrates.csv  - row Pokemon's win rate against each column Pokemon
+//   ko_turns.csv  - per Pokemon: win rate and the distribution of how many of
+//                   its own attacks it needed to KO the opponent
+//
+// Pairings are split into tiles handed out by a work-stealing scheduler.
+// Every battle draws from its own counter-based stream keyed by (seed,
+// pairing, battle), so results do not depend on the thread count.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BattleManager.h"
+#include "battle_rng.h"
+#include "thread_compat.h"
+
+#define SIM_MAX_TURNS 200   // attacks by both sides before a battle is a draw
+#define SIM_KO_BINS 32      // KO histogram: 1..31 attacks, then 32+
+#define SIM_MAX_UNITS 32767 // a worker's [lo, hi) unit range packs into 2 x 15 bits
+#define SIM_CACHE_LINE 64
+
+// Streams reserved for the simulator (battle streams start at 0)
+enum {
+    SIM_RNG_BATTLE_SEED = 0x100,
+    SIM_RNG_MOVE_CHOICE
+};
+
+typedef struct {
+    const Pokedex *dex;
+    int n;                      // Pokemon count
+    int battles;                // per pairing
+    uint64_t seed;
+    const uint16_t *moves;      // damaging learnset moves, all Pokemon back to back
+    const uint32_t *moves_at;   // n + 1 offsets into moves
+    uint32_t *wins;             // n x n, wins of row against column
+    int tiles_per_row;
+    int tile_size;
+} SimShared;
+
+// Per-thread tallies, merged after the join
+typedef struct {
+    uint64_t battles;
+    uint64_t draws;
+    uint64_t steals;
+    uint64_t length_hist[SIM_MAX_TURNS + 1]; // total attacks per battle
+    uint32_t *ko_hist;                       // n x SIM_KO_BINS
+} SimStats;
+
+typedef struct {
+    bm_atomic_int range; // (lo << 15) | hi over unit indexes, owner pops lo, thieves split off the top
+    char pad[SIM_CACHE_LINE - sizeof(bm_atomic_int)];
+} SimQueue;
+
+typedef struct {
+    const SimShared *shared;
+    SimQueue *queues;
+    int self;
+    int count;
+    SimStats stats;
+} SimWorker;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* ------------------------------------------
+    One battle
+------------------------------------------- */
+static uint16_t pick_move(const SimShared *s, int who, const BattleContext *ctx) {
+    uint32_t first = s->moves_at[who], count = s->moves_at[who + 1] - first;
+    if (count == 0) return MOVE_NONE; // no damaging move: the attack does nothing
+    uint64_t r = battle_rng(ctx->seed, ctx->turn, (uint32_t)ctx->attackSeq, SIM_RNG_MOVE_CHOICE);
+    return s->moves[first + (uint32_t)battle_rng_range(r, 0, (int)count - 1)];
+}
+
+// Plays battle k of the matchup in ctx (a = myPokemon, d = oppPokemon);
+// returns 1 if a won, 0 if d won, -1 for a draw. The context is reused for
+// every battle of a pairing so its per-move damage cache stays warm.
+static int run_battle(const SimShared *s, BattleContext *ctx, int a, int d, uint32_t k, SimStats *st) {
+    ctx->myHP = (int16_t)ctx->myPokemon->hp;
+    ctx->oppHP = (int16_t)ctx->oppPokemon->hp;
+    ctx->lastMoveUsed = MOVE_NONE;
+    ctx->turn = 0;
+    ctx->seed = battle_rng(s->seed, (uint32_t)(a * s->n + d), k, SIM_RNG_BATTLE_SEED);
+
+    int byMe = (k & 1) == 0; // a opens the even battles
+    int hits[2] = { 0, 0 };
+    int result = -1;
+
+    while (ctx->turn < SIM_MAX_TURNS) {
+        ctx->turn++;
+        ctx->attackSeq = (int)ctx->turn;
+        ctx->lastMoveUsed = pick_move(s, byMe ? a : d, ctx);
+        battle_apply_attack(ctx, byMe, ctx->lastMoveUsed);
+        hits[byMe]++;
+
+        if (ctx->oppHP <= 0 || ctx->myHP <= 0) {
+            result = ctx->oppHP <= 0;
+            int winner = result ? a : d;
+            int bin = hits[result] < SIM_KO_BINS ? hits[result] - 1 : SIM_KO_BINS - 1;
+            st->ko_hist[(size_t)winner * SIM_KO_BINS + bin]++;
+            break;
+        }
+        byMe = !byMe;
+    }
+
+    st->battles++;
+    st->length_hist[ctx->turn]++;
+    if (result < 0) st->draws++;
+    return result;
+}
+
+// A unit is one attacker row and a tile of defenders; only pairings with
+// d >= a are played, each filling both wins[a][d] and wins[d][a]
+static void run_unit(const SimShared *s, int unit, SimStats *st) {
+    int a = unit / s->tiles_per_row;
+    int d = (unit % s->tiles_per_row) * s->tile_size;
+    int end = d + s->tile_size < s->n ? d + s->tile_size : s->n;
+    if (d < a) d = a;
+
+    BattleContext ctx;
+    for (; d < end; d++) {
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.dex = s->dex;
+        ctx.myPokemon = &s->dex->pokemon[a];
+        ctx.oppPokemon = &s->dex->pokemon[d];
+
+        uint32_t a_wins = 0, d_wins = 0;
+        for (int k = 0; k < s->battles; k++) {
+            int r = run_battle(s, &ctx, a, d, (uint32_t)k, st);
+            if (r == 1) a_wins++;
+            else if (r == 0) d_wins++;
+        }
+        if (a == d) {
+            s->wins[(size_t)a * s->n + a] = a_wins; // mirror match: the first-listed side
+        } else {
+            s->wins[(size_t)a * s->n + d] = a_wins;
+            s->wins[(size_t)d * s->n + a] = d_wins;
+        }
+    }
+}
+
+/* ------------------------------------------
+    Work-stealing scheduler over unit ranges
+------------------------------------------- */
+#define RANGE_LO(w) ((int)(((unsigned long)(w) >> 15) & SIM_MAX_UNITS))
+#define RANGE_HI(w) ((int)((unsigned long)(w) & SIM_MAX_UNITS))
+#define RANGE(lo, hi) ((long)(((unsigned long)(lo) << 15) | (unsigned long)(hi)))
+
+// Owner side: take the lowest unit of our own range, -1 when it is empty
+static int pop_local(SimQueue *q) {
+    for (;;) {
+        long w = bm_atomic_load(&q->range);
+        int lo = RANGE_LO(w), hi = RANGE_HI(w);
+        if (lo >= hi) return -1;
+        if (bm_atomic_cas(&q->range, w, RANGE(lo + 1, hi))) return lo;
+    }
+}
+
+// Thief side: split off the upper half of some other worker's range, run
+// its first unit ourselves and keep the rest as our new range. Our own range
+// is empty here and nobody steals from an empty range, so a plain store is
+// enough to publish it.
+static int steal(SimWorker *w) {
+    for (int i = 1; i < w->count; i++) {
+        SimQueue *victim = &w->queues[(w->self + i) % w->count];
+        for (;;) {
+            long v = bm_atomic_load(&victim->range);
+            int lo = RANGE_LO(v), hi = RANGE_HI(v);
+            if (lo >= hi) break;
+            int mid = lo + (hi - lo) / 2;
+            if (bm_atomic_cas(&victim->range, v, RANGE(lo, mid))) {
+                bm_atomic_store(&w->queues[w->self].range, RANGE(mid + 1, hi));
+                w->stats.steals++;
+                return mid;
+            }
+        }
+    }
+    return -1;
+}
+
+static BM_THREAD_RETURN sim_worker(void *arg) {
+    SimWorker *w = (SimWorker *)arg;
+    int unit;
+    while ((unit = pop_local(&w->queues[w->self])) >= 0 || (unit = steal(w)) >= 0) {
+        run_unit(w->shared, unit, &w->stats);
+    }
+    return BM_THREAD_RESULT;
+}
+
+/* ------------------------------------------
+    Output
+------------------------------------------- */
+static void write_csv_name(FILE *out, const char *name) {
+    if (strpbrk(name, ",\"")) {
+        fputc('"', out);
+        for (; *name; name++) {
+            if (*name == '"') fputc('"', out);
+            fputc(*name, out);
+        }
+        fputc('"', out);
+    } else {
+        fputs(name, out);
+    }
+}
+
+static int write_win_matrix(const char *path, const SimShared *s) {
+    FILE *out = fopen(path, "w");
+    if (!out) return 0;
+    fputs("pokemon", out);
+    for (int d = 0; d < s->n; d++) {
+        fputc(',', out);
+        write_csv_name(out, pokemon_name(s->dex, &s->dex->pokemon[d]));
+    }
+    fputc('\n', out);
+    for (int a = 0; a < s->n; a++) {
+        write_csv_name(out, pokemon_name(s->dex, &s->dex->pokemon[a]));
+        for (int d = 0; d < s->n; d++) {
+            fprintf(out, ",%.3f", (double)s->wins[(size_t)a * s->n + d] / s->battles);
+        }
+        fputc('\n', out);
+    }
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed;
+}
+
+// Attacks needed at the given quantile of a KO histogram (0 if no KOs)
+static int ko_quantile(const uint32_t *hist, uint32_t total, double q) {
+    uint32_t need = (uint32_t)(q * total + 0.5), seen = 0;
+    if (need == 0) need = 1;
+    for (int b = 0; b < SIM_KO_BINS; b++) {
+        seen += hist[b];
+        if (seen >= need) return b + 1;
+    }
+    return 0;
+}
+
+static int write_ko_table(const char *path, const SimShared *s, const uint32_t *ko_hist, double *win_rate) {
+    FILE *out = fopen(path, "w");
+    if (!out) return 0;
+    fputs("pokemon,battles,wins,win_rate,ko_mean,ko_p50,ko_p90", out);
+    for (int b = 1; b < SIM_KO_BINS; b++) fprintf(out, ",ko_%d", b);
+    fprintf(out, ",ko_%d+\n", SIM_KO_BINS);
+
+    // Every Pokemon meets every opponent once per battle index, plus the
+    // mirror match in which it fights on both sides
+    uint64_t battles = (uint64_t)(s->n + 1) * (uint64_t)s->battles;
+    for (int p = 0; p < s->n; p++) {
+        const uint32_t *hist = ko_hist + (size_t)p * SIM_KO_BINS;
+        uint64_t wins = 0, attacks = 0;
+        for (int b = 0; b < SIM_KO_BINS; b++) {
+            wins += hist[b];
+            attacks += (uint64_t)hist[b] * (uint64_t)(b + 1);
+        }
+        win_rate[p] = (double)wins / (double)battles;
+
+        write_csv_name(out, pokemon_name(s->dex, &s->dex->pokemon[p]));
+        fprintf(out, ",%llu,%llu,%.4f,%.2f,%d,%d", (unsigned long long)battles, (unsigned long long)wins,
+                win_rate[p], wins ? (double)attacks / (double)wins : 0.0,
+                ko_quantile(hist, (uint32_t)wins, 0.5), ko_quantile(hist, (uint32_t)wins, 0.9));
+        for (int b = 0; b < SIM_KO_BINS; b++) fprintf(out, ",%u", hist[b]);
+        fputc('\n', out);
+    }
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed;
+}
+
+static const double *sort_rate;
+static int by_win_rate(const void *x, const void *y) {
+    double a = sort_rate[*(const int *)x], b = sort_rate[*(const int *)y];
+    return a < b ? 1 : a > b ? -1 : *(const int *)x - *(const int *)y;
+}
+
+/* ------------------------------------------
+    Main
+------------------------------------------- */
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-n battles] [-t threads] [-s seed] [-o winrates.csv] [-k ko_turns.csv]"
+                    " [moves.csv pokemon.csv]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    int battles = 64, threads = bm_cpu_count();
+    uint64_t seed = 1;
+    const char *matrix_path = "winrates.csv";
+    const char *ko_path = "ko_turns.csv";
+    const char *moves_path = POKEDEX_MOVES_FILE;
+    const char *pokemon_path = POKEDEX_POKEMON_FILE;
+
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        const char *v = argv[arg + 1];
+        if (strcmp(argv[arg], "-n") == 0) battles = atoi(v);
+        else if (strcmp(argv[arg], "-t") == 0) threads = atoi(v);
+        else if (strcmp(argv[arg], "-s") == 0) seed = strtoull(v, NULL, 0);
+        else if (strcmp(argv[arg], "-o") == 0) matrix_path = v;
+        else if (strcmp(argv[arg], "-k") == 0) ko_path = v;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (arg + 1 < argc) {
+        moves_path = argv[arg];
+        pokemon_path = argv[arg + 1];
+    } else if (arg < argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (battles <= 0 || threads <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Pokedex *dex = pokedex_load(moves_path, pokemon_path, threads);
+    if (!dex || dex->pokemon_count == 0 || dex->move_count == 0) return 2;
+    int n = dex->pokemon_count;
+    if (n > SIM_MAX_UNITS) {
+        fprintf(stderr, "battle_sim: too many Pokemon (%d)\n", n);
+        return 1;
+    }
+
+    // Damaging moves per Pokemon, flattened
+    uint32_t *moves_at = (uint32_t *)malloc(((size_t)n + 1) * sizeof(uint32_t));
+    uint16_t *moves = (uint16_t *)malloc((size_t)n * MOVE_MAX * sizeof(uint16_t));
+    uint32_t *wins = (uint32_t *)calloc((size_t)n * n, sizeof(uint32_t));
+    SimQueue *queues = (SimQueue *)calloc((size_t)threads, sizeof(SimQueue));
+    SimWorker *workers = (SimWorker *)calloc((size_t)threads, sizeof(SimWorker));
+    bm_thread_t *handles = (bm_thread_t *)calloc((size_t)threads, sizeof(bm_thread_t));
+    if (!moves_at || !moves || !wins || !queues || !workers || !handles) {
+        fprintf(stderr, "battle_sim: out of memory\n");
+        return 1;
+    }
+    uint32_t used = 0;
+    for (int p = 0; p < n; p++) {
+        moves_at[p] = used;
+        for (uint16_t id = 0; id < dex->move_count; id++) {
+            const Move *m = &dex->moves[id];
+            if (pokemon_knows_move(&dex->pokemon[p], id) && m->power > 0 && m->category != MOVE_STATUS)
+                moves[used++] = id;
+        }
+    }
+    moves_at[n] = used;
+
+    SimShared shared = { dex, n, battles, seed, moves, moves_at, wins, 0, 0 };
+    shared.tiles_per_row = SIM_MAX_UNITS / n < n ? SIM_MAX_UNITS / n : n;
+    shared.tile_size = (n + shared.tiles_per_row - 1) / shared.tiles_per_row;
+    int units = n * shared.tiles_per_row;
+
+    // Units are dealt out in contiguous, equal ranges; stealing evens out
+    // the rows near the bottom, which hold fewer pairings
+    for (int t = 0; t < threads; t++) {
+        int lo = (int)((long long)units * t / threads), hi = (int)((long long)units * (t + 1) / threads);
+        queues[t].range = RANGE(lo, hi);
+        workers[t].shared = &shared;
+        workers[t].queues = queues;
+        workers[t].self = t;
+        workers[t].count = threads;
+        workers[t].stats.ko_hist = (uint32_t *)calloc((size_t)n * SIM_KO_BINS, sizeof(uint32_t));
+        if (!workers[t].stats.ko_hist) {
+            fprintf(stderr, "battle_sim: out of memory\n");
+            return 1;
+        }
+    }
+
+    printf("[SIM] %d Pokemon, %d battles per pairing, %d thread(s), seed %llu\n",
+           n, battles, threads, (unsigned long long)seed);
+    double start = now_seconds();
+    int started = 1;
+    for (int t = 1; t < threads; t++) {
+        if (!bm_thread_create(&handles[t], sim_worker, &workers[t])) break;
+        started++;
+    }
+    sim_worker(&workers[0]); // units of workers that failed to start get stolen
+    for (int t = 1; t < started; t++) bm_thread_join(handles[t]);
+    double elapsed = now_seconds() - start;
+
+    // Merge per-thread tallies
+    SimStats total;
+    memset(&total, 0, sizeof(total));
+    total.ko_hist = workers[0].stats.ko_hist;
+    for (int t = 0; t < threads; t++) {
+        const SimStats *st = &workers[t].stats;
+        total.battles += st->battles;
+        total.draws += st->draws;
+        total.steals += st->steals;
+        for (int i = 0; i <= SIM_MAX_TURNS; i++) total.length_hist[i] += st->length_hist[i];
+        if (t > 0) {
+            for (size_t i = 0; i < (size_t)n * SIM_KO_BINS; i++) total.ko_hist[i] += st->ko_hist[i];
+        }
+    }
+
+    printf("[SIM] %llu battles in %.2fs (%.0f battles/s, %llu steals), %llu draws\n",
+           (unsigned long long)total.battles, elapsed, total.battles / (elapsed > 0 ? elapsed : 1),
+           (unsigned long long)total.steals, (unsigned long long)total.draws);
+
+    uint64_t seen = 0, attacks = 0;
+    int p50 = 0, p90 = 0;
+    for (int i = 0; i <= SIM_MAX_TURNS; i++) attacks += total.length_hist[i] * (uint64_t)i;
+    for (int i = 0; i <= SIM_MAX_TURNS; i++) {
+        seen += total.length_hist[i];
+        if (!p50 && seen * 2 >= total.battles) p50 = i;
+        if (!p90 && seen * 10 >= total.battles * 9) p90 = i;
+    }
+    printf("[SIM] Battle length: mean %.2f attacks, median %d, p90 %d\n",
+           (double)attacks / (double)total.battles, p50, p90);
+
+    double *win_rate = (double *)malloc((size_t)n * sizeof(double));
+    int *order = (int *)malloc((size_t)n * sizeof(int));
+    if (!win_rate || !order) return 1;
+
+    int ok = 1;
+    if (write_win_matrix(matrix_path, &shared)) printf("[SIM] Wrote %s\n", matrix_path);
+    else ok = 0, fprintf(stderr, "battle_sim: error writing %s\n", matrix_path);
+    if (write_ko_table(ko_path, &shared, total.ko_hist, win_rate)) printf("[SIM] Wrote %s\n", ko_path);
+    else ok = 0, fprintf(stderr, "battle_sim: error writing %s\n", ko_path);
+
+    for (int p = 0; p < n; p++) order[p] = p;
+    sort_rate = win_rate;
+    qsort(order, (size_t)n, sizeof(int), by_win_rate);
+    int show = n < 5 ? n : 5;
+    printf("[SIM] Strongest:");
+    for (int i = 0; i < show; i++)
+        printf("%s %s %.1f%%", i ? "," : "", pokemon_name(dex, &dex->pokemon[order[i]]), 100 * win_rate[order[i]]);
+    printf("\n[SIM] Weakest:");
+    for (int i = 0; i < show; i++) {
+        int p = order[n - 1 - i];
+        printf("%s %s %.1f%%", i ? "," : "", pokemon_name(dex, &dex->pokemon[p]), 100 * win_rate[p]);
+    }
+    printf("\n");
+
+    for (int t = 0; t < threads; t++) free(workers[t].stats.ko_hist);
+    free(win_rate);
+    free(order);
+    free(handles);
+    free(workers);
+    free(queues);
+    free(wins);
+    free(moves);
+    free(moves_at);
+    pokedex_free(dex);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// damage_bench - damages per second for the per-call and batch damage paths
+//
+// Build and run from the repository root:
+//   gcc -O2 -I. tools/damage_bench.c damage_batch.c BattleManager.c battle_ai.c damage_cache.c battle_log.c pokemon_data.c csv_reader.c type_chart.c -o damage_bench.exe
+//   damage_bench.exe [count] [moves.csv pokemon.csv]
+//
+// Draws `count` random attacker/defender/move tuples (default 1M), times
+// calculate_damage() per tuple, damage_batch_scalar() and damage_batch()
+// over the whole set, and checks that all three produce the same numbers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BattleManager.h"
+#include "damage_batch.h"
+#include "thread_compat.h"
+
+#define BENCH_ROLL 93
+#define BENCH_MIN_SECONDS 0.5
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static uint64_t bench_state = 0x243F6A8885A308D3ull;
+static uint32_t bench_rand(uint32_t n) {
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 7;
+    bench_state ^= bench_state << 17;
+    return (uint32_t)((bench_state >> 32) * n >> 32);
+}
+
+typedef struct {
+    const Pokedex *dex;
+    const DamageTables *tables;
+    const uint16_t *attacker, *defender, *move;
+    int n;
+    int32_t *out;
+} BenchSet;
+
+static void run_per_call(const BenchSet *b) {
+    for (int i = 0; i < b->n; i++) {
+        b->out[i] = calculate_damage(&b->dex->pokemon[b->attacker[i]], &b->dex->pokemon[b->defender[i]],
+                                     &b->dex->moves[b->move[i]], BENCH_ROLL);
+    }
+}
+
+static void run_scalar(const BenchSet *b) {
+    damage_batch_scalar(b->tables, b->attacker, b->defender, b->move, b->n, BENCH_ROLL, b->out);
+}
+
+static void run_batch(const BenchSet *b) {
+    damage_batch(b->tables, b->attacker, b->defender, b->move, b->n, BENCH_ROLL, b->out);
+}
+
+// Repeats the pass until BENCH_MIN_SECONDS have elapsed; returns damages/s
+static double measure(const char *label, void (*pass)(const BenchSet *), const BenchSet *b) {
+    pass(b); // warm-up
+    int passes = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        pass(b);
+        passes++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    double rate = (double)b->n * passes / elapsed;
+    printf("%-22s %8.1f M damages/s (%d passes)\n", label, rate / 1e6, passes);
+    return rate;
+}
+
+int main(int argc, char **argv) {
+    int n = 1 << 20;
+    const char *moves_path = POKEDEX_MOVES_FILE;
+    const char *pokemon_path = POKEDEX_POKEMON_FILE;
+    if (argc > 1) n = atoi(argv[1]);
+    if (argc > 3) {
+        moves_path = argv[2];
+        pokemon_path = argv[3];
+    }
+    if (n <= 0) {
+        fprintf(stderr, "usage: %s [count] [moves.csv pokemon.csv]\n", argv[0]);
+        return 2;
+    }
+
+    Pokedex *dex = pokedex_load(moves_path, pokemon_path, bm_cpu_count());
+    if (!dex || dex->pokemon_count == 0 || dex->move_count == 0) return 2;
+
+    DamageTables tables;
+    uint16_t *idx = (uint16_t *)malloc((size_t)n * 3 * sizeof(uint16_t));
+    int32_t *expected = (int32_t *)malloc((size_t)n * sizeof(int32_t));
+    int32_t *out = (int32_t *)malloc((size_t)n * sizeof(int32_t));
+    if (!idx || !expected || !out || !damage_tables_build(&tables, dex)) {
+        fprintf(stderr, "damage_bench: out of memory\n");
+        return 1;
+    }
+
+    BenchSet b = { dex, &tables, idx, idx + n, idx + 2 * (size_t)n, n, expected };
+    for (int i = 0; i < n; i++) {
+        idx[i] = (uint16_t)bench_rand((uint32_t)dex->pokemon_count);
+        idx[n + i] = (uint16_t)bench_rand((uint32_t)dex->pokemon_count);
+        idx[2 * (size_t)n + i] = (uint16_t)bench_rand((uint32_t)dex->move_count);
+    }
+
+    printf("%d tuples, roll %d, AVX2 %s\n", n, BENCH_ROLL, damage_batch_has_avx2() ? "yes" : "no");
+    double base = measure("calculate_damage", run_per_call, &b);
+
+    int failed = 0;
+    b.out = out;
+    double scalar = measure("damage_batch_scalar", run_scalar, &b);
+    if (memcmp(out, expected, (size_t)n * sizeof(int32_t)) != 0) {
+        printf("MISMATCH: damage_batch_scalar differs from calculate_damage\n");
+        failed = 1;
+    }
+    memset(out, 0, (size_t)n * sizeof(int32_t));
+    double batch = measure("damage_batch", run_batch, &b);
+    if (memcmp(out, expected, (size_t)n * sizeof(int32_t)) != 0) {
+        printf("MISMATCH: damage_batch differs from calculate_damage\n");
+        failed = 1;
+    }
+
+    printf("speedup vs calculate_damage: scalar %.2fx, batch %.2fx\n", scalar / base, batch / base);
+
+    damage_tables_free(&tables);
+    free(idx);
+    free(expected);
+    free(out);
+    pokedex_free(dex);
+    return failed;
+}
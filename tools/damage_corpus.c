@@ -0,0 +1,80 @@
+// damage_corpus - exact-equality check of calculate_damage() across builds
+//
+// Build and run from the repository root:
+//   gcc -I. tools/damage_corpus.c BattleManager.c battle_ai.c damage_cache.c battle_log.c pokemon_data.c csv_reader.c type_chart.c -o damage_corpus.exe
+//   damage_corpus.exe [--expect HEX] [moves.csv pokemon.csv]
+//
+// Runs every attacker x defender x move x roll (85..100) combination in the
+// dataset and folds the results into one 64-bit FNV-1a digest. Two builds
+// (different compilers, -O levels, x87 vs SSE, ...) agree bit for bit when
+// they print the same digest. With --expect the exit code is 1 on mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "BattleManager.h"
+#include "thread_compat.h"
+
+// Digest of the moves.csv/pokemon.csv shipped with the repository
+#define SHIPPED_DIGEST "8d02f5815c5cf155"
+
+static uint64_t fnv1a_u16(uint64_t h, uint16_t v) {
+    h = (h ^ (v & 0xFF)) * 0x100000001B3ull;
+    h = (h ^ (v >> 8)) * 0x100000001B3ull;
+    return h;
+}
+
+int main(int argc, char **argv) {
+    const char *expect = NULL;
+    const char *moves_path = POKEDEX_MOVES_FILE;
+    const char *pokemon_path = POKEDEX_POKEMON_FILE;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "--expect") == 0) {
+        expect = argv[arg + 1];
+        arg += 2;
+    }
+    if (arg + 1 < argc) {
+        moves_path = argv[arg];
+        pokemon_path = argv[arg + 1];
+    } else if (!expect) {
+        expect = SHIPPED_DIGEST;
+    }
+
+    Pokedex *dex = pokedex_load(moves_path, pokemon_path, bm_cpu_count());
+    if (!dex) return 2;
+
+    uint64_t digest = 0xCBF29CE484222325ull;
+    unsigned long long cases = 0, immune = 0;
+    int max_damage = 0;
+
+    for (int a = 0; a < dex->pokemon_count; a++) {
+        const Pokemon *attacker = &dex->pokemon[a];
+        for (int d = 0; d < dex->pokemon_count; d++) {
+            const Pokemon *defender = &dex->pokemon[d];
+            for (int m = 0; m < dex->move_count; m++) {
+                const Move *move = &dex->moves[m];
+                for (int roll = 85; roll <= 100; roll++) {
+                    int dmg = calculate_damage(attacker, defender, move, roll);
+                    if (dmg > max_damage) max_damage = dmg;
+                    if (dmg == 0) immune++;
+                    digest = fnv1a_u16(digest, (uint16_t)dmg);
+                    cases++;
+                }
+            }
+        }
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)digest);
+    printf("cases: %llu (zero damage: %llu, max: %d)\n", cases, immune, max_damage);
+    printf("digest: %s\n", hex);
+    pokedex_free(dex);
+
+    if (expect && strcmp(expect, hex) != 0) {
+        printf("MISMATCH: expected %s\n", expect);
+        return 1;
+    }
+    if (expect) printf("OK: matches %s\n", expect);
+    return 0;
+}
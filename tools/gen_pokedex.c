@@ -0,0 +1,136 @@
+// gen_pokedex - turns moves.csv + pokemon.csv into pokedex_embedded.c
+//
+// Build and run from the repository root:
+//   gcc -I. tools/gen_pokedex.c pokemon_data.c csv_reader.c type_chart.c -o gen_pokedex.exe
+//   gen_pokedex.exe moves.csv pokemon.csv pokedex_embedded.c
+//
+// The output holds every table as static const data (stats, interned type
+// IDs, learnsets, string pool, the perfect-hash name index and the sorted
+// name arrays used for completion), so a binary built with -DPOKEDEX_EMBEDDED
+// never opens the CSV files.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pokemon_data.h"
+
+static void write_strings(FILE *out, const char *s, uint32_t size) {
+    fprintf(out, "static const char embedded_strings[%u] =\n    \"", (unsigned)size);
+    int column = 5;
+    // The array size drops the literal's implicit trailing NUL
+    for (uint32_t i = 0; i < size; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\0') {
+            fputs("\\000", out);
+            column += 4;
+            if (column > 90 && i + 1 < size) {
+                fputs("\"\n    \"", out);
+                column = 5;
+            }
+        } else if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+            column += 2;
+        } else if (c < 0x20 || c >= 0x7F) {
+            fprintf(out, "\\%03o", c);
+            column += 4;
+        } else {
+            fputc(c, out);
+            column++;
+        }
+    }
+    fputs("\";\n\n", out);
+}
+
+static void write_u16_array(FILE *out, const char *name, const uint16_t *v, uint32_t n) {
+    fprintf(out, "static const uint16_t %s[%u] = {", name, (unsigned)(n ? n : 1));
+    for (uint32_t i = 0; i < n; i++) {
+        fprintf(out, "%s%u,", i % 16 == 0 ? "\n    " : " ", (unsigned)v[i]);
+    }
+    fputs(n ? "\n};\n\n" : " 0 };\n\n", out);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s moves.csv pokemon.csv pokedex_embedded.c\n", argv[0]);
+        return 2;
+    }
+
+    Pokedex *dex = pokedex_load(argv[1], argv[2], 1);
+    if (!dex || dex->pokemon_count == 0 || dex->move_count == 0) {
+        fprintf(stderr, "gen_pokedex: could not load %s / %s\n", argv[1], argv[2]);
+        return 1;
+    }
+    if (!dex->name_buckets) {
+        fprintf(stderr, "gen_pokedex: could not build the name index\n");
+        return 1;
+    }
+
+    FILE *out = fopen(argv[3], "w");
+    if (!out) {
+        fprintf(stderr, "gen_pokedex: cannot write %s\n", argv[3]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by tools/gen_pokedex.c from %s and %s - do not edit.\n", argv[1], argv[2]);
+    fputs("// Build with -DPOKEDEX_EMBEDDED.\n\n#include \"pokemon_data.h\"\n\n", out);
+
+    fprintf(out, "static const Move embedded_moves[%d] = {\n", dex->move_count);
+    for (int i = 0; i < dex->move_count; i++) {
+        const Move *m = &dex->moves[i];
+        fprintf(out, "    { .name = %u, .id = %u, .power = %u, .type_id = %u, .category = %u, .accuracy = %u }, // %s\n",
+                (unsigned)m->name, (unsigned)m->id, (unsigned)m->power, (unsigned)m->type_id,
+                (unsigned)m->category, (unsigned)m->accuracy, move_name(dex, (uint16_t)i));
+    }
+    fputs("};\n\n", out);
+
+    fprintf(out, "static const Pokemon embedded_pokemon[%d] = {\n", dex->pokemon_count);
+    for (int i = 0; i < dex->pokemon_count; i++) {
+        const Pokemon *p = &dex->pokemon[i];
+        fprintf(out, "    { // %s\n        .learnset = {", pokemon_name(dex, p));
+        for (int w = 0; w < MOVE_BITSET_WORDS; w++) {
+            fprintf(out, "%s0x%016llxull", w ? ", " : " ", (unsigned long long)p->learnset[w]);
+        }
+        fprintf(out, " },\n        .name = %u, .hp = %u, .attack = %u, .defense = %u,"
+                     " .sp_attack = %u, .sp_defense = %u, .speed = %u,\n"
+                     "        .type1_id = %u, .type2_id = %u,\n        .against = {",
+                (unsigned)p->name, (unsigned)p->hp, (unsigned)p->attack, (unsigned)p->defense,
+                (unsigned)p->sp_attack, (unsigned)p->sp_defense, (unsigned)p->speed,
+                (unsigned)p->type1_id, (unsigned)p->type2_id);
+        for (int t = 0; t < TYPE_COUNT; t++) fprintf(out, "%s%u", t ? ", " : " ", (unsigned)p->against[t]);
+        fputs(" } },\n", out);
+    }
+    fputs("};\n\n", out);
+
+    write_u16_array(out, "embedded_name_seeds", dex->name_seeds, dex->name_buckets);
+    write_u16_array(out, "embedded_name_slots", dex->name_slots, dex->name_slot_count);
+    write_u16_array(out, "embedded_pokemon_sorted", dex->pokemon_sorted, (uint32_t)dex->pokemon_count);
+    write_u16_array(out, "embedded_moves_sorted", dex->moves_sorted, (uint32_t)dex->move_count);
+    write_strings(out, dex->strings, dex->strings_size);
+
+    fprintf(out,
+        "const Pokedex pokedex_embedded = {\n"
+        "    .pokemon = embedded_pokemon,\n"
+        "    .moves = embedded_moves,\n"
+        "    .strings = embedded_strings,\n"
+        "    .pokemon_count = %d,\n"
+        "    .move_count = %d,\n"
+        "    .strings_size = %u,\n"
+        "    .name_seeds = embedded_name_seeds,\n"
+        "    .name_slots = embedded_name_slots,\n"
+        "    .name_buckets = %u,\n"
+        "    .name_slot_count = %u,\n"
+        "    .pokemon_sorted = embedded_pokemon_sorted,\n"
+        "    .moves_sorted = embedded_moves_sorted,\n"
+        "};\n",
+        dex->pokemon_count, dex->move_count, (unsigned)dex->strings_size,
+        (unsigned)dex->name_buckets, (unsigned)dex->name_slot_count);
+
+    int failed = ferror(out);
+    if (fclose(out) != 0) failed = 1;
+    if (failed) {
+        fprintf(stderr, "gen_pokedex: error writing %s\n", argv[3]);
+        return 1;
+    }
+    printf("gen_pokedex: wrote %s (%d Pokemon, %d moves)\n", argv[3], dex->pokemon_count, dex->move_count);
+    pokedex_free(dex);
+    return 0;
+}
@@ -0,0 +1,243 @@
+// pool_bench - turns per second of the battle worker pool vs worker count
+//
+// Build and run from the repository root:
+//   gcc -O2 -I. tools/pool_bench.c battle_pool.c battle_session.c battle_heartbeat.c BattleManager.c battle_ai.c damage_cache.c battle_log.c pokemon_data.c csv_reader.c type_chart.c -o pool_bench.exe
+//   pool_bench.exe [-b battles] [-w max_workers] [-m CLASSIC|FAST|HOSTED] [-u] [-l]
+//
+// Every battle is two sessions of the pool, host and joiner, and the handler
+// passes each outgoing message to the other side's session as a received
+// packet, so the full protocol (both BattleManagers, message parsing and
+// building) runs on the workers instead of the network. A side whose turn it
+// is picks the first damaging move its Pokemon knows. The two sessions of a
+// battle usually live on different workers, like peers served by one process.
+//
+// Runs with 1, 2, 4, ... workers up to max_workers (default: one per CPU);
+// -u leaves the workers unpinned; -l starts every battle with the
+// HANDSHAKE / BATTLE_SETUP exchange of the session flow.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "battle_pool.h"
+#include "battle_rng.h"
+#include "thread_compat.h"
+
+#define BENCH_CACHE_LINE 64
+#define BENCH_TIMEOUT 120.0 // seconds before a run is reported as stuck
+
+typedef struct {
+    uint64_t turns;
+    char pad[BENCH_CACHE_LINE - sizeof(uint64_t)];
+} WorkerTally;
+
+typedef struct {
+    BattlePool *pool;
+    const Pokedex *dex;
+    uint16_t *moveOf;        // first damaging move per Pokemon, 0xFFFF = none
+    uint16_t *hostPokemon;   // per battle
+    uint16_t *joinerPokemon;
+    uint8_t *done;           // per session; only its worker writes it
+    WorkerTally *tally;      // per worker
+    BattlePoolStats *stats;  // per worker, after the run
+    bm_atomic_int finished;  // sessions that reached GAME_OVER
+} Bench;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Inboxes are sized so they never fill up, but stay correct if they do
+static void submit(BattlePool *pool, uint64_t session, BattlePoolEvent event, const char *text) {
+    while (!battle_pool_submit(pool, session, event, text)) bm_yield();
+}
+
+static void on_event(void *user, int worker, uint64_t session, BattleSession *s) {
+    Bench *b = (Bench *)user;
+    if (!s || b->done[session]) return;
+    BattleManager *bm = &s->bm;
+
+    for (int i = 0; i < BattleManager_OutgoingCount(bm); i++) {
+        int audience;
+        const char *out = BattleManager_OutgoingAt(bm, i, NULL, &audience);
+        if (audience & BM_TO_PEER) submit(b->pool, session ^ 1, BATTLE_POOL_MESSAGE, out);
+    }
+
+    if (!battle_session_playing(s)) {
+        return; // still in the lobby
+    } else if (bm->ctx.currentState == STATE_GAME_OVER) {
+        b->done[session] = 1;
+        if (bm->ctx.isHost) b->tally[worker].turns += bm->ctx.turn;
+        bm_atomic_inc(&b->finished);
+    } else if (bm->ctx.currentState == STATE_WAITING_FOR_MOVE) {
+        uint64_t battle = session >> 1;
+        uint16_t p = bm->ctx.isHost ? b->hostPokemon[battle] : b->joinerPokemon[battle];
+        submit(b->pool, session, BATTLE_POOL_INPUT, move_name(b->dex, b->moveOf[p]));
+    }
+}
+
+static int run(Bench *b, int battles, int workers, int pin, int lobby, BattleTurnMode mode, double *elapsed) {
+    int sessions = 2 * battles;
+    int perWorker = sessions / workers + sessions / workers / 4 + 64; // hashing is not exact
+    BattlePoolConfig config = { workers, pin, perWorker, 2 * perWorker, on_event, b };
+
+    memset(b->done, 0, (size_t)sessions);
+    memset(b->tally, 0, sizeof(WorkerTally) * (size_t)workers);
+    bm_atomic_store(&b->finished, 0);
+    b->pool = battle_pool_create(&config);
+    if (!b->pool) return 0;
+
+    double start = now_seconds();
+    for (int i = 0; i < battles; i++) {
+        const char *host = pokemon_name(b->dex, &b->dex->pokemon[b->hostPokemon[i]]);
+        const char *joiner = pokemon_name(b->dex, &b->dex->pokemon[b->joinerPokemon[i]]);
+        BattleSessionSetup hs = { 1, lobby, (uint8_t)mode, 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1), "", "" };
+        BattleSessionSetup js = hs;
+        js.isHost = 0;
+        snprintf(hs.myPokemon, sizeof(hs.myPokemon), "%s", host);
+        snprintf(hs.oppPokemon, sizeof(hs.oppPokemon), "%s", joiner);
+        snprintf(js.myPokemon, sizeof(js.myPokemon), "%s", joiner);
+        snprintf(js.oppPokemon, sizeof(js.oppPokemon), "%s", host);
+
+        // Whoever speaks first is opened second, so the other side's OPEN is
+        // queued before the first message reaches it
+        if (lobby) {
+            while (!battle_pool_open(b->pool, 2 * (uint64_t)i, &hs)) bm_yield();
+            while (!battle_pool_open(b->pool, 2 * (uint64_t)i + 1, &js)) bm_yield();
+        } else {
+            while (!battle_pool_open(b->pool, 2 * (uint64_t)i + 1, &js)) bm_yield();
+            while (!battle_pool_open(b->pool, 2 * (uint64_t)i, &hs)) bm_yield();
+        }
+    }
+    while (bm_atomic_load(&b->finished) < sessions && now_seconds() - start < BENCH_TIMEOUT) bm_sleep_ms(1);
+    *elapsed = now_seconds() - start;
+
+    // Finished sessions are freed right after their last handler call
+    int ok = bm_atomic_load(&b->finished) == sessions;
+    for (int live = 1; ok && live;) {
+        live = 0;
+        for (int w = 0; w < workers; w++) {
+            battle_pool_stats(b->pool, w, &b->stats[w]);
+            live += b->stats[w].live;
+        }
+        if (live) bm_yield();
+    }
+    battle_pool_destroy(b->pool);
+    b->pool = NULL;
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int battles = 10000, max_workers = bm_cpu_count(), pin = 1, lobby = 0;
+    BattleTurnMode mode = TURN_MODE_CLASSIC;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc) battles = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) max_workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc) mode = BattleManager_NegotiateTurnMode(argv[i + 1], argv[i + 1]), i++;
+        else if (!strcmp(argv[i], "-u")) pin = 0;
+        else if (!strcmp(argv[i], "-l")) lobby = 1;
+        else {
+            fprintf(stderr, "usage: %s [-b battles] [-w max_workers] [-m CLASSIC|FAST|HOSTED] [-u] [-l]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (battles < 1 || max_workers < 1) return 2;
+
+    const Pokedex *dex = pokedex_acquire();
+    if (!dex || dex->pokemon_count == 0) {
+        fprintf(stderr, "pool_bench: cannot load moves.csv/pokemon.csv\n");
+        return 1;
+    }
+    BattleManager_SetConsoleOutput(false);
+
+    Bench b;
+    memset(&b, 0, sizeof(b));
+    b.dex = dex;
+    b.moveOf = (uint16_t *)malloc(sizeof(uint16_t) * (size_t)dex->pokemon_count);
+    uint16_t *fighters = (uint16_t *)malloc(sizeof(uint16_t) * (size_t)dex->pokemon_count);
+    b.hostPokemon = (uint16_t *)malloc(sizeof(uint16_t) * (size_t)battles);
+    b.joinerPokemon = (uint16_t *)malloc(sizeof(uint16_t) * (size_t)battles);
+    b.done = (uint8_t *)malloc((size_t)battles * 2);
+    b.tally = (WorkerTally *)malloc(sizeof(WorkerTally) * (size_t)max_workers);
+    b.stats = (BattlePoolStats *)malloc(sizeof(BattlePoolStats) * (size_t)max_workers);
+    if (!b.moveOf || !fighters || !b.hostPokemon || !b.joinerPokemon || !b.done || !b.tally || !b.stats) {
+        fprintf(stderr, "pool_bench: out of memory\n");
+        return 1;
+    }
+
+    int n = 0;
+    for (int p = 0; p < dex->pokemon_count; p++) {
+        b.moveOf[p] = 0xFFFF;
+        for (uint16_t id = 0; id < dex->move_count && b.moveOf[p] == 0xFFFF; id++) {
+            const Move *m = &dex->moves[id];
+            if (pokemon_knows_move(&dex->pokemon[p], id) && m->power > 0 && m->category != MOVE_STATUS)
+                b.moveOf[p] = id;
+        }
+        if (b.moveOf[p] != 0xFFFF) fighters[n++] = (uint16_t)p;
+    }
+    if (n == 0) {
+        fprintf(stderr, "pool_bench: no Pokemon knows a damaging move\n");
+        return 1;
+    }
+    // Only matchups where both moves do damage, so every battle ends
+    uint64_t pick = 12345;
+    for (int i = 0; i < battles; i++) {
+        const Pokemon *host, *joiner;
+        do {
+            pick = splitmix64(pick);
+            b.hostPokemon[i] = fighters[pick % (uint64_t)n];
+            b.joinerPokemon[i] = fighters[(pick >> 32) % (uint64_t)n];
+            host = &dex->pokemon[b.hostPokemon[i]];
+            joiner = &dex->pokemon[b.joinerPokemon[i]];
+        } while (calculate_damage(host, joiner, &dex->moves[b.moveOf[b.hostPokemon[i]]], 85) == 0 ||
+                 calculate_damage(joiner, host, &dex->moves[b.moveOf[b.joinerPokemon[i]]], 85) == 0);
+    }
+
+    static const char *mode_names[TURN_MODE_COUNT] = { "CLASSIC", "FAST", "HOSTED" };
+    printf("%d battles, %s turns%s, %d CPUs, workers %s, %u bytes per session\n", battles, mode_names[mode],
+           lobby ? " after a lobby handshake" : "", bm_cpu_count(), pin ? "pinned" : "unpinned",
+           (unsigned)sizeof(BattleSession));
+    printf("workers   turns/s     battles/s   speedup   peak sessions/slots   arena peak\n");
+
+    double base = 0;
+    for (int workers = 1;; workers = workers * 2 < max_workers ? workers * 2 : max_workers) {
+        double elapsed;
+        if (!run(&b, battles, workers, pin, lobby, mode, &elapsed)) {
+            fprintf(stderr, "pool_bench: run with %d workers failed or did not finish\n", workers);
+            return 1;
+        }
+        uint64_t turns = 0;
+        int peak = 0, slots = 0;
+        uint32_t arena = 0;
+        for (int w = 0; w < workers; w++) {
+            turns += b.tally[w].turns;
+            peak += b.stats[w].highWater;
+            slots += b.stats[w].capacity;
+            if (b.stats[w].arenaPeak > arena) arena = b.stats[w].arenaPeak;
+        }
+        double rate = turns / elapsed;
+        if (workers == 1) base = rate;
+        printf("%7d %10.0f %12.0f %8.2fx %10d/%-10d %7u B\n", workers, rate, battles / elapsed,
+               base > 0 ? rate / base : 0.0, peak, slots, (unsigned)arena);
+        if (workers == max_workers) break;
+    }
+
+    free(b.moveOf);
+    free(fighters);
+    free(b.hostPokemon);
+    free(b.joinerPokemon);
+    free(b.done);
+    free(b.tally);
+    free(b.stats);
+    pokedex_release(dex);
+    return 0;
+}
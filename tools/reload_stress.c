@@ -0,0 +1,120 @@
+// reload_stress - concurrent pokedex_reload() against acquire/release loops
+//
+// Build and run from the repository root (AddressSanitizer turns a snapshot
+// freed under a reader into a hard failure):
+//   gcc -O1 -g -fsanitize=address -I. tools/reload_stress.c pokemon_data.c csv_reader.c type_chart.c -o reload_stress.exe
+//   reload_stress.exe [-r reloaders] [-n reloads] [-t readers]
+//
+// reloaders threads each publish n fresh Pokedexes back to back, so the
+// publishes queue up behind each other, while readers threads pin and drop
+// the current snapshot as fast as they can and check every one they get.
+// Prints OK when all reloads went through and no reader saw a bad snapshot.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pokemon_data.h"
+#include "thread_compat.h"
+
+typedef struct {
+    int reloads;
+    int pokemonCount;
+    int moveCount;
+    bm_atomic_int stop;
+    bm_atomic_int published;
+    bm_atomic_int failedReloads;
+    bm_atomic_int badSnapshots;
+} StressRun;
+
+#define STRESS_CACHE_LINE 64
+
+typedef struct {
+    uint64_t acquires;
+    char pad[STRESS_CACHE_LINE - sizeof(uint64_t)];
+} ReaderTally;
+
+static StressRun run;
+
+static BM_THREAD_RETURN reader_thread(void *arg) {
+    ReaderTally *tally = (ReaderTally *)arg;
+    while (!bm_atomic_load(&run.stop)) {
+        const Pokedex *dex = pokedex_acquire();
+        // Touch the tables too, not just the header
+        if (!dex || dex->pokemon_count != run.pokemonCount || dex->move_count != run.moveCount ||
+            !dex->pokemon[dex->pokemon_count - 1].name || !dex->moves[dex->move_count - 1].name) {
+            bm_atomic_inc(&run.badSnapshots);
+        }
+        pokedex_release(dex);
+        tally->acquires++;
+    }
+    return BM_THREAD_RESULT;
+}
+
+static BM_THREAD_RETURN reloader_thread(void *arg) {
+    (void)arg;
+    for (int i = 0; i < run.reloads; i++) {
+        if (pokedex_reload() > 0) bm_atomic_inc(&run.published);
+        else bm_atomic_inc(&run.failedReloads);
+    }
+    return BM_THREAD_RESULT;
+}
+
+int main(int argc, char **argv) {
+    int reloaders = 4, readers = bm_cpu_count();
+    run.reloads = 25;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) reloaders = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) run.reloads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) readers = atoi(argv[++i]);
+        else {
+            printf("usage: %s [-r reloaders] [-n reloads] [-t readers]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (reloaders < 1) reloaders = 1;
+    if (readers < 1) readers = 1;
+    if (run.reloads < 1) run.reloads = 1;
+
+    const Pokedex *first = pokedex_acquire();
+    if (!first || first->pokemon_count == 0 || first->move_count == 0) {
+        printf("Cannot load %s / %s\n", POKEDEX_MOVES_FILE, POKEDEX_POKEMON_FILE);
+        return 2;
+    }
+    run.pokemonCount = first->pokemon_count;
+    run.moveCount = first->move_count;
+    pokedex_release(first);
+
+    bm_thread_t *threads = (bm_thread_t *)malloc((size_t)(readers + reloaders) * sizeof(bm_thread_t));
+    ReaderTally *tallies = (ReaderTally *)calloc((size_t)readers, sizeof(ReaderTally));
+    if (!threads || !tallies) return 2;
+    uint64_t start = bm_time_ms();
+    for (int i = 0; i < readers; i++) {
+        if (!bm_thread_create(&threads[i], reader_thread, &tallies[i])) return 2;
+    }
+    for (int i = 0; i < reloaders; i++) {
+        if (!bm_thread_create(&threads[readers + i], reloader_thread, NULL)) return 2;
+    }
+    for (int i = 0; i < reloaders; i++) bm_thread_join(threads[readers + i]);
+    bm_atomic_store(&run.stop, 1);
+    for (int i = 0; i < readers; i++) bm_thread_join(threads[i]);
+    double seconds = (double)(bm_time_ms() - start) / 1000.0;
+    unsigned long long acquires = 0;
+    for (int i = 0; i < readers; i++) acquires += tallies[i].acquires;
+    free(threads);
+    free(tallies);
+
+    long published = bm_atomic_load(&run.published);
+    long failed = bm_atomic_load(&run.failedReloads);
+    long bad = bm_atomic_load(&run.badSnapshots);
+    printf("\n%d reloaders x %d reloads, %d readers: %ld published, %ld failed in %.2f s\n",
+           reloaders, run.reloads, readers, published, failed, seconds);
+    printf("acquires: %llu (%.0f per second), bad snapshots: %ld\n",
+           acquires, seconds > 0 ? (double)acquires / seconds : 0.0, bad);
+
+    if (failed || bad || published != (long)reloaders * run.reloads) {
+        printf("FAILED\n");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
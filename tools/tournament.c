@@ -0,0 +1,819 @@
+// tournament - headless brackets over the battle engine
+//
+// Build and run from the repository root:
+//   gcc -O2 -I. tools/tournament.c BattleManager.c battle_ai.c damage_cache.c battle_log.c pokemon_data.c csv_reader.c type_chart.c -o tournament.exe
+//   tournament.exe [-f single|double|round] [-t threads] [-s seed] [-m CLASSIC|FAST|HOSTED] [-a ms]
+//                  [-o standings.csv] [-g matches.csv] [-l battles.pbl] (roster.txt | -r entrants)
+//
+// The roster is one Pokemon name per line, in seeding order (blank lines and
+// lines starting with # are skipped; a Pokemon may enter more than once);
+// -r draws that many random entrants from the Pokedex instead.
+//
+// Formats:
+//   single - single elimination; the bracket is padded to a power of two
+//            with byes for the top seeds (1 v 16, 8 v 9, ...)
+//   double - double elimination: losers drop into the losers' bracket, its
+//            winner meets the winners' champion in a grand final, which is
+//            played again if the losers' side wins the first one
+//   round  - round robin (circle method); standings by wins, then HP margin
+//
+// Every battle is a full protocol exchange between a host and a joiner
+// BattleManager in the same process, in the -m turn mode (default FAST).
+// Each side plays the move that hurts the opponent most, or with -a asks the
+// computer player (battle_ai.c, that many ms per move). A battle still
+// undecided after TOUR_MAX_TURNS attacks goes to the side with more HP left.
+//
+// The matches of a round are played in parallel. Each match gets its seed,
+// and which side hosts (moves first), from (tournament seed, match number),
+// so the results do not depend on the thread count or on timing (except
+// with -a, where the search depth depends on the time budget).
+//
+// Output:
+//   standings.csv - rank, seed, Pokemon, wins, losses, HP margin, where it went out
+//   matches.csv   - one line per battle: stage, round, sides, winner, turns,
+//                   final HP, how it was decided, seed and state hash
+//   battles.pbl   - with -l: every battle in match order, for tools/battle_replay.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BattleManager.h"
+#include "battle_ai.h"
+#include "battle_rng.h"
+#include "damage_batch.h"
+#include "thread_compat.h"
+
+#define TOUR_MAX_TURNS 200     // attacks by both sides before HP decides
+#define TOUR_MAX_ENTRANTS 65536
+#define TOUR_BYE (-1)
+#define TOUR_CACHE_LINE 64
+
+// Streams reserved for the tournament (battle streams start at 0)
+enum {
+    TOUR_RNG_MATCH_SEED = 0x200,
+    TOUR_RNG_HOST_SIDE,
+    TOUR_RNG_ROSTER
+};
+
+typedef enum { FORMAT_SINGLE, FORMAT_DOUBLE, FORMAT_ROUND_ROBIN } TourFormat;
+
+typedef enum { STAGE_WINNERS, STAGE_LOSERS, STAGE_GRAND_FINAL, STAGE_ROUND_ROBIN } TourStage;
+static const char *stage_names[] = { "winners", "losers", "grand_final", "round_robin" };
+
+typedef enum { DECIDED_KO, DECIDED_HP, DECIDED_FORFEIT } TourDecision;
+static const char *decision_names[] = { "KO", "HP", "FORFEIT" };
+
+typedef struct {
+    uint16_t pokemon;   // dex->pokemon index
+    int wins;
+    int losses;
+    double margin;      // sum of (own - opponent's) remaining HP fraction
+    int out;            // elimination level: later is better, champion highest
+    uint8_t outStage;   // where it was eliminated
+    uint16_t outRound;
+} Entrant;
+
+typedef struct {
+    int a, b;           // entrant indexes, a = the better-placed slot
+    int host, joiner;
+    int winner, loser;
+    uint8_t stage;      // TourStage
+    uint8_t decided;    // TourDecision
+    uint16_t round;
+    uint16_t turns;
+    int16_t hostHP, joinerHP;
+    uint64_t seed;
+    uint64_t stateHash;
+    int logWorker;      // battle log bytes [logAt, logAt + logLen) of that worker
+    long logAt, logLen;
+} TourMatch;
+
+typedef struct {
+    const Pokedex *dex;
+    Entrant *entrants;
+    int entrantCount;
+    TourMatch *matches;
+    int matchCount, matchCap;
+    int pendingFrom;    // first match not played yet
+    uint64_t seed;
+    BattleTurnMode mode;
+    int aiBudgetMs;     // 0 = strongest move
+    int threads;
+    int out;            // next elimination level
+    bm_atomic_int next; // next pending match to claim
+    struct TourWorker *workers;
+} Tour;
+
+typedef struct TourWorker {
+    Tour *tour;
+    int id;
+    BattleManager host, joiner;
+    BattleAi *ai[2];    // host side, joiner side
+    BattleLog log;      // file NULL = no binary log
+    char logPath[512];
+    uint64_t battles, turns;
+    bm_thread_t thread;
+    char pad[TOUR_CACHE_LINE];
+} TourWorker;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* ------------------------------------------
+    One battle
+------------------------------------------- */
+// The known move that hurts defender most (lowest ID on ties); any known
+// move if none does, MOVE_NONE if the Pokemon knows no move at all
+static uint16_t strongest_move(const Pokedex *dex, const Pokemon *attacker, const Pokemon *defender) {
+    uint16_t best = MOVE_NONE;
+    int32_t bestBase = DAMAGE_BASE_NONE - 1;
+    for (uint16_t id = 0; id < dex->move_count && id < MOVE_MAX; id++) {
+        if (!pokemon_knows_move(attacker, id)) continue;
+        int32_t base = calculate_damage_base(attacker, defender, &dex->moves[id]);
+        if (base > bestBase) {
+            bestBase = base;
+            best = id;
+        }
+    }
+    return best;
+}
+
+// Hand every queued message of from to to, and the replies back, until
+// both sides are quiet
+static void pump(BattleManager *from, BattleManager *to) {
+    char msg[BM_MAX_MSG_SIZE];
+    for (int hop = 0; hop < 16 && BattleManager_OutgoingCount(from); hop++) {
+        for (int i = 0; i < BattleManager_OutgoingCount(from); i++) {
+            int audience;
+            const char *out = BattleManager_OutgoingAt(from, i, NULL, &audience);
+            if (!(audience & BM_TO_PEER)) continue;
+            snprintf(msg, sizeof(msg), "%s", out);
+            BattleManager_HandleMessage(to, msg);
+        }
+        BattleManager_ClearOutgoingMessage(from);
+        BattleManager *t = from;
+        from = to;
+        to = t;
+    }
+}
+
+static void play_match(TourWorker *w, TourMatch *m) {
+    const Tour *t = w->tour;
+    const Pokedex *dex = t->dex;
+    const char *hostName = pokemon_name(dex, &dex->pokemon[t->entrants[m->host].pokemon]);
+    const char *joinerName = pokemon_name(dex, &dex->pokemon[t->entrants[m->joiner].pokemon]);
+    BattleManager *h = &w->host, *j = &w->joiner;
+
+    BattleManager_Init(h, 1, hostName);
+    BattleManager_Init(j, 0, joinerName);
+    BattleManager_SetSeed(h, m->seed);
+    BattleManager_SetSeed(j, m->seed);
+    BattleManager_SetOpponent(h, joinerName);
+    BattleManager_SetOpponent(j, hostName);
+    BattleManager_SetTurnMode(h, t->mode);
+    BattleManager_SetTurnMode(j, t->mode);
+    if (w->log.file) {
+        BattleManager_SetLog(h, &w->log); // the host's view is the battle of record
+        m->logAt = ftell(w->log.file);
+    }
+    uint16_t moves[2] = { MOVE_NONE, MOVE_NONE };
+    if (t->aiBudgetMs) {
+        BattleManager_SetAi(h, w->ai[0]);
+        BattleManager_SetAi(j, w->ai[1]);
+    } else {
+        moves[0] = strongest_move(dex, h->ctx.myPokemon, h->ctx.oppPokemon);
+        moves[1] = strongest_move(dex, j->ctx.myPokemon, j->ctx.oppPokemon);
+    }
+
+    int forfeit = -1; // side that could not move
+    while (h->ctx.currentState != STATE_GAME_OVER && h->ctx.turn < TOUR_MAX_TURNS) {
+        int side = h->ctx.currentState == STATE_WAITING_FOR_MOVE ? 0
+                 : j->ctx.currentState == STATE_WAITING_FOR_MOVE ? 1 : -1;
+        if (side < 0) break; // neither side can act: settle on HP
+        BattleManager *me = side ? j : h, *peer = side ? h : j;
+        uint32_t turn = me->ctx.turn;
+        BattleManager_HandleUserInput(me, t->aiBudgetMs ? "AUTO" : move_name(dex, moves[side]));
+        if (!BattleManager_OutgoingCount(me) && me->ctx.currentState == STATE_WAITING_FOR_MOVE && me->ctx.turn == turn) {
+            forfeit = side;
+            break;
+        }
+        pump(me, peer);
+    }
+
+    int hostHP = h->ctx.myHP, joinerHP = h->ctx.oppHP;
+    m->turns = (uint16_t)h->ctx.turn;
+    m->hostHP = (int16_t)hostHP;
+    m->joinerHP = (int16_t)joinerHP;
+    m->stateHash = h->ctx.stateHash;
+    int hostWins;
+    if (forfeit >= 0) {
+        m->decided = DECIDED_FORFEIT;
+        hostWins = forfeit == 1;
+    } else if (hostHP <= 0 || joinerHP <= 0) {
+        m->decided = DECIDED_KO;
+        hostWins = joinerHP <= 0;
+    } else {
+        // Undecided: the larger share of HP left, then a coin from the seed
+        int64_t lhs = (int64_t)hostHP * h->ctx.oppPokemon->hp, rhs = (int64_t)joinerHP * h->ctx.myPokemon->hp;
+        m->decided = DECIDED_HP;
+        hostWins = lhs != rhs ? lhs > rhs : (int)(battle_rng(m->seed, 0, 0, TOUR_RNG_HOST_SIDE) >> 63);
+    }
+    m->winner = hostWins ? m->host : m->joiner;
+    m->loser = hostWins ? m->joiner : m->host;
+
+    BattleManager_Release(h); // writes the END record of an undecided battle
+    BattleManager_Release(j);
+    if (w->log.file) m->logLen = ftell(w->log.file) - m->logAt;
+    w->battles++;
+    w->turns += m->turns;
+}
+
+/* ------------------------------------------
+    Running the pending matches in parallel
+------------------------------------------- */
+static BM_THREAD_RETURN tour_worker(void *arg) {
+    TourWorker *w = (TourWorker *)arg;
+    Tour *t = w->tour;
+    long i;
+    while ((i = bm_atomic_inc(&t->next) - 1) < t->matchCount) {
+        t->matches[i].logWorker = w->id;
+        play_match(w, &t->matches[i]);
+    }
+    return BM_THREAD_RESULT;
+}
+
+static void run_pending(Tour *t) {
+    if (t->pendingFrom >= t->matchCount) return;
+    bm_atomic_store(&t->next, t->pendingFrom);
+    int pending = t->matchCount - t->pendingFrom;
+    int threads = t->threads < pending ? t->threads : pending;
+    int started = 1;
+    for (int i = 1; i < threads; i++) {
+        if (!bm_thread_create(&t->workers[i].thread, tour_worker, &t->workers[i])) break;
+        started++;
+    }
+    tour_worker(&t->workers[0]); // matches of workers that failed to start are claimed here
+    for (int i = 1; i < started; i++) bm_thread_join(t->workers[i].thread);
+
+    // Tally in match order, so the standings do not depend on scheduling
+    for (int i = t->pendingFrom; i < t->matchCount; i++) {
+        const TourMatch *m = &t->matches[i];
+        Entrant *win = &t->entrants[m->winner], *lose = &t->entrants[m->loser];
+        const Pokemon *hp = &t->dex->pokemon[t->entrants[m->host].pokemon];
+        const Pokemon *jp = &t->dex->pokemon[t->entrants[m->joiner].pokemon];
+        double hostShare = (double)m->hostHP / hp->hp, joinerShare = (double)m->joinerHP / jp->hp;
+        double hostMargin = hostShare - joinerShare;
+        t->entrants[m->host].margin += hostMargin;
+        t->entrants[m->joiner].margin -= hostMargin;
+        win->wins++;
+        lose->losses++;
+    }
+    t->pendingFrom = t->matchCount;
+}
+
+// Queue a battle (played by run_pending); returns its index
+static int add_match(Tour *t, TourStage stage, int round, int a, int b) {
+    if (t->matchCount == t->matchCap) {
+        int cap = t->matchCap ? t->matchCap * 2 : 1024;
+        TourMatch *grown = (TourMatch *)realloc(t->matches, sizeof(TourMatch) * (size_t)cap);
+        if (!grown) {
+            fprintf(stderr, "tournament: out of memory\n");
+            exit(1);
+        }
+        t->matches = grown;
+        t->matchCap = cap;
+    }
+    int index = t->matchCount++;
+    TourMatch *m = &t->matches[index];
+    memset(m, 0, sizeof(*m));
+    m->a = a;
+    m->b = b;
+    m->stage = (uint8_t)stage;
+    m->round = (uint16_t)round;
+    m->seed = battle_rng(t->seed, (uint32_t)index, 0, TOUR_RNG_MATCH_SEED);
+    int aHosts = (int)(battle_rng(t->seed, (uint32_t)index, 0, TOUR_RNG_HOST_SIDE) >> 63);
+    m->host = aHosts ? a : b;
+    m->joiner = aHosts ? b : a;
+    return index;
+}
+
+// One round of pairs a[i] v b[i]: byes advance without a battle. Winners and
+// losers (TOUR_BYE where there was none) are written in pair order.
+static void play_round(Tour *t, TourStage stage, int round, const int *a, const int *b, int n,
+                       int *winners, int *losers) {
+    int *played = (int *)malloc(sizeof(int) * (size_t)(n > 0 ? n : 1));
+    if (!played) {
+        fprintf(stderr, "tournament: out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        played[i] = -1;
+        if (a[i] == TOUR_BYE || b[i] == TOUR_BYE) {
+            winners[i] = a[i] == TOUR_BYE ? b[i] : a[i];
+            losers[i] = TOUR_BYE;
+        } else {
+            played[i] = add_match(t, stage, round, a[i], b[i]);
+        }
+    }
+    run_pending(t);
+    for (int i = 0; i < n; i++) {
+        if (played[i] < 0) continue;
+        winners[i] = t->matches[played[i]].winner;
+        losers[i] = t->matches[played[i]].loser;
+    }
+    free(played);
+}
+
+static void eliminate(Tour *t, const int *losers, int n, TourStage stage, int round) {
+    for (int i = 0; i < n; i++) {
+        if (losers[i] == TOUR_BYE) continue;
+        Entrant *e = &t->entrants[losers[i]];
+        e->out = t->out;
+        e->outStage = (uint8_t)stage;
+        e->outRound = (uint16_t)round;
+    }
+    t->out++;
+}
+
+/* ------------------------------------------
+    Formats
+------------------------------------------- */
+// Entrants in bracket order for a power-of-two size: seeds 1 v size,
+// then the halves mirrored, so the top seeds meet as late as possible
+static int *bracket_order(int size, int entrants) {
+    int *order = (int *)malloc(sizeof(int) * (size_t)size);
+    int *next = (int *)malloc(sizeof(int) * (size_t)size);
+    if (!order || !next) {
+        fprintf(stderr, "tournament: out of memory\n");
+        exit(1);
+    }
+    order[0] = 0;
+    for (int n = 1; n < size; n *= 2) {
+        for (int i = 0; i < n; i++) {
+            next[2 * i] = order[i];
+            next[2 * i + 1] = 2 * n - 1 - order[i];
+        }
+        memcpy(order, next, sizeof(int) * (size_t)(2 * n));
+    }
+    for (int i = 0; i < size; i++)
+        if (order[i] >= entrants) order[i] = TOUR_BYE;
+    free(next);
+    return order;
+}
+
+// Winners' bracket rounds; with losersOut NULL (single elimination) losers
+// are eliminated, otherwise losersOut[r] gets round r's losers. Returns the
+// champion of the bracket.
+static int winners_bracket(Tour *t, int *slots, int size, int **losersOut) {
+    int *winners = (int *)malloc(sizeof(int) * (size_t)size);
+    int *a = (int *)malloc(sizeof(int) * (size_t)size);
+    int *b = (int *)malloc(sizeof(int) * (size_t)size);
+    if (!winners || !a || !b) {
+        fprintf(stderr, "tournament: out of memory\n");
+        exit(1);
+    }
+    int round = 1;
+    for (int n = size; n > 1; n /= 2, round++) {
+        int pairs = n / 2;
+        for (int i = 0; i < pairs; i++) {
+            a[i] = slots[2 * i];
+            b[i] = slots[2 * i + 1];
+        }
+        int *losers = losersOut ? losersOut[round] : a; // a is free again once the round is queued
+        play_round(t, STAGE_WINNERS, round, a, b, pairs, winners, losers);
+        if (!losersOut) eliminate(t, losers, pairs, STAGE_WINNERS, round);
+        memcpy(slots, winners, sizeof(int) * (size_t)pairs);
+    }
+    free(winners);
+    free(a);
+    free(b);
+    return slots[0];
+}
+
+static void single_elimination(Tour *t, int size) {
+    int *slots = bracket_order(size, t->entrantCount);
+    int champion = winners_bracket(t, slots, size, NULL);
+    t->entrants[champion].out = t->out++;
+    free(slots);
+}
+
+static void double_elimination(Tour *t, int size) {
+    int rounds = 0;
+    while ((1 << rounds) < size) rounds++;
+    int *slots = bracket_order(size, t->entrantCount);
+    int **wbLosers = (int **)calloc((size_t)rounds + 1, sizeof(int *));
+    int *alive = (int *)malloc(sizeof(int) * (size_t)size);
+    int *a = (int *)malloc(sizeof(int) * (size_t)size);
+    int *b = (int *)malloc(sizeof(int) * (size_t)size);
+    int *winners = (int *)malloc(sizeof(int) * (size_t)size);
+    int *losers = (int *)malloc(sizeof(int) * (size_t)size);
+    if (!wbLosers || !alive || !a || !b || !winners || !losers) {
+        fprintf(stderr, "tournament: out of memory\n");
+        exit(1);
+    }
+    for (int r = 1; r <= rounds; r++) {
+        wbLosers[r] = (int *)malloc(sizeof(int) * (size_t)(size >> r));
+        if (!wbLosers[r]) {
+            fprintf(stderr, "tournament: out of memory\n");
+            exit(1);
+        }
+    }
+
+    // The whole winners' bracket first: the losers' rounds only need its
+    // losers, and playing it in one go keeps its rounds wide
+    int wbChampion = winners_bracket(t, slots, size, wbLosers);
+
+    // Losers' round 1 pairs the first-round losers; after that each
+    // winners' round drops its losers in against the survivors (in reverse
+    // order every other round, to avoid early rematches), and the
+    // survivors then play each other down to the next drop
+    int alive_n = size / 2, lbRound = 1;
+    memcpy(alive, wbLosers[1], sizeof(int) * (size_t)alive_n);
+    if (alive_n > 1) {
+        for (int i = 0; i < alive_n / 2; i++) {
+            a[i] = alive[2 * i];
+            b[i] = alive[2 * i + 1];
+        }
+        play_round(t, STAGE_LOSERS, lbRound, a, b, alive_n / 2, winners, losers);
+        eliminate(t, losers, alive_n / 2, STAGE_LOSERS, lbRound++);
+        alive_n /= 2;
+        memcpy(alive, winners, sizeof(int) * (size_t)alive_n);
+    }
+    for (int r = 2; r <= rounds; r++) {
+        for (int i = 0; i < alive_n; i++) {
+            a[i] = alive[i];
+            b[i] = wbLosers[r][(r & 1) ? i : alive_n - 1 - i];
+        }
+        play_round(t, STAGE_LOSERS, lbRound, a, b, alive_n, winners, losers);
+        eliminate(t, losers, alive_n, STAGE_LOSERS, lbRound++);
+        memcpy(alive, winners, sizeof(int) * (size_t)alive_n);
+        if (alive_n > 1) {
+            for (int i = 0; i < alive_n / 2; i++) {
+                a[i] = alive[2 * i];
+                b[i] = alive[2 * i + 1];
+            }
+            play_round(t, STAGE_LOSERS, lbRound, a, b, alive_n / 2, winners, losers);
+            eliminate(t, losers, alive_n / 2, STAGE_LOSERS, lbRound++);
+            alive_n /= 2;
+            memcpy(alive, winners, sizeof(int) * (size_t)alive_n);
+        }
+    }
+    int lbChampion = alive[0];
+
+    // Grand final, and the reset if the winners' champion takes its first loss
+    int champion = wbChampion;
+    if (lbChampion != TOUR_BYE) {
+        int w, l;
+        play_round(t, STAGE_GRAND_FINAL, 1, &wbChampion, &lbChampion, 1, &w, &l);
+        if (w == lbChampion) play_round(t, STAGE_GRAND_FINAL, 2, &wbChampion, &lbChampion, 1, &w, &l);
+        eliminate(t, &l, 1, STAGE_GRAND_FINAL, w == lbChampion ? 2 : 1);
+        champion = w;
+    }
+    t->entrants[champion].out = t->out++;
+
+    for (int r = 1; r <= rounds; r++) free(wbLosers[r]);
+    free(wbLosers);
+    free(alive);
+    free(a);
+    free(b);
+    free(winners);
+    free(losers);
+    free(slots);
+}
+
+// Circle method: entrant 0 stays, the others rotate; an odd field gets a bye
+static void round_robin(Tour *t) {
+    int n = t->entrantCount + (t->entrantCount & 1);
+    int *ring = (int *)malloc(sizeof(int) * (size_t)n);
+    if (!ring) {
+        fprintf(stderr, "tournament: out of memory\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) ring[i] = i < t->entrantCount ? i : TOUR_BYE;
+    for (int round = 1; round < n; round++) {
+        for (int i = 0; i < n / 2; i++) {
+            int x = ring[i], y = ring[n - 1 - i];
+            if (x != TOUR_BYE && y != TOUR_BYE) add_match(t, STAGE_ROUND_ROBIN, round, x, y);
+        }
+        int last = ring[n - 1];
+        memmove(ring + 2, ring + 1, sizeof(int) * (size_t)(n - 2));
+        ring[1] = last;
+    }
+    run_pending(t); // no round depends on another: one parallel batch
+    free(ring);
+}
+
+/* ------------------------------------------
+    Output
+------------------------------------------- */
+static const Tour *sort_tour;
+static int by_standing(const void *x, const void *y) {
+    int i = *(const int *)x, j = *(const int *)y;
+    const Entrant *a = &sort_tour->entrants[i], *b = &sort_tour->entrants[j];
+    if (a->out != b->out) return a->out < b->out ? 1 : -1;
+    if (a->wins != b->wins) return a->wins < b->wins ? 1 : -1;
+    if (a->margin != b->margin) return a->margin < b->margin ? 1 : -1;
+    return i - j;
+}
+
+static void write_csv_name(FILE *out, const char *name) {
+    if (strpbrk(name, ",\"")) {
+        fputc('"', out);
+        for (; *name; name++) {
+            if (*name == '"') fputc('"', out);
+            fputc(*name, out);
+        }
+        fputc('"', out);
+    } else {
+        fputs(name, out);
+    }
+}
+
+// Entrants sharing an elimination level share the best rank among them
+static int *compute_ranks(const Tour *t, const int *order, TourFormat format) {
+    int *rank = (int *)malloc(sizeof(int) * (size_t)t->entrantCount);
+    if (!rank) return NULL;
+    for (int i = 0; i < t->entrantCount; i++) {
+        const Entrant *e = &t->entrants[order[i]];
+        int tied = i > 0 && format != FORMAT_ROUND_ROBIN && e->out == t->entrants[order[i - 1]].out;
+        rank[order[i]] = tied ? rank[order[i - 1]] : i + 1;
+    }
+    return rank;
+}
+
+static int write_standings(const char *path, const Tour *t, const int *order, const int *rank, TourFormat format) {
+    FILE *out = fopen(path, "w");
+    if (!out) return 0;
+    fputs("rank,seed,pokemon,wins,losses,hp_margin,out_stage,out_round\n", out);
+    for (int i = 0; i < t->entrantCount; i++) {
+        const Entrant *e = &t->entrants[order[i]];
+        int champion = format != FORMAT_ROUND_ROBIN && i == 0;
+        fprintf(out, "%d,%d,", rank[order[i]], order[i] + 1);
+        write_csv_name(out, pokemon_name(t->dex, &t->dex->pokemon[e->pokemon]));
+        fprintf(out, ",%d,%d,%.3f,%s,%d\n", e->wins, e->losses, e->margin,
+                format == FORMAT_ROUND_ROBIN ? "" : champion ? "champion" : stage_names[e->outStage],
+                format == FORMAT_ROUND_ROBIN || champion ? 0 : e->outRound);
+    }
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed;
+}
+
+static int write_matches(const char *path, const Tour *t) {
+    FILE *out = fopen(path, "w");
+    if (!out) return 0;
+    fputs("match,stage,round,host_seed,host,joiner_seed,joiner,winner_seed,turns,host_hp,joiner_hp,decided,seed,state_hash\n", out);
+    for (int i = 0; i < t->matchCount; i++) {
+        const TourMatch *m = &t->matches[i];
+        fprintf(out, "%d,%s,%d,%d,", i + 1, stage_names[m->stage], m->round, m->host + 1);
+        write_csv_name(out, pokemon_name(t->dex, &t->dex->pokemon[t->entrants[m->host].pokemon]));
+        fprintf(out, ",%d,", m->joiner + 1);
+        write_csv_name(out, pokemon_name(t->dex, &t->dex->pokemon[t->entrants[m->joiner].pokemon]));
+        fprintf(out, ",%d,%d,%d,%d,%s,%llu,%016llx\n", m->winner + 1, m->turns, m->hostHP, m->joinerHP,
+                decision_names[m->decided], (unsigned long long)m->seed, (unsigned long long)m->stateHash);
+    }
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed;
+}
+
+// Copy every battle out of the workers' scratch logs, in match order
+static int write_battle_log(const char *path, const Tour *t) {
+    FILE *out = fopen(path, "wb");
+    if (!out) return 0;
+    char buf[4096];
+    int ok = 1;
+    for (int i = 0; i < t->matchCount && ok; i++) {
+        const TourMatch *m = &t->matches[i];
+        FILE *in = t->workers[m->logWorker].log.file;
+        if (!in || fseek(in, m->logAt, SEEK_SET) != 0) {
+            ok = 0;
+            break;
+        }
+        for (long left = m->logLen; left > 0 && ok;) {
+            size_t chunk = left < (long)sizeof(buf) ? (size_t)left : sizeof(buf);
+            ok = fread(buf, 1, chunk, in) == chunk && fwrite(buf, 1, chunk, out) == chunk;
+            left -= (long)chunk;
+        }
+    }
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed && ok;
+}
+
+/* ------------------------------------------
+    Roster
+------------------------------------------- */
+static int read_roster(Tour *t, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "tournament: cannot read %s\n", path);
+        return 0;
+    }
+    char line[256];
+    int lineNo = 0, ok = 1;
+    while (fgets(line, sizeof(line), in)) {
+        lineNo++;
+        clean_newline(line);
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t')) line[--len] = '\0';
+        const char *name = line;
+        while (*name == ' ' || *name == '\t') name++;
+        if (!*name || *name == '#') continue;
+
+        const Pokemon *p = getPokemonByName(t->dex, name);
+        if (!p) {
+            fprintf(stderr, "tournament: %s:%d: unknown Pokemon \"%s\"\n", path, lineNo, name);
+            ok = 0;
+            continue;
+        }
+        if (t->entrantCount == TOUR_MAX_ENTRANTS) {
+            fprintf(stderr, "tournament: more than %d entrants\n", TOUR_MAX_ENTRANTS);
+            ok = 0;
+            break;
+        }
+        t->entrants[t->entrantCount++].pokemon = (uint16_t)(p - t->dex->pokemon);
+    }
+    fclose(in);
+    return ok;
+}
+
+/* ------------------------------------------
+    Main
+------------------------------------------- */
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-f single|double|round] [-t threads] [-s seed] [-m CLASSIC|FAST|HOSTED] [-a ms]\n"
+                    "       [-o standings.csv] [-g matches.csv] [-l battles.pbl] (roster.txt | -r entrants)\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    TourFormat format = FORMAT_SINGLE;
+    int threads = bm_cpu_count(), random_entrants = 0, ai_ms = 0;
+    uint64_t seed = 1;
+    BattleTurnMode mode = TURN_MODE_FAST;
+    const char *standings_path = "standings.csv", *matches_path = "matches.csv", *log_path = NULL;
+    const char *roster_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (argv[i][0] != '-') {
+            roster_path = argv[i];
+            continue;
+        }
+        if (!v) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (!strcmp(argv[i], "-f")) {
+            if (!strcmp(v, "single")) format = FORMAT_SINGLE;
+            else if (!strcmp(v, "double")) format = FORMAT_DOUBLE;
+            else if (!strcmp(v, "round")) format = FORMAT_ROUND_ROBIN;
+            else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (!strcmp(argv[i], "-t")) threads = atoi(v);
+        else if (!strcmp(argv[i], "-s")) seed = strtoull(v, NULL, 0);
+        else if (!strcmp(argv[i], "-m")) mode = BattleManager_NegotiateTurnMode(v, v);
+        else if (!strcmp(argv[i], "-a")) ai_ms = atoi(v);
+        else if (!strcmp(argv[i], "-o")) standings_path = v;
+        else if (!strcmp(argv[i], "-g")) matches_path = v;
+        else if (!strcmp(argv[i], "-l")) log_path = v;
+        else if (!strcmp(argv[i], "-r")) random_entrants = atoi(v);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (threads < 1 || ai_ms < 0 || (!roster_path) == (random_entrants <= 0) || random_entrants > TOUR_MAX_ENTRANTS) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const Pokedex *dex = pokedex_acquire();
+    if (!dex || dex->pokemon_count == 0) {
+        fprintf(stderr, "tournament: cannot load moves.csv/pokemon.csv\n");
+        return 1;
+    }
+    BattleManager_SetConsoleOutput(false);
+
+    Tour t;
+    memset(&t, 0, sizeof(t));
+    t.dex = dex;
+    t.seed = seed;
+    t.mode = mode;
+    t.aiBudgetMs = ai_ms;
+    t.threads = threads;
+    t.entrants = (Entrant *)calloc(TOUR_MAX_ENTRANTS, sizeof(Entrant));
+    t.workers = (TourWorker *)calloc((size_t)threads, sizeof(TourWorker));
+    if (!t.entrants || !t.workers) {
+        fprintf(stderr, "tournament: out of memory\n");
+        return 1;
+    }
+    if (roster_path) {
+        if (!read_roster(&t, roster_path)) return 2;
+    } else {
+        for (int i = 0; i < random_entrants; i++)
+            t.entrants[t.entrantCount++].pokemon =
+                (uint16_t)battle_rng_range(battle_rng(seed, (uint32_t)i, 0, TOUR_RNG_ROSTER), 0, dex->pokemon_count - 1);
+    }
+    if (t.entrantCount < 2) {
+        fprintf(stderr, "tournament: need at least 2 entrants\n");
+        return 2;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        TourWorker *w = &t.workers[i];
+        w->tour = &t;
+        w->id = i;
+        if (ai_ms) {
+            BattleAiConfig config = { 1, ai_ms, 0 }; // the matches already fill the CPUs
+            w->ai[0] = battle_ai_create(&config);
+            w->ai[1] = battle_ai_create(&config);
+            if (!w->ai[0] || !w->ai[1]) {
+                fprintf(stderr, "tournament: out of memory\n");
+                return 1;
+            }
+        }
+        if (log_path) {
+            // Scratch log per worker; write_battle_log puts the battles in order
+            snprintf(w->logPath, sizeof(w->logPath), "%s.%d.tmp", log_path, i);
+            w->log.file = fopen(w->logPath, "w+b");
+            if (!w->log.file) {
+                fprintf(stderr, "tournament: cannot create %s\n", w->logPath);
+                return 1;
+            }
+        }
+    }
+
+    int size = 1;
+    while (size < t.entrantCount) size *= 2;
+    static const char *format_names[] = { "single elimination", "double elimination", "round robin" };
+    static const char *mode_names[TURN_MODE_COUNT] = { "CLASSIC", "FAST", "HOSTED" };
+    printf("[TOURNAMENT] %d entrants, %s, %s turns, %s, %d thread(s), seed %llu\n", t.entrantCount,
+           format_names[format], mode_names[mode], ai_ms ? "computer players" : "strongest moves",
+           threads, (unsigned long long)seed);
+
+    double start = now_seconds();
+    if (format == FORMAT_SINGLE) single_elimination(&t, size);
+    else if (format == FORMAT_DOUBLE) double_elimination(&t, size);
+    else round_robin(&t);
+    double elapsed = now_seconds() - start;
+
+    uint64_t turns = 0;
+    for (int i = 0; i < threads; i++) turns += t.workers[i].turns;
+    printf("[TOURNAMENT] %d battles, %llu turns in %.3fs (%.0f battles/s)\n", t.matchCount,
+           (unsigned long long)turns, elapsed, t.matchCount / (elapsed > 0 ? elapsed : 1));
+
+    int *order = (int *)malloc(sizeof(int) * (size_t)t.entrantCount);
+    if (!order) return 1;
+    for (int i = 0; i < t.entrantCount; i++) order[i] = i;
+    sort_tour = &t;
+    qsort(order, (size_t)t.entrantCount, sizeof(int), by_standing);
+    int *rank = compute_ranks(&t, order, format);
+    if (!rank) return 1;
+
+    int show = t.entrantCount < 8 ? t.entrantCount : 8;
+    for (int i = 0; i < show; i++) {
+        const Entrant *e = &t.entrants[order[i]];
+        printf("[TOURNAMENT] %3d. %-16s (seed %d) %d-%d\n", rank[order[i]],
+               pokemon_name(dex, &dex->pokemon[e->pokemon]), order[i] + 1, e->wins, e->losses);
+    }
+
+    int ok = 1;
+    if (write_standings(standings_path, &t, order, rank, format)) printf("[TOURNAMENT] Wrote %s\n", standings_path);
+    else ok = 0, fprintf(stderr, "tournament: error writing %s\n", standings_path);
+    if (write_matches(matches_path, &t)) printf("[TOURNAMENT] Wrote %s\n", matches_path);
+    else ok = 0, fprintf(stderr, "tournament: error writing %s\n", matches_path);
+    if (log_path) {
+        if (write_battle_log(log_path, &t)) printf("[TOURNAMENT] Wrote %s\n", log_path);
+        else ok = 0, fprintf(stderr, "tournament: error writing %s\n", log_path);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        TourWorker *w = &t.workers[i];
+        battle_ai_destroy(w->ai[0]);
+        battle_ai_destroy(w->ai[1]);
+        if (w->log.file) {
+            fclose(w->log.file);
+            remove(w->logPath);
+        }
+    }
+    free(rank);
+    free(order);
+    free(t.matches);
+    free(t.workers);
+    free(t.entrants);
+    pokedex_release(dex);
+    return ok ? 0 : 1;
+}
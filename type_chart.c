@@ -0,0 +1,75 @@
+#include "type_chart.h"
+#include <ctype.h>
+#include <string.h>
+
+static const char *const type_names[TYPE_COUNT] = {
+    "bug", "dark", "dragon", "electric", "fairy", "fighting", "fire", "flying", "ghost",
+    "grass", "ground", "ice", "normal", "poison", "psychic", "rock", "steel", "water"
+};
+
+static const char *const against_columns[TYPE_COUNT] = {
+    "against_bug", "against_dark", "against_dragon", "against_electric", "against_fairy",
+    "against_fight", "against_fire", "against_flying", "against_ghost", "against_grass",
+    "against_ground", "against_ice", "against_normal", "against_poison", "against_psychic",
+    "against_rock", "against_steel", "against_water"
+};
+
+// Attacker row, defender column, in quarters (EFF_SCALE = 1x)
+static const unsigned char type_chart[TYPE_COUNT][TYPE_COUNT] = {
+    /*              bug dar dra ele fai fig fir fly gho gra gro ice nor poi psy roc ste wat */
+    /* bug      */ {  4,  8,  4,  4,  2,  2,  2,  2,  2,  8,  4,  4,  4,  2,  8,  4,  2,  4 },
+    /* dark     */ {  4,  2,  4,  4,  2,  2,  4,  4,  8,  4,  4,  4,  4,  4,  8,  4,  4,  4 },
+    /* dragon   */ {  4,  4,  8,  4,  0,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  2,  4 },
+    /* electric */ {  4,  4,  2,  2,  4,  4,  4,  8,  4,  2,  0,  4,  4,  4,  4,  4,  4,  8 },
+    /* fairy    */ {  4,  8,  8,  4,  4,  8,  2,  4,  4,  4,  4,  4,  4,  2,  4,  4,  2,  4 },
+    /* fighting */ {  2,  8,  4,  4,  2,  4,  4,  2,  0,  4,  4,  8,  8,  2,  2,  8,  8,  4 },
+    /* fire     */ {  8,  4,  2,  4,  4,  4,  2,  4,  4,  8,  4,  8,  4,  4,  4,  2,  8,  2 },
+    /* flying   */ {  8,  4,  4,  2,  4,  8,  4,  4,  4,  8,  4,  4,  4,  4,  4,  2,  2,  4 },
+    /* ghost    */ {  4,  2,  4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  0,  4,  8,  4,  4,  4 },
+    /* grass    */ {  2,  4,  2,  4,  4,  4,  2,  2,  4,  2,  8,  4,  4,  2,  4,  8,  2,  8 },
+    /* ground   */ {  2,  4,  4,  8,  4,  4,  8,  0,  4,  2,  4,  4,  4,  8,  4,  8,  8,  4 },
+    /* ice      */ {  4,  4,  8,  4,  4,  4,  2,  8,  4,  8,  8,  2,  4,  4,  4,  4,  2,  2 },
+    /* normal   */ {  4,  4,  4,  4,  4,  4,  4,  4,  0,  4,  4,  4,  4,  4,  4,  2,  2,  4 },
+    /* poison   */ {  4,  4,  4,  4,  8,  4,  4,  4,  2,  8,  2,  4,  4,  2,  4,  2,  0,  4 },
+    /* psychic  */ {  4,  0,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  2,  4,  2,  4 },
+    /* rock     */ {  8,  4,  4,  4,  4,  2,  8,  8,  4,  4,  2,  8,  4,  4,  4,  4,  2,  4 },
+    /* steel    */ {  4,  4,  4,  2,  8,  4,  2,  4,  4,  4,  4,  8,  4,  4,  4,  8,  2,  2 },
+    /* water    */ {  4,  4,  2,  4,  4,  4,  8,  4,  4,  2,  8,  4,  4,  4,  4,  8,  4,  2 },
+};
+
+static int name_equals(const char *a, size_t len, const char *b) {
+    size_t i = 0;
+    for (; i < len && b[i]; i++) {
+        if (tolower((unsigned char)a[i]) != b[i]) return 0;
+    }
+    return i == len && b[i] == '\0';
+}
+
+unsigned char type_id_from_name(const char *name, size_t len) {
+    while (len > 0 && isspace((unsigned char)*name)) { name++; len--; }
+    while (len > 0 && isspace((unsigned char)name[len - 1])) len--;
+    if (len == 0) return TYPE_NONE;
+
+    for (int t = 0; t < TYPE_COUNT; t++) {
+        if (name_equals(name, len, type_names[t])) return (unsigned char)t;
+    }
+    if (name_equals(name, len, "fight")) return TYPE_FIGHTING; // CSV column spelling
+    return TYPE_NONE;
+}
+
+const char* type_name(unsigned char type) {
+    return type < TYPE_COUNT ? type_names[type] : "";
+}
+
+const char* type_against_column(unsigned char type) {
+    return type < TYPE_COUNT ? against_columns[type] : "";
+}
+
+unsigned char type_chart_single(unsigned char atk, unsigned char def) {
+    if (atk >= TYPE_COUNT || def >= TYPE_COUNT) return EFF_SCALE;
+    return type_chart[atk][def];
+}
+
+unsigned char type_effectiveness(unsigned char atk, unsigned char def1, unsigned char def2) {
+    return (unsigned char)(type_chart_single(atk, def1) * type_chart_single(atk, def2) / EFF_SCALE);
+}
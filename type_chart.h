@@ -0,0 +1,51 @@
+#ifndef TYPE_CHART_H
+#define TYPE_CHART_H
+
+#include <stddef.h>
+
+// --- Interned type IDs ---
+// Order matches the against_* columns of pokemon.csv so a Pokemon's
+// effectiveness vector can be indexed directly by TypeId.
+typedef enum {
+    TYPE_BUG,
+    TYPE_DARK,
+    TYPE_DRAGON,
+    TYPE_ELECTRIC,
+    TYPE_FAIRY,
+    TYPE_FIGHTING,
+    TYPE_FIRE,
+    TYPE_FLYING,
+    TYPE_GHOST,
+    TYPE_GRASS,
+    TYPE_GROUND,
+    TYPE_ICE,
+    TYPE_NORMAL,
+    TYPE_POISON,
+    TYPE_PSYCHIC,
+    TYPE_ROCK,
+    TYPE_STEEL,
+    TYPE_WATER,
+    TYPE_COUNT,
+    TYPE_NONE = 0xFF
+} TypeId;
+
+// Effectiveness is stored in quarters: 0 = immune, 2 = 0.5x, 4 = 1x, 8 = 2x, 16 = 4x
+#define EFF_SCALE 4
+
+// Case-insensitive lookup of "fire", "Fighting", "fight", ... Returns TYPE_NONE
+// for empty or unknown names.
+unsigned char type_id_from_name(const char *name, size_t len);
+
+// Canonical lowercase name ("" for TYPE_NONE)
+const char* type_name(unsigned char type);
+
+// Header name of the CSV column holding effectiveness of `type` ("against_fight", ...)
+const char* type_against_column(unsigned char type);
+
+// Dense 18x18 chart lookup: attacking type vs. one defending type, in quarters.
+unsigned char type_chart_single(unsigned char atk, unsigned char def);
+
+// Attacking type vs. a (possibly dual-typed) defender, in quarters.
+unsigned char type_effectiveness(unsigned char atk, unsigned char def1, unsigned char def2);
+
+#endif
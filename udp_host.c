@@ -14,6 +14,9 @@
 // #include "game_logic.h"
 #pragma comment(lib, "Ws2_32.lib")
 #include "BattleManager.h"
+#include "battle_ai.h"
+#include "battle_heartbeat.h"
+#include "thread_compat.h"
 #include "pokemon_data.h"
 #define MAXBUF 4096
 #define HOST_PORT 9006
@@ -34,8 +37,11 @@ typedef struct {
         int specialAttack;
         int specialDefense;
     } boosts;
+    char turnMode[16]; // CLASSIC, FAST (both sides must ask) or HOSTED (host decides)
 } BattleSetupData;
 
+static const char *turn_mode_names[TURN_MODE_COUNT] = { "CLASSIC", "FAST", "HOSTED" };
+
 static const char b64_table[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
@@ -47,7 +53,12 @@ bool VERBOSE_MODE = false;
 SOCKET sock = INVALID_SOCKET;   // unicast
 SOCKET broad_socket = INVALID_SOCKET; // broadcast listener
 struct sockaddr_in spectator_list[MAX_SPECTATORS];
+BattleHeartbeat spectator_hb[MAX_SPECTATORS]; // liveness of each spectator
 int spectator_count = 0;
+// PING period and misses before a peer is dropped (HEARTBEAT_CONFIG changes them)
+BattleHeartbeatConfig heartbeat_config = {
+    BATTLE_HEARTBEAT_INTERVAL_MS, BATTLE_HEARTBEAT_MIN_TIMEOUT_MS, BATTLE_HEARTBEAT_MAX_MISSED
+};
 void vprint(const char *fmt, ...) {
     if (!VERBOSE_MODE) return;
     va_list ap;
@@ -191,13 +202,18 @@ void processBattleSetup(char *msg, BattleSetupData *out, BattleManager *bm) {
     if (p) sscanf(p, "\"special_attack_uses\": %d", &out->boosts.specialAttack);
     p = strstr(msg, "\"special_defense_uses\": ");
     if (p) sscanf(p, "\"special_defense_uses\": %d", &out->boosts.specialDefense);
-    printf("[HOST] Parsed BATTLE_SETUP: mode=%s, pokemon=%s, atk=%d, def=%d\n",
-           out->communicationMode, out->pokemonName, out->boosts.specialAttack, out->boosts.specialDefense);
+    // Peers that predate turn_mode play classic turns
+    strcpy(out->turnMode, "CLASSIC");
+    p = strstr(msg, "turn_mode: ");
+    if (p) sscanf(p, "turn_mode: %15[^\n]", out->turnMode);
+    printf("[HOST] Parsed BATTLE_SETUP: mode=%s, pokemon=%s, atk=%d, def=%d, turns=%s\n",
+           out->communicationMode, out->pokemonName, out->boosts.specialAttack, out->boosts.specialDefense,
+           out->turnMode);
     
-    if (!battle_manager_initialized) {
-        BattleManager_Init(bm, 1, out->pokemonName); // 1 = host player
-        battle_manager_initialized = true;
-        printf("[HOST] BattleManager initialized for host Pokemon: %s\n", out->pokemonName);
+    // The joiner's Pokemon is our opponent; if our own setup is not done yet
+    // it is applied when the host sends BATTLE_SETUP.
+    if (battle_manager_initialized) {
+        BattleManager_SetOpponent(bm, out->pokemonName);
     }
 }
 
@@ -246,6 +262,79 @@ void sendMessageAuto(const char *msg,
         printf("[HOST] Unicast message sent.\n");
 }
 
+/* Everything the BattleManager queued, in order: one datagram per message to
+   the joiner and/or every spectator (hosted TURN_RESULTs go to both) */
+void sendOutgoing(BattleManager *bm, struct sockaddr_in peer, int peerLen, BattleSetupData setup) {
+    for (int i = 0; i < BattleManager_OutgoingCount(bm); i++) {
+        int audience;
+        const char *msg = BattleManager_OutgoingAt(bm, i, NULL, &audience);
+        if (audience & BM_TO_PEER)
+            sendMessageAuto(msg, peer, peerLen, setup, false);
+        if (audience & BM_TO_SPECTATORS)
+            for (int j = 0; j < spectator_count; j++)
+                sendMessageAuto(msg, spectator_list[j], sizeof(spectator_list[j]), setup, false);
+    }
+    BattleManager_ClearOutgoingMessage(bm);
+}
+
+/* Replies queued while handling a received turn message. FAST and HOSTED
+   turns are settled by them, so all of them go out; classic replies are typed
+   by hand (DEFENSE_ANNOUNCE, ...), except a GAME_OVER, which ends the battle */
+void sendReplies(BattleManager *bm, struct sockaddr_in peer, int peerLen, BattleSetupData setup) {
+    if (bm->ctx.turnMode != TURN_MODE_CLASSIC) {
+        sendOutgoing(bm, peer, peerLen, setup);
+        return;
+    }
+    for (int i = 0; i < BattleManager_OutgoingCount(bm); i++) {
+        int audience;
+        const char *msg = BattleManager_OutgoingAt(bm, i, NULL, &audience);
+        if ((audience & BM_TO_PEER) && BattleManager_MessageType(msg) == BATTLE_MSG_GAME_OVER)
+            sendMessageAuto(msg, peer, peerLen, setup, false);
+    }
+    BattleManager_ClearOutgoingMessage(bm);
+}
+
+bool sameAddr(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/* Keepalives go straight out: sendMessageAuto would log every one of them */
+void sendHeartbeat(const char *msg, const struct sockaddr_in *to) {
+    if (sendto(sock, msg, (int)strlen(msg), 0, (const SOCKADDR*)to, sizeof(*to)) == SOCKET_ERROR)
+        vprint("[VERBOSE] Heartbeat to %s:%d failed: %d\n", inet_ntoa(to->sin_addr), ntohs(to->sin_port), WSAGetLastError());
+}
+
+void printHeartbeat(const char *who, const struct sockaddr_in *addr, const BattleHeartbeat *hb) {
+    printf("[HOST] %s %s:%d  srtt %.1f ms  rttvar %.1f ms  timeout %u ms  missed %d/%d  (%u samples)\n",
+           who, inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), battle_heartbeat_srtt_ms(hb),
+           battle_heartbeat_rttvar_ms(hb), (unsigned)battle_heartbeat_timeout_ms(hb), hb->missed,
+           hb->config.maxMissed, (unsigned)hb->samples);
+}
+
+/* The classic turn steps typed by hand; FAST and HOSTED turns send their own */
+bool isClassicStep(const char *line) {
+    return !strcmp(line, "DEFENSE_ANNOUNCE") || !strcmp(line, "CALCULATION_REPORT") ||
+           !strcmp(line, "CALCULATION_CONFIRM") || !strcmp(line, "RESOLUTION_REQUEST");
+}
+
+void addSpectator(const struct sockaddr_in *addr) {
+    for (int i = 0; i < spectator_count; i++) {
+        if (sameAddr(&spectator_list[i], addr)) return;
+    }
+    if (spectator_count == MAX_SPECTATORS) {
+        printf("[HOST] Spectator list full; %s:%d will not get turn results.\n",
+               inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+        return;
+    }
+    battle_heartbeat_start(&spectator_hb[spectator_count], &heartbeat_config, bm_time_ms());
+    spectator_list[spectator_count++] = *addr;
+}
+
+void removeSpectator(int i) {
+    spectator_count--;
+    spectator_list[i] = spectator_list[spectator_count];
+    spectator_hb[i] = spectator_hb[spectator_count];
+}
 
 /* ---------------- main ---------------- */
 int main(void) {
@@ -257,7 +346,14 @@ int main(void) {
     BattleSetupData peer_setup;
 
     BattleManager bm;
-    
+    // every battle is appended here for tools/battle_replay.c (NULL if it cannot be opened)
+    BattleLog *battle_log = battle_log_open("host_battles.pbl");
+    // computer player: "AUTO" as a move name, or AUTO_PLAY for every hosted turn
+    BattleAi *battle_ai = battle_ai_create(NULL);
+    bool auto_play = false;
+    // liveness of the joiner, from its HANDSHAKE_REQUEST on
+    BattleHeartbeat joiner_hb;
+    bool joiner_tracked = false;
 
     // BattleSetupData spectator[10];
     // int spectator_count = 0;
@@ -341,6 +437,18 @@ int main(void) {
                 clean_newline(recvbuf);
                 vprint("\n[VERBOSE] Received raw (%d) from %s:%d\n%s\n", br, inet_ntoa(from.sin_addr), ntohs(from.sin_port), recvbuf);
 
+                // every packet is a sign of life; PING/PONG go no further
+                uint64_t now = bm_time_ms();
+                if (joiner_tracked && sameAddr(&from, &last_peer))
+                    battle_heartbeat_heard(&joiner_hb, recvbuf, now);
+                for (int i = 0; i < spectator_count; i++)
+                    if (sameAddr(&from, &spectator_list[i])) battle_heartbeat_heard(&spectator_hb[i], recvbuf, now);
+                if (battle_heartbeat_answer(recvbuf, fullmsg, sizeof(fullmsg))) {
+                    sendHeartbeat(fullmsg, &from);
+                    continue;
+                }
+                if (battle_heartbeat_is_pong(recvbuf)) continue;
+
                 char *mt = get_message_type(recvbuf);
                 if (!mt) continue;
                 // save last peer for unicast replies
@@ -352,52 +460,61 @@ int main(void) {
                     last_peer_len = from_len;
                     sendMessageAuto(fullmsg,last_peer, last_peer_len, my_setup, false);
                     is_handshake_done = true;
+                    battle_heartbeat_start(&joiner_hb, &heartbeat_config, now);
+                    joiner_tracked = true;
                     printf("[HOST] HANDSHAKE_RESPONSE sent to %s:%d\n", inet_ntoa(last_peer.sin_addr), ntohs(last_peer.sin_port));
                 }else if (!strncmp(mt, "SPECTATOR_REQUEST", strlen("SPECTATOR_REQUEST"))) {
                     printf("[HOST] SPECTATOR_REQUEST from %s:%d\n", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
                     snprintf(fullmsg,sizeof(fullmsg),"message_type: SPECTATOR_RESPONSE");
-                    last_peer = from;
-                    last_peer_len = from_len;
-                    sendMessageAuto(fullmsg, last_peer,last_peer_len,my_setup,false);
-                    printf("[HOST] SPECTATOR_RESPONSE sent to %s:%d\n", inet_ntoa(last_peer.sin_addr), ntohs(last_peer.sin_port));
+                    // keep last_peer on the joiner; spectators get TURN_RESULTs from the list
+                    addSpectator(&from);
+                    sendMessageAuto(fullmsg, from, from_len, my_setup, false);
+                    printf("[HOST] SPECTATOR_RESPONSE sent to %s:%d\n", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
                 }
                 else if (!strncmp(mt, "BATTLE_SETUP", strlen("BATTLE_SETUP"))) {
                     printf("[HOST] Received BATTLE_SETUP from %s:%d\n%s\n", inet_ntoa(from.sin_addr), ntohs(from.sin_port), recvbuf);
                     // parse joiner's setup into peer_setup
                     processBattleSetup(recvbuf, &peer_setup,&bm);
-                    sprintf(recvbuf,
-                        "message_type: BATTLE_SETUP\n"
-                        "communication_mode: %s\n"
-                        "pokemon_name: %s\n"
-                        "stat_boosts: { \"special_attack_uses\": %d, \"special_defense_uses\": %d }\n",
-                        peer_setup.communicationMode, peer_setup.pokemonName,
-                        peer_setup.boosts.specialAttack, peer_setup.boosts.specialDefense);
-                    sendMessageAuto(recvbuf,last_peer,last_peer_len,peer_setup,true);
+                    // Answer with our own setup and the agreed turn mode; the joiner
+                    // takes this Pokemon as its opponent. Before our setup is done
+                    // there is nothing to answer: it goes out when the host sends it.
+                    if (battle_manager_initialized) {
+                        BattleTurnMode mode = BattleManager_NegotiateTurnMode(my_setup.turnMode, peer_setup.turnMode);
+                        BattleManager_SetTurnMode(&bm, mode);
+                        sprintf(recvbuf,
+                            "message_type: BATTLE_SETUP\n"
+                            "communication_mode: %s\n"
+                            "pokemon_name: %s\n"
+                            "stat_boosts: { \"special_attack_uses\": %d, \"special_defense_uses\": %d }\n"
+                            "turn_mode: %s\n",
+                            my_setup.communicationMode, my_setup.pokemonName,
+                            my_setup.boosts.specialAttack, my_setup.boosts.specialDefense,
+                            turn_mode_names[mode]);
+                        sendMessageAuto(recvbuf,last_peer,last_peer_len,my_setup,true);
+                    }
                     is_battle_started = true;
                 }
-                else if (!strcmp(mt, "ATTACK_ANNOUNCE")) {
-                    handle_attack_announce(&bm,recvbuf);
-                }
-                else if (!strcmp(mt, "DEFENSE_ANNOUNCE")) {
-                    handle_defense_announce(&bm, recvbuf,peer_setup.pokemonName);
-                }
-                else if (!strcmp(mt, "CALCULATION_REPORT")) {
-                    handle_calculation_report(&bm, recvbuf);
-                }
-                else if (!strcmp(mt, "CALCULATION_CONFIRM")) {
-                    handle_calculation_confirm(&bm, recvbuf);
-                }
-                else if (!strcmp(mt, "RESOLUTION_REQUEST")) {
-                    handle_resolution_request(&bm, recvbuf);
-                }
-                else if (!strcmp(mt, "GAME_OVER")) {
-                    handle_game_over(&bm, recvbuf);
+                else if (BattleManager_MessageType(recvbuf) != BATTLE_MSG_NONE) {
+                    // turn messages are validated by the BattleManager's transition table
+                    if (battle_manager_initialized) {
+                        BattleManager_HandleMessage(&bm, recvbuf);
+                        sendReplies(&bm, last_peer, last_peer_len, my_setup);
+                    }
+                    else printf("[HOST] Battle message before BATTLE_SETUP ignored.\n");
                 }
 
                 else if (!strncmp(mt, "CHAT_MESSAGE", strlen("CHAT_MESSAGE"))) {
                     // chat arrived from joiner (unicast or broadcast depending on joiner)
                     processChatMessage(recvbuf);
                 }
+                else if (!strncmp(mt, "NAME_QUERY_RESULT", strlen("NAME_QUERY_RESULT"))) {
+                    printf("\n[HOST] %s\n", recvbuf);
+                }
+                else if (!strncmp(mt, "NAME_QUERY", strlen("NAME_QUERY"))) {
+                    // lobby autocomplete: answer from the current Pokedex
+                    BattleManager_AnswerNameQuery(recvbuf, fullmsg, sizeof(fullmsg));
+                    sendMessageAuto(fullmsg, from, from_len, my_setup, false);
+                }
                 else if (!strcmp(mt, "VERBOSE_ON")) {
                     VERBOSE_MODE = true;
                     printf("\n[SYSTEM] Verbose mode enabled.\n");
@@ -412,6 +529,50 @@ int main(void) {
             }
         }
 
+        // keepalives: probe quiet peers, drop the ones that stopped answering
+        uint64_t now = bm_time_ms();
+        if (joiner_tracked) {
+            BattleHeartbeatAction hb = battle_heartbeat_poll(&joiner_hb, now);
+            if (hb == BATTLE_HEARTBEAT_PING) {
+                battle_heartbeat_format_ping(&joiner_hb, fullmsg, sizeof(fullmsg));
+                sendHeartbeat(fullmsg, &last_peer);
+            } else if (hb == BATTLE_HEARTBEAT_DEAD) {
+                // Reclaim the abandoned battle now (its log gets an END record)
+                // and wait for the next HANDSHAKE_REQUEST
+                printf("[HOST] Joiner %s:%d stopped answering (%d PINGs missed); battle abandoned.\n",
+                       inet_ntoa(last_peer.sin_addr), ntohs(last_peer.sin_port), joiner_hb.missed);
+                if (battle_manager_initialized) BattleManager_Release(&bm);
+                battle_manager_initialized = false;
+                is_handshake_done = false;
+                is_battle_started = false;
+                battle_setup_received = false;
+                memset(&peer_setup, 0, sizeof(peer_setup));
+                joiner_tracked = false;
+                printf("Waiting for handshake request...\n");
+            }
+        }
+        for (int i = 0; i < spectator_count;) {
+            BattleHeartbeatAction hb = battle_heartbeat_poll(&spectator_hb[i], now);
+            if (hb == BATTLE_HEARTBEAT_DEAD) {
+                printf("[HOST] Spectator %s:%d stopped answering; removed.\n",
+                       inet_ntoa(spectator_list[i].sin_addr), ntohs(spectator_list[i].sin_port));
+                removeSpectator(i);
+                continue;
+            }
+            if (hb == BATTLE_HEARTBEAT_PING) {
+                battle_heartbeat_format_ping(&spectator_hb[i], fullmsg, sizeof(fullmsg));
+                sendHeartbeat(fullmsg, &spectator_list[i]);
+            }
+            i++;
+        }
+
+        // practice games: the host's moves are played by the computer
+        if (auto_play && battle_manager_initialized && bm.ctx.turnMode == TURN_MODE_HOSTED &&
+            bm.ctx.currentState == STATE_WAITING_FOR_MOVE) {
+            BattleManager_HandleUserInput(&bm, "AUTO");
+            sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
+        }
+
         // keyboard input handling
         if (_kbhit()) {
             printf("message_type: ");
@@ -423,6 +584,47 @@ int main(void) {
                 continue;
             }
 
+            // Local command: let the computer play the host's hosted turns
+            if (!strcmp(line, "AUTO_PLAY")) {
+                auto_play = !auto_play && battle_ai;
+                printf("[HOST] Computer player %s (HOSTED turns only).\n", auto_play ? "on" : "off");
+                continue;
+            }
+
+            // Local command: RTT and missed probes of every peer
+            if (!strcmp(line, "HEARTBEAT")) {
+                if (joiner_tracked) printHeartbeat("Joiner", &last_peer, &joiner_hb);
+                else printf("[HOST] No joiner.\n");
+                for (int i = 0; i < spectator_count; i++) printHeartbeat("Spectator", &spectator_list[i], &spectator_hb[i]);
+                continue;
+            }
+
+            // Local command: PING period and misses before a peer is dropped
+            if (!strcmp(line, "HEARTBEAT_CONFIG")) {
+                char value[32];
+                printf("interval_ms (now %u): ", (unsigned)heartbeat_config.intervalMs);
+                if (!fgets(value, sizeof(value), stdin)) continue;
+                if (atoi(value) > 0) heartbeat_config.intervalMs = (uint32_t)atoi(value);
+                printf("max_missed (now %d): ", heartbeat_config.maxMissed);
+                if (!fgets(value, sizeof(value), stdin)) continue;
+                if (atoi(value) > 0) heartbeat_config.maxMissed = atoi(value);
+                joiner_hb.config = heartbeat_config;
+                for (int i = 0; i < spectator_count; i++) spectator_hb[i].config = heartbeat_config;
+                printf("[HOST] PING every %u ms; a peer is dropped after %d missed.\n",
+                       (unsigned)heartbeat_config.intervalMs, heartbeat_config.maxMissed);
+                continue;
+            }
+
+            // Local command: rebuild the Pokedex from pokemon.csv/moves.csv
+            // without dropping the current battle (it keeps its snapshot)
+            if (!strcmp(line, "RELOAD_POKEDEX")) {
+                if (pokedex_reload_async())
+                    printf("[HOST] Reloading Pokedex in the background; new battles will use it.\n");
+                else
+                    printf("[HOST] Pokedex reload not started (already running, or the Pokedex is embedded).\n");
+                continue;
+            }
+
             // Allow host to send BATTLE_SETUP after handshake
             if (!strcmp(line, "BATTLE_SETUP") && is_handshake_done) {
                 // gather fields
@@ -449,18 +651,34 @@ int main(void) {
                 sscanf(atk, "\"special_attack_uses\": %d", &my_setup.boosts.specialAttack);
                 sscanf(def, "\"special_defense_uses\": %d", &my_setup.boosts.specialDefense);
 
+                printf("turn_mode (CLASSIC/FAST/HOSTED): ");
+                if (!fgets(my_setup.turnMode, sizeof(my_setup.turnMode), stdin)) continue;
+                clean_newline(my_setup.turnMode);
+                if (strcmp(my_setup.turnMode, "FAST") != 0 && strcmp(my_setup.turnMode, "HOSTED") != 0)
+                    strcpy(my_setup.turnMode, "CLASSIC");
+
                 // build message
                 snprintf(fullmsg, sizeof(fullmsg),
                     "message_type: BATTLE_SETUP\n"
                     "communication_mode: %s\n"
                     "pokemon_name: %s\n"
-                    "stat_boosts: { \"special_attack_uses\": %d, \"special_defense_uses\": %d }\n",
+                    "stat_boosts: { \"special_attack_uses\": %d, \"special_defense_uses\": %d }\n"
+                    "turn_mode: %s\n",
                     my_setup.communicationMode, my_setup.pokemonName,
-                    my_setup.boosts.specialAttack, my_setup.boosts.specialDefense);
+                    my_setup.boosts.specialAttack, my_setup.boosts.specialDefense,
+                    my_setup.turnMode);
 
                     // Initialize BattleManager for host (player 1) using the host's chosen pokemon
+                    if (battle_manager_initialized) BattleManager_Release(&bm);
                     BattleManager_Init(&bm, 1, my_setup.pokemonName);
+                    BattleManager_SetSeed(&bm, (uint64_t)seed); // seed we sent in HANDSHAKE_RESPONSE
+                    BattleManager_SetLog(&bm, battle_log);
+                    BattleManager_SetAi(&bm, battle_ai);
                     battle_manager_initialized = true;
+                    if (peer_setup.pokemonName[0] != '\0') {
+                        BattleManager_SetOpponent(&bm, peer_setup.pokemonName);
+                        BattleManager_SetTurnMode(&bm, BattleManager_NegotiateTurnMode(my_setup.turnMode, peer_setup.turnMode));
+                    }
 
                 // For setup we unicast to last_peer (joiner)
                 sendMessageAuto(fullmsg,last_peer, sizeof(last_peer), my_setup,true);
@@ -469,6 +687,10 @@ int main(void) {
                 battle_setup_received = true;
                 continue;
             }
+            else if (isClassicStep(line) && battle_manager_initialized && bm.ctx.turnMode != TURN_MODE_CLASSIC) {
+                printf("[HOST] %s is sent automatically in FAST and HOSTED turns.\n", line);
+                continue;
+            }
             else if(!strcmp(line,"ATTACK_ANNOUNCE")){
                 // Host sending a MOVE using BattleManager
                 if (!battle_manager_initialized) {
@@ -482,78 +704,62 @@ int main(void) {
 
 
                 BattleManager_HandleUserInput(&bm, moveName);
-                const char *out = BattleManager_GetOutgoingMessage(&bm);
-                if (out && strlen(out) > 0) {
-                    sendMessageAuto(out, last_peer, last_peer_len, my_setup, false);
-                    BattleManager_ClearOutgoingMessage(&bm);
-                }
+                sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
             }
               // --- DEFENSE ANNOUNCE ---
             else if (!strcmp(line, "DEFENSE_ANNOUNCE")) {
-                snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+                BattleManager_Send(&bm, BM_TO_PEER,
                         "message_type: DEFENSE_ANNOUNCE\n"
                         "sequence_number: %d\n",
                         ++bm.ctx.currentSequenceNum);
-                sendMessageAuto(bm.outgoingBuffer, last_peer, last_peer_len, my_setup, false);
-                BattleManager_ClearOutgoingMessage(&bm);
+                sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
                 continue;
             }
             // --- CALCULATION REPORT ---
             else if (!strcmp(line, "CALCULATION_REPORT")) {
-                snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+                BattleManager_Send(&bm, BM_TO_PEER,
                         "message_type: CALCULATION_REPORT\n"
-                        "attacker: %s\n"
-                        "move_used: %s\n"
-                        "damage_dealt: %d\n"
-                        "defender_hp_remaining: %d\n"
+                        "state_hash: %016llx\n"
                         "sequence_number: %d\n",
-                        bm.ctx.myPokemon.name,
-                        bm.ctx.lastMoveUsed,
-                        bm.ctx.lastDamage,
-                        bm.ctx.lastRemainingHP,
+                        (unsigned long long)bm.ctx.stateHash,
                         ++bm.ctx.currentSequenceNum);
-                sendMessageAuto(bm.outgoingBuffer, last_peer, last_peer_len, my_setup, false);
-                BattleManager_ClearOutgoingMessage(&bm);
+                sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
                 continue;
             }
 
             // --- CALCULATION CONFIRM ---
             else if (!strcmp(line, "CALCULATION_CONFIRM")) {
-                snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+                BattleManager_Send(&bm, BM_TO_PEER,
                         "message_type: CALCULATION_CONFIRM\n"
+                        "state_hash: %016llx\n"
                         "sequence_number: %d\n",
+                        (unsigned long long)bm.ctx.stateHash,
                         ++bm.ctx.currentSequenceNum);
-                sendMessageAuto(bm.outgoingBuffer, last_peer, last_peer_len, my_setup, false);
-                BattleManager_ClearOutgoingMessage(&bm);
+                sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
                 continue;
             }
 
             // --- RESOLUTION REQUEST ---
             else if (!strcmp(line, "RESOLUTION_REQUEST")) {
-                snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+                BattleManager_Send(&bm, BM_TO_PEER,
                         "message_type: RESOLUTION_REQUEST\n"
                         "attacker: %s\n"
                         "move_used: %s\n"
                         "damage_dealt: %d\n"
                         "defender_hp_remaining: %d\n"
                         "sequence_number: %d\n",
-                        bm.ctx.myPokemon.name,
-                        bm.ctx.lastMoveUsed,
+                        BattleManager_MyPokemonName(&bm),
+                        BattleManager_LastMoveName(&bm),
                         bm.ctx.lastDamage,
                         bm.ctx.lastRemainingHP,
                         ++bm.ctx.currentSequenceNum);
-                sendMessageAuto(bm.outgoingBuffer, last_peer, last_peer_len, my_setup, false);
-                BattleManager_ClearOutgoingMessage(&bm);
+                sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
                 continue;
             }
             // --- GAME OVER ---
             else if (!strcmp(line, "GAME_OVER")) {
-                BattleManager_TriggerGameOver(&bm, bm.ctx.myPokemon.name, bm.ctx.oppPokemon.name);
-                const char *out = BattleManager_GetOutgoingMessage(&bm);
-                if (out && strlen(out) > 0) {
-                    sendMessageAuto(out, last_peer, last_peer_len, my_setup, false);
-                    BattleManager_ClearOutgoingMessage(&bm);
-                }
+                BattleManager_TriggerGameOver(&bm, BattleManager_MyPokemonName(&bm), BattleManager_OppPokemonName(&bm));
+                sendOutgoing(&bm, last_peer, last_peer_len, my_setup);
                 continue;
             }
             // CHAT_MESSAGE (host sending)
@@ -623,6 +829,24 @@ int main(void) {
                 continue;
             }
 
+            else if (!strcmp(line, "NAME_QUERY")) {
+                char kind[16], prefix[64];
+                printf("kind (pokemon/move): ");
+                if (!fgets(kind, sizeof(kind), stdin)) continue;
+                clean_newline(kind);
+                printf("prefix: ");
+                if (!fgets(prefix, sizeof(prefix), stdin)) continue;
+                clean_newline(prefix);
+
+                snprintf(fullmsg, sizeof(fullmsg),
+                    "message_type: NAME_QUERY\n"
+                    "kind: %s\n"
+                    "prefix: %s\n",
+                    kind, prefix);
+                sendMessageAuto(fullmsg, last_peer, last_peer_len, my_setup, false);
+                continue;
+            }
+
             else if (!strcmp(line, "VERBOSE_ON")) {
                 VERBOSE_MODE = true;
                 printf("\n[SYSTEM] Verbose mode enabled.\n");
@@ -654,6 +878,9 @@ int main(void) {
             }
         }
     }
+    if (battle_manager_initialized) BattleManager_Release(&bm);
+    battle_log_close(battle_log);
+    battle_ai_destroy(battle_ai);
     closesocket(sock);
     WSACleanup();
     return 0;
@@ -11,6 +11,9 @@
 #include <stdarg.h>
 #include <conio.h>
 #include "BattleManager.h"
+#include "battle_ai.h"
+#include "battle_heartbeat.h"
+#include "thread_compat.h"
 // #include "gamelogic.h"
 
 #pragma comment(lib, "Ws2_32.lib")
@@ -26,6 +29,7 @@ typedef struct {
   char communicationMode[32]; // P2P or BROADCAST
   char pokemonName[64];
   StatBoosts boosts;
+  char turnMode[16];          // CLASSIC or FAST (both sides must ask); the host may impose HOSTED
 } BattleSetupData;
 
 // FIX 1: Change hostAddr to a pointer in the function prototype
@@ -37,6 +41,9 @@ void sendMessageAuto(const char *msg,
 
 BattleManager bm;
 bool battle_manager_initialized = false;
+// every battle is appended here for tools/battle_replay.c (NULL if it cannot be opened)
+BattleLog *battle_log = NULL;
+BattleAi *battle_ai = NULL; // "AUTO" as a move name lets the computer pick
 // Game state flags
 bool is_handshake_done = false;
 bool is_battle_started = false;
@@ -60,6 +67,12 @@ bool isSpectator = false;
 struct sockaddr_in hostAddr, from;
 int fromLen = sizeof(from);
 bool battle_setup_received = false;
+// liveness of the host, from its HANDSHAKE_RESPONSE / SPECTATOR_RESPONSE on
+BattleHeartbeatConfig heartbeat_config = {
+  BATTLE_HEARTBEAT_INTERVAL_MS, BATTLE_HEARTBEAT_MIN_TIMEOUT_MS, BATTLE_HEARTBEAT_MAX_MISSED
+};
+BattleHeartbeat host_hb;
+bool host_tracked = false;
 // ----------------------------------------------------
 // Verbose printing helper
 // ----------------------------------------------------
@@ -247,6 +260,11 @@ void getInputBattleSetup(BattleSetupData *s) {
 
     sscanf(atk, "\"special_attack_uses\": %d", &s->boosts.specialAttack);
     sscanf(def, "\"special_defense_uses\": %d", &s->boosts.specialDefense);
+
+    printf("turn_mode (CLASSIC/FAST): ");
+    if (fgets(s->turnMode, sizeof(s->turnMode), stdin) == NULL) s->turnMode[0] = '\0';
+    clean_newline(s->turnMode);
+    if (strcmp(s->turnMode, "FAST") != 0) strcpy(s->turnMode, "CLASSIC");
 }
 
 void processBattleSetup(char *msg, BattleSetupData *s) {
@@ -259,9 +277,13 @@ void processBattleSetup(char *msg, BattleSetupData *s) {
      &s->boosts.specialAttack);
   sscanf(strstr(msg, "\"special_defense_uses\":"), "\"special_defense_uses\": %d",
      &s->boosts.specialDefense);
-  printf("[HOST] Parsed BATTLE_SETUP: mode=%s, pokemon=%s, atk=%d, def=%d\n",
-      s->communicationMode, s->pokemonName, s->boosts.specialAttack, s->boosts.specialDefense);
-  BattleManager_Init(&bm, 1, s->pokemonName);
+  // Hosts that predate turn_mode play classic turns
+  char *mode = strstr(msg, "turn_mode: ");
+  strcpy(s->turnMode, "CLASSIC");
+  if (mode) sscanf(mode, "turn_mode: %15[^\n]", s->turnMode);
+  printf("[HOST] Parsed BATTLE_SETUP: mode=%s, pokemon=%s, atk=%d, def=%d, turns=%s\n",
+      s->communicationMode, s->pokemonName, s->boosts.specialAttack, s->boosts.specialDefense,
+      s->turnMode);
 }
 
 // ----------------------------------------------------
@@ -312,7 +334,53 @@ void sendMessageAuto(const char *msg,
   else
     printf("[JOINER] Unicast message sent.\n");
 }
-void processReceivedMessage(char *msg, struct sockaddr_in *from_addr, int from_len, BattleSetupData *setup, BattleSetupData *host_setup, char peer_pokemon[64]) {
+
+bool sameAddr(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+  return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// Keepalives go straight out: sendMessageAuto would log every one of them
+void sendHeartbeat(const char *msg, const struct sockaddr_in *to) {
+  if (sendto(socket_network, msg, (int)strlen(msg), 0, (const SOCKADDR*)to, sizeof(*to)) == SOCKET_ERROR)
+    vprint("[VERBOSE] Heartbeat to %s:%d failed: %d\n", inet_ntoa(to->sin_addr), ntohs(to->sin_port), WSAGetLastError());
+}
+
+// Everything the BattleManager queued, in order, one datagram per message
+// (a joiner has no spectators of its own)
+void sendOutgoing(BattleManager *bm, struct sockaddr_in *hostAddr, BattleSetupData setup) {
+  for (int i = 0; i < BattleManager_OutgoingCount(bm); i++) {
+    int audience;
+    const char *msg = BattleManager_OutgoingAt(bm, i, NULL, &audience);
+    if (audience & BM_TO_PEER)
+      sendMessageAuto(msg, hostAddr, sizeof(*hostAddr), setup, false);
+  }
+  BattleManager_ClearOutgoingMessage(bm);
+}
+
+// Replies queued while handling a received turn message. FAST and HOSTED
+// turns are settled by them, so all of them go out; classic replies are typed
+// by hand (DEFENSE_ANNOUNCE, ...), except a GAME_OVER, which ends the battle
+void sendReplies(BattleManager *bm, struct sockaddr_in *hostAddr, BattleSetupData setup) {
+  if (bm->ctx.turnMode != TURN_MODE_CLASSIC) {
+    sendOutgoing(bm, hostAddr, setup);
+    return;
+  }
+  for (int i = 0; i < BattleManager_OutgoingCount(bm); i++) {
+    int audience;
+    const char *msg = BattleManager_OutgoingAt(bm, i, NULL, &audience);
+    if ((audience & BM_TO_PEER) && BattleManager_MessageType(msg) == BATTLE_MSG_GAME_OVER)
+      sendMessageAuto(msg, hostAddr, sizeof(*hostAddr), setup, false);
+  }
+  BattleManager_ClearOutgoingMessage(bm);
+}
+
+// The classic turn steps typed by hand; FAST and HOSTED turns send their own
+bool isClassicStep(const char *input) {
+  return !strcmp(input, "DEFENSE_ANNOUNCE") || !strcmp(input, "CALCULATION_REPORT") ||
+         !strcmp(input, "CALCULATION_CONFIRM") || !strcmp(input, "RESOLUTION_REQUEST");
+}
+
+void processReceivedMessage(char *msg, struct sockaddr_in *from_addr, int from_len, BattleSetupData *setup, BattleSetupData *host_setup) {
   char *type = get_message_type(msg);
   if (!type) return;
   printf("Type: %s\n",type);
@@ -327,27 +395,41 @@ void processReceivedMessage(char *msg, struct sockaddr_in *from_addr, int from_l
     printf("[JOINER] Handshake completed with host %s:%d\n",
        inet_ntoa(from_addr->sin_addr), ntohs(from_addr->sin_port));
     printf("[JOINER] Received seed: %d\n", seed);
+    battle_heartbeat_start(&host_hb, &heartbeat_config, bm_time_ms());
+    host_tracked = true;
     
   }
   else if(!strncmp(type, "SPECTATOR_RESPONSE", strlen("SPECTATOR_RESPONSE")) && isSpectator) {
     printf("[JOINER] Registered as spectator with host %s:%d\n",
        inet_ntoa(from_addr->sin_addr), ntohs(from_addr->sin_port));
+    hostAddr = *from_addr; // the request went out as a broadcast
+    battle_heartbeat_start(&host_hb, &heartbeat_config, bm_time_ms());
+    host_tracked = true;
   }
   // BATTLE_SETUP
   else if (!strncmp(type, "BATTLE_SETUP", strlen("BATTLE_SETUP"))) {
     processBattleSetup(msg, host_setup);
     printf("[JOINER] Received BATTLE_SETUP from host.\n");
-    
-    if(!battle_manager_initialized){
-    BattleManager_Init(&bm, 0, host_setup->pokemonName);
 
-    battle_manager_initialized = true;
-  }
+    // The host's Pokemon is our opponent; if our own setup is not done yet
+    // it is applied when we send BATTLE_SETUP.
+    if(battle_manager_initialized){
+      BattleManager_SetOpponent(&bm, host_setup->pokemonName);
+      BattleManager_SetTurnMode(&bm, BattleManager_NegotiateTurnMode(host_setup->turnMode, setup->turnMode));
+    }
   }
   // CHAT_MESSAGE
   else if (!strncmp(type, "CHAT_MESSAGE", strlen("CHAT_MESSAGE"))) {
     processChatMessage(msg);
   }
+  else if(!strncmp(type,"NAME_QUERY_RESULT",strlen("NAME_QUERY_RESULT"))){
+    printf("\n[JOINER] %s\n", msg);
+  }
+  else if(!strncmp(type,"NAME_QUERY",strlen("NAME_QUERY"))){
+    char reply[512];
+    BattleManager_AnswerNameQuery(msg, reply, sizeof(reply));
+    sendMessageAuto(reply, from_addr, from_len, *setup, false);
+  }
   else if(!strcmp(type,"VERBOSE_ON")){
     VERBOSE_MODE = true;
     printf("\n[SYSTEM] Verbose mode enabled\n");
@@ -356,23 +438,17 @@ void processReceivedMessage(char *msg, struct sockaddr_in *from_addr, int from_l
     VERBOSE_MODE = false;
     printf("\n[SYSTEM] Verbose mode disabled\n");
   }
-  else if (!strncmp(type,"ATTACK_ANNOUNCE",strlen("ATTACK_ANNOUNCE"))){
-    handle_attack_announce(&bm,msg);
-  }
-  else if (!strncmp(type,"DEFENSE_ANNOUNCE",strlen("DEFENSE_ANNOUNCE"))){
-    handle_defense_announce(&bm, msg,peer_pokemon);
-  }
-  else if (!strncmp(type,"CALCULATION_REPORT",strlen("CALCULATION_REPORT"))){
-    handle_calculation_report(&bm, msg);
-  }
-  else if (!strncmp(type,"CALCULATION_CONFIRM",strlen("CALCULATION_CONFIRM"))){
-    handle_calculation_confirm(&bm, msg);
+  else if (isSpectator && (BattleManager_MessageType(msg) == BATTLE_MSG_TURN_RESULT ||
+                           BattleManager_MessageType(msg) == BATTLE_MSG_GAME_OVER)) {
+    printf("[SPECTATOR] %s\n", msg);
   }
-  else if (!strncmp(type,"RESOLUTION_REQUEST",strlen("RESOLUTION_REQUEST"))){
-    handle_resolution_request(&bm, msg);
-  }
-  else if (!strncmp(type,"GAME_OVER",strlen("GAME_OVER"))){
-    handle_game_over(&bm, msg);
+  else if (BattleManager_MessageType(msg) != BATTLE_MSG_NONE){
+    // turn messages are validated by the BattleManager's transition table
+    if (battle_manager_initialized) {
+      BattleManager_HandleMessage(&bm, msg);
+      sendReplies(&bm, &hostAddr, *setup);
+    }
+    else printf("[JOINER] Battle message before BATTLE_SETUP ignored.\n");
   }
   else{
       printf("Message: %s\n", type);
@@ -468,6 +544,10 @@ int main() {
   WSADATA wsa;
   BattleSetupData setup;
   BattleSetupData host_setup;
+  memset(&setup, 0, sizeof(setup));
+  memset(&host_setup, 0, sizeof(host_setup));
+  battle_log = battle_log_open("joiner_battles.pbl");
+  battle_ai = battle_ai_create(NULL);
   char receive[2048];
   char input[MaxBufferSize];
   char outbuf[2048];
@@ -566,7 +646,37 @@ int main() {
           hostAddr.sin_port = htons(9002); // Assuming host listens on 9002
           last_sender = hostAddr; //save for future unicast messages
         }
-        processReceivedMessage(receive, &broadcast_recv_addr, fromLen, &setup,&host_setup,host_setup.pokemonName);
+        // every packet from the host is a sign of life; PING/PONG go no further
+        if (host_tracked && sameAddr(&broadcast_recv_addr, &hostAddr))
+          battle_heartbeat_heard(&host_hb, receive, bm_time_ms());
+        if (battle_heartbeat_answer(receive, outbuf, sizeof(outbuf)))
+          sendHeartbeat(outbuf, &broadcast_recv_addr);
+        else if (!battle_heartbeat_is_pong(receive))
+          processReceivedMessage(receive, &broadcast_recv_addr, fromLen, &setup,&host_setup);
+      }
+    }
+
+    // --------------------------
+    // KEEPALIVE
+    // --------------------------
+    if (host_tracked) {
+      BattleHeartbeatAction hb = battle_heartbeat_poll(&host_hb, bm_time_ms());
+      if (hb == BATTLE_HEARTBEAT_PING) {
+        battle_heartbeat_format_ping(&host_hb, outbuf, sizeof(outbuf));
+        sendHeartbeat(outbuf, &hostAddr);
+      } else if (hb == BATTLE_HEARTBEAT_DEAD) {
+        // Give the battle up now (its log gets an END record); a new
+        // HANDSHAKE_REQUEST or SPECTATOR_REQUEST starts over
+        printf("[JOINER] Host %s:%d stopped answering (%d PINGs missed); battle abandoned.\n",
+               inet_ntoa(hostAddr.sin_addr), ntohs(hostAddr.sin_port), host_hb.missed);
+        if (battle_manager_initialized) BattleManager_Release(&bm);
+        battle_manager_initialized = false;
+        is_handshake_done = false;
+        is_battle_started = false;
+        battle_setup_received = false;
+        isSpectator = false;
+        memset(&host_setup, 0, sizeof(host_setup));
+        host_tracked = false;
       }
     }
 
@@ -608,17 +718,33 @@ int main() {
             "message_type: BATTLE_SETUP\n"
             "communication_mode: %s\n"
             "pokemon_name: %s\n"
-            "stat_boosts: { \"special_attack_uses\": %d, \"special_defense_uses\": %d }\n",
+            "stat_boosts: { \"special_attack_uses\": %d, \"special_defense_uses\": %d }\n"
+            "turn_mode: %s\n",
             setup.communicationMode,
             setup.pokemonName,
             setup.boosts.specialAttack,
-            setup.boosts.specialDefense
+            setup.boosts.specialDefense,
+            setup.turnMode
           );
 
           // FIX 4: Pass address of hostAddr
           sendMessageAuto(outbuf, &hostAddr, sizeof(hostAddr), setup, !is_handshake_done);
           battle_setup_received = true;
           printf("[JOINER] Sent BATTLE_SETUP.\n");
+
+          if (battle_manager_initialized) BattleManager_Release(&bm);
+          BattleManager_Init(&bm, 0, setup.pokemonName); // 0 = joiner player
+          BattleManager_SetSeed(&bm, (uint64_t)seed); // from HANDSHAKE_RESPONSE
+          BattleManager_SetLog(&bm, battle_log);
+          BattleManager_SetAi(&bm, battle_ai);
+          battle_manager_initialized = true;
+          if (host_setup.pokemonName[0] != '\0') {
+            BattleManager_SetOpponent(&bm, host_setup.pokemonName);
+            BattleManager_SetTurnMode(&bm, BattleManager_NegotiateTurnMode(host_setup.turnMode, setup.turnMode));
+          }
+        }
+        else if (isClassicStep(input) && battle_manager_initialized && bm.ctx.turnMode != TURN_MODE_CLASSIC) {
+          printf("[JOINER] %s is sent automatically in FAST and HOSTED turns.\n", input);
         }
         else if (!strcmp(input, "ATTACK_ANNOUNCE")) {
           char moveName[128];
@@ -629,78 +755,62 @@ int main() {
                 printf("[JOINER] No move entered. Skipping.\n");
             } else {
                 BattleManager_HandleUserInput(&bm, moveName);
-                const char *out = BattleManager_GetOutgoingMessage(&bm);
-                if (out && strlen(out) > 0) {
-                    sendMessageAuto(out, &hostAddr, sizeof(hostAddr), setup, false);
-                    BattleManager_ClearOutgoingMessage(&bm);
-                }
+                sendOutgoing(&bm, &hostAddr, setup);
             }
           }
         }
         // DEFENSE ANNOUNCE
         else if (!strcmp(input, "DEFENSE_ANNOUNCE")) {
-            snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+            BattleManager_Send(&bm, BM_TO_PEER,
                     "message_type: DEFENSE_ANNOUNCE\n"
                     "sequence_number: %d\n",
                     ++bm.ctx.currentSequenceNum);
-            sendMessageAuto(bm.outgoingBuffer, &hostAddr, sizeof(hostAddr), setup, false);
-            BattleManager_ClearOutgoingMessage(&bm);
+            sendOutgoing(&bm, &hostAddr, setup);
         }
 
         // CALCULATION REPORT
         else if (!strcmp(input, "CALCULATION_REPORT")) {
-            snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+            BattleManager_Send(&bm, BM_TO_PEER,
                     "message_type: CALCULATION_REPORT\n"
-                    "attacker: %s\n"
-                    "move_used: %s\n"
-                    "damage_dealt: %d\n"
-                    "defender_hp_remaining: %d\n"
+                    "state_hash: %016llx\n"
                     "sequence_number: %d\n",
-                    bm.ctx.myPokemon.name,
-                    bm.ctx.lastMoveUsed,
-                    bm.ctx.lastDamage,
-                    bm.ctx.lastRemainingHP,
+                    (unsigned long long)bm.ctx.stateHash,
                     ++bm.ctx.currentSequenceNum);
-            sendMessageAuto(bm.outgoingBuffer, &hostAddr, sizeof(hostAddr), setup, false);
-            BattleManager_ClearOutgoingMessage(&bm);
+            sendOutgoing(&bm, &hostAddr, setup);
         }
 
         // CALCULATION CONFIRM
         else if (!strcmp(input, "CALCULATION_CONFIRM")) {
-            snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+            BattleManager_Send(&bm, BM_TO_PEER,
                     "message_type: CALCULATION_CONFIRM\n"
+                    "state_hash: %016llx\n"
                     "sequence_number: %d\n",
+                    (unsigned long long)bm.ctx.stateHash,
                     ++bm.ctx.currentSequenceNum);
-            sendMessageAuto(bm.outgoingBuffer, &hostAddr, sizeof(hostAddr), setup, false);
-            BattleManager_ClearOutgoingMessage(&bm);
+            sendOutgoing(&bm, &hostAddr, setup);
         }
 
         // RESOLUTION REQUEST
         else if (!strcmp(input, "RESOLUTION_REQUEST")) {
-            snprintf(bm.outgoingBuffer, BM_MAX_MSG_SIZE,
+            BattleManager_Send(&bm, BM_TO_PEER,
                     "message_type: RESOLUTION_REQUEST\n"
                     "attacker: %s\n"
                     "move_used: %s\n"
                     "damage_dealt: %d\n"
                     "defender_hp_remaining: %d\n"
                     "sequence_number: %d\n",
-                    bm.ctx.myPokemon.name,
-                    bm.ctx.lastMoveUsed,
+                    BattleManager_MyPokemonName(&bm),
+                    BattleManager_LastMoveName(&bm),
                     bm.ctx.lastDamage,
                     bm.ctx.lastRemainingHP,
                     ++bm.ctx.currentSequenceNum);
-            sendMessageAuto(bm.outgoingBuffer, &hostAddr, sizeof(hostAddr), setup, false);
-            BattleManager_ClearOutgoingMessage(&bm);
+            sendOutgoing(&bm, &hostAddr, setup);
         }
 
         // GAME OVER
         else if (!strcmp(input, "GAME_OVER")) {
-            BattleManager_TriggerGameOver(&bm, bm.ctx.myPokemon.name, bm.ctx.oppPokemon.name);
-            const char *out = BattleManager_GetOutgoingMessage(&bm);
-            if (out && strlen(out) > 0) {
-                sendMessageAuto(out, &hostAddr, sizeof(hostAddr), setup, false);
-                BattleManager_ClearOutgoingMessage(&bm);
-            }
+            BattleManager_TriggerGameOver(&bm, BattleManager_MyPokemonName(&bm), BattleManager_OppPokemonName(&bm));
+            sendOutgoing(&bm, &hostAddr, setup);
             is_game_over = true;
             printf("[JOINER] Game Over. Exiting...\n");
         }
@@ -712,6 +822,46 @@ int main() {
           inputChatMessage(outbuf, setup, hostAddr, sizeof(hostAddr));
         }
 
+        else if (!strcmp(input, "NAME_QUERY")) {
+          char kind[16], prefix[64];
+          printf("kind (pokemon/move): ");
+          if (!fgets(kind, sizeof(kind), stdin)) continue;
+          clean_newline(kind);
+          printf("prefix: ");
+          if (!fgets(prefix, sizeof(prefix), stdin)) continue;
+          clean_newline(prefix);
+
+          snprintf(outbuf, sizeof(outbuf),
+                   "message_type: NAME_QUERY\n"
+                   "kind: %s\n"
+                   "prefix: %s\n",
+                   kind, prefix);
+          sendMessageAuto(outbuf, &hostAddr, sizeof(hostAddr), setup, !is_handshake_done);
+        }
+
+        // Local command: RTT and missed probes of the host
+        else if (!strcmp(input, "HEARTBEAT")) {
+          if (!host_tracked) printf("[JOINER] Not connected to a host.\n");
+          else printf("[JOINER] Host %s:%d  srtt %.1f ms  rttvar %.1f ms  timeout %u ms  missed %d/%d  (%u samples)\n",
+                      inet_ntoa(hostAddr.sin_addr), ntohs(hostAddr.sin_port), battle_heartbeat_srtt_ms(&host_hb),
+                      battle_heartbeat_rttvar_ms(&host_hb), (unsigned)battle_heartbeat_timeout_ms(&host_hb),
+                      host_hb.missed, host_hb.config.maxMissed, (unsigned)host_hb.samples);
+        }
+
+        // Local command: PING period and misses before the host is given up
+        else if (!strcmp(input, "HEARTBEAT_CONFIG")) {
+          char value[32];
+          printf("interval_ms (now %u): ", (unsigned)heartbeat_config.intervalMs);
+          if (!fgets(value, sizeof(value), stdin)) continue;
+          if (atoi(value) > 0) heartbeat_config.intervalMs = (uint32_t)atoi(value);
+          printf("max_missed (now %d): ", heartbeat_config.maxMissed);
+          if (!fgets(value, sizeof(value), stdin)) continue;
+          if (atoi(value) > 0) heartbeat_config.maxMissed = atoi(value);
+          host_hb.config = heartbeat_config;
+          printf("[JOINER] PING every %u ms; the host is given up after %d missed.\n",
+                 (unsigned)heartbeat_config.intervalMs, heartbeat_config.maxMissed);
+        }
+
         else if (!strcmp(input, "VERBOSE_ON")) {
           VERBOSE_MODE = true;
           printf("\n[SYSTEM] Verbose mode enabled.\n");
@@ -746,6 +896,9 @@ int main() {
   
   }
 
+  if (battle_manager_initialized) BattleManager_Release(&bm);
+  battle_log_close(battle_log);
+  battle_ai_destroy(battle_ai);
   closesocket(socket_network);
   closesocket(socket_network); // Note: Calling closesocket twice is redundant/harmless but odd.
   WSACleanup();